@@ -43,19 +43,6 @@ float ** f1dto2d(float *p, int nx, int nz) {
 	return pp;
 }
 
-void matrix_transpose(float *matrix, float *trans, int n1, int n2)
-/*< matrix transpose: matrix tansposed to be trans >*/
-{
-
-#pragma omp parallel for
-  for (int i2 = 0; i2 < n2; i2++) {
-    for (int i1 = 0; i1 < n1; i1++) {
-      trans[i2 + n2 * i1] = matrix[i1 + n1 * i2];
-    }
-  }
-}
-
-
 void step_forward(const float *p0, const float *p1, float *p2, const float *vv, float dtz, float dtx, int nz, int nx)
 /*< forward modeling step, Clayton-Enquist ABC incorporated >*/
 {
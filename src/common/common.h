@@ -12,6 +12,7 @@
 #include <functional>
 #include <algorithm>
 #include <cmath>
+#include "matrix-transpose.h"
 
 template <typename T>
 void vectorMinus(const std::vector<T> &dobs, const std::vector<T> &dcal, std::vector<T> &vsrc) {
@@ -48,7 +49,6 @@ float variance(const T *A_Begin, const T *A_End, const T *B_Begin) {
 
 std::vector<float> taper(int nx, int nwx);
 float ** f1dto2d(float *p, int nx, int nz);
-void matrix_transpose(float *matrix, float *trans, int n1, int n2);
 void step_forward(const float *p0, const float *p1, float *p2, const float *vv, float dtz, float dtx, int nz, int nx);
 void step_backward(float *illum, float *lap, const float *p0, const float *p1, float *p2, const float *vv, float dtz, float dtx, int nz, int nx);
 
@@ -0,0 +1,107 @@
+/*
+ * lbfgs.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: rice
+ */
+
+#include <cstdlib>
+#include "lbfgs.h"
+#include "logger.h"
+
+static double dot(const std::vector<float> &a, const std::vector<float> &b, const std::vector<char> &freeVar) {
+  double r = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    if (freeVar[i]) {
+      r += (double)a[i] * b[i];
+    }
+  }
+  return r;
+}
+
+Lbfgs::Lbfgs(int nhist) :
+  nhist(nhist), gamma(1)
+{
+  if (nhist < 1) {
+    ERROR() << format("l-bfgs needs at least one pair, not %d") % nhist;
+    exit(1);
+  }
+}
+
+void Lbfgs::direction(const std::vector<float> &m, const std::vector<float> &g, float lower, float upper,
+    std::vector<float> &d) const {
+  size_t n = g.size();
+  std::vector<char> freeVar(n, 1);
+  for (size_t i = 0; i < n; i++) {
+    if ((m[i] <= lower && g[i] < 0) || (m[i] >= upper && g[i] > 0)) {
+      freeVar[i] = 0;
+    }
+  }
+
+  /// two loop recursion, newest pair first
+  int k = s.size();
+  std::vector<double> alpha(k);
+  std::vector<float> q(g);
+  for (int j = k - 1; j >= 0; j--) {
+    alpha[j] = rho[j] * dot(s[j], q, freeVar);
+    for (size_t i = 0; i < n; i++) {
+      q[i] -= alpha[j] * y[j][i];
+    }
+  }
+
+  d.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    d[i] = freeVar[i] ? gamma * q[i] : 0;
+  }
+
+  for (int j = 0; j < k; j++) {
+    double beta = rho[j] * dot(y[j], d, freeVar);
+    for (size_t i = 0; i < n; i++) {
+      d[i] += (alpha[j] - beta) * s[j][i];
+    }
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    d[i] = freeVar[i] ? d[i] : 0;
+  }
+}
+
+bool Lbfgs::update(const std::vector<float> &sk, const std::vector<float> &gOld, const std::vector<float> &gNew) {
+  size_t n = sk.size();
+  std::vector<char> all(n, 1);
+
+  /// y is the change of the gradient, the descent directions change the other way
+  std::vector<float> yk(n);
+  for (size_t i = 0; i < n; i++) {
+    yk[i] = gOld[i] - gNew[i];
+  }
+
+  double sy = dot(sk, yk, all);
+  double yy = dot(yk, yk, all);
+  if (!(sy > 0 && yy > 0)) {
+    DEBUG() << format("l-bfgs pair skipped, s'y = %e") % sy;
+    return false;
+  }
+
+  s.push_back(sk);
+  y.push_back(yk);
+  rho.push_back(1 / sy);
+  gamma = sy / yy;
+  if (static_cast<int>(s.size()) > nhist) {
+    s.pop_front();
+    y.pop_front();
+    rho.pop_front();
+  }
+  return true;
+}
+
+void Lbfgs::reset() {
+  s.clear();
+  y.clear();
+  rho.clear();
+  gamma = 1;
+}
+
+int Lbfgs::size() const {
+  return s.size();
+}
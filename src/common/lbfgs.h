@@ -0,0 +1,49 @@
+/*
+ * lbfgs.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: rice
+ */
+
+#ifndef SRC_COMMON_LBFGS_H_
+#define SRC_COMMON_LBFGS_H_
+
+#include <deque>
+#include <vector>
+
+/**
+ * limited memory BFGS inverse Hessian (Nocedal and Wright, Numerical
+ * Optimization, algorithm 7.4) of a model held in [lower, upper].
+ *
+ * the gradients are given as descent directions, g = -c * gradient for some
+ * c > 0 the same in every call, which is what the FWI gradients are. the
+ * initial Hessian is scaled by s'y / y'y of the newest pair, so c drops out.
+ *
+ * the bounds are handled as in projected L-BFGS: a variable on a bound whose
+ * descent direction points out of [lower, upper] is held, it is left out of
+ * the two loop recursion and of the direction. the caller projects the
+ * stepped model back on the bounds
+ */
+class Lbfgs {
+public:
+  explicit Lbfgs(int nhist = 5);
+
+  /// search direction d at model m with the descent direction g, d = H g on the free variables
+  void direction(const std::vector<float> &m, const std::vector<float> &g, float lower, float upper,
+      std::vector<float> &d) const;
+  /// the model moved by s while the descent direction went from gOld to gNew. the pair
+  /// is kept when the curvature s'y is positive, the oldest is dropped past nhist pairs
+  bool update(const std::vector<float> &s, const std::vector<float> &gOld, const std::vector<float> &gNew);
+  void reset();
+  /// # of pairs held
+  int size() const;
+
+private:
+  int nhist;
+  std::deque<std::vector<float> > s;
+  std::deque<std::vector<float> > y;
+  std::deque<double> rho;   /// 1 / s'y
+  double gamma;             /// s'y / y'y of the newest pair
+};
+
+#endif /* SRC_COMMON_LBFGS_H_ */
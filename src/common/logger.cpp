@@ -8,16 +8,35 @@
 #include "logger.h"
 
 #include <sys/time.h>
+#include <pthread.h>
 
 FILE *Output2FILE::pfile = NULL;
 std::string Output2FILE::filename = "";
 
+namespace {
+
+/// the writer thread wakes up this often, and at once when this much is buffered
+const long WRITE_PERIOD_NS = 200000000L;
+const size_t WRITE_BYTES = 1 << 16;
+
+bool async = false;
+bool quit = false;
+pthread_t thread;
+pthread_mutex_t bufferLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t bufferCond = PTHREAD_COND_INITIALIZER;
+std::string buffer;
+
+/// taken before the buffer is swapped out, the swapped buffers are written in order
+pthread_mutex_t writeLock = PTHREAD_MUTEX_INITIALIZER;
+
+} /* namespace */
+
 std::string getDateTime()
 {
   time_t     now = time(0);
   struct tm  tstruct;
   char       buf[80];
-  tstruct = *localtime(&now);
+  localtime_r(&now, &tstruct);   /// the shots of a process may log from several threads
   // Visit http://en.cppreference.com/w/cpp/chrono/c/strftime
   // for more information about date/time format
   strftime(buf, sizeof(buf), "%Y-%m-%d %X", &tstruct);
@@ -45,7 +64,7 @@ FILE*& Output2FILE::TerminalStream()
     return pStream;
 }
 
-void Output2FILE::Output(const std::string& msg)
+void Output2FILE::write(const std::string& msg)
 {
     FILE* tstream = TerminalStream();
     FILE *fstream = FileStream();
@@ -59,3 +78,87 @@ void Output2FILE::Output(const std::string& msg)
       fflush(fstream);
     }
 }
+
+void Output2FILE::Output(const std::string& msg)
+{
+  if (!async) {
+    write(msg);
+    return;
+  }
+
+  pthread_mutex_lock(&bufferLock);
+  buffer += msg;
+  if (buffer.size() >= WRITE_BYTES) {
+    pthread_cond_signal(&bufferCond);
+  }
+  pthread_mutex_unlock(&bufferLock);
+}
+
+void Output2FILE::Flush()
+{
+  if (!async) {
+    return;
+  }
+
+  std::string msg;
+  pthread_mutex_lock(&writeLock);
+  pthread_mutex_lock(&bufferLock);
+  msg.swap(buffer);
+  pthread_mutex_unlock(&bufferLock);
+  if (!msg.empty()) {
+    write(msg);
+  }
+  pthread_mutex_unlock(&writeLock);
+}
+
+void *Output2FILE::writer(void *)
+{
+  pthread_mutex_lock(&bufferLock);
+  while (!quit) {
+    timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    t.tv_nsec += WRITE_PERIOD_NS;
+    if (t.tv_nsec >= 1000000000L) {
+      t.tv_sec++;
+      t.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&bufferCond, &bufferLock, &t);
+
+    pthread_mutex_unlock(&bufferLock);
+    Flush();
+    pthread_mutex_lock(&bufferLock);
+  }
+  pthread_mutex_unlock(&bufferLock);
+
+  return NULL;
+}
+
+void Output2FILE::stopAsync()
+{
+  pthread_mutex_lock(&bufferLock);
+  quit = true;
+  pthread_cond_signal(&bufferCond);
+  pthread_mutex_unlock(&bufferLock);
+  pthread_join(thread, NULL);
+
+  Flush();
+  async = false;
+}
+
+/**
+ * call it once, before the threads of the process start logging. the
+ * buffer is written out at exit
+ */
+void Output2FILE::setAsync(bool on)
+{
+  if (!on || async) {
+    return;
+  }
+
+  if (pthread_create(&thread, NULL, writer, NULL) != 0) {
+    write("cannot start the log writer thread, logging synchronously\n");
+    return;
+  }
+  async = true;
+  atexit(stopAsync);
+}
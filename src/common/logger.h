@@ -4,6 +4,7 @@
 #include <sstream>
 #include <string>
 #include <cstdio>
+#include <cstdlib>
 #include <boost/format.hpp>
 
 using boost::format;
@@ -21,24 +22,27 @@ public:
   std::ostringstream& Get(TLogLevel level = logINFO);
 public:
   static void setLogFile(const std::string &file);
+  static void setAsync(bool on);
   static TLogLevel& ReportingLevel();
   static std::string ToString(TLogLevel level);
   static TLogLevel FromString(const std::string& level);
 protected:
   std::ostringstream os;
+  TLogLevel level;
 private:
   Log(const Log&);
   Log& operator =(const Log&);
 };
 
 template <typename T>
-Log<T>::Log()
+Log<T>::Log() : level(logINFO)
 {
 }
 
 template <typename T>
 std::ostringstream& Log<T>::Get(TLogLevel level)
 {
+  this->level = level;
   os << getDateTime();
   os << " " << ToString(level) << ": ";
   os << std::string(level > logDEBUG ? level - logDEBUG : 0, '\t');
@@ -50,12 +54,20 @@ Log<T>::~Log()
 {
   os << std::endl;
   T::Output(os.str());
+  if (level == logERROR) {
+    /// an error is mostly followed by exit, it is written out before
+    T::Flush();
+  }
 }
 
+/**
+ * FILELOG_LEVEL in the environment, e.g. INFO, lowers the level at run time
+ */
 template <typename T>
 TLogLevel& Log<T>::ReportingLevel()
 {
-  static TLogLevel reportingLevel = logDEBUG4;
+  static const char *env = getenv("FILELOG_LEVEL");
+  static TLogLevel reportingLevel = env != NULL ? FromString(env) : logDEBUG4;
   return reportingLevel;
 }
 
@@ -71,6 +83,11 @@ inline void Log<T>::setLogFile(const std::string& file) {
   T::setFileName(file);
 }
 
+template<typename T>
+inline void Log<T>::setAsync(bool on) {
+  T::setAsync(on);
+}
+
 template <typename T>
 TLogLevel Log<T>::FromString(const std::string& level)
 {
@@ -96,15 +113,26 @@ TLogLevel Log<T>::FromString(const std::string& level)
   return logINFO;
 }
 
+/**
+ * every message goes to the terminal and to the log file of the rank. with
+ * async the messages are buffered and written by a background thread a few
+ * times a second, the thread that logs does not wait for the file system.
+ * Flush writes the buffer out at once, it is done on every error and at exit
+ */
 class Output2FILE
 {
 public:
   static void Output(const std::string& msg);
+  static void Flush();
   static void setFileName(const std::string &filename);
+  static void setAsync(bool on);
   static FILE*& TerminalStream();
 
 private:
   static FILE*& FileStream();
+  static void write(const std::string &msg);
+  static void *writer(void *arg);
+  static void stopAsync();
   static FILE *pfile;
   static std::string filename;
 };
@@ -113,13 +141,21 @@ class FILELog: public Log<Output2FILE> {
 };
 
 
+/// the release build sets it to logINFO, the levels above are compiled out
 #ifndef FILELOG_MAX_LEVEL
 #define FILELOG_MAX_LEVEL logDEBUG4
 #endif
 
+/**
+ * whether a message of the level is written. the arguments of a message are
+ * only evaluated when it is, a diagnostic computed before the message, e.g. a
+ * checksum of a model, is put under if (LOG_ENABLED(logDEBUG))
+ */
+#define LOG_ENABLED(level) \
+    ((level) <= FILELOG_MAX_LEVEL && (level) <= FILELog::ReportingLevel() && Output2FILE::TerminalStream())
+
 #define FILE_LOG(level) \
-    if (level > FILELOG_MAX_LEVEL) ;\
-    else if (level > FILELog::ReportingLevel() || !Output2FILE::TerminalStream()) ; \
+    if (!LOG_ENABLED(level)) ; \
     else FILELog().Get(level)
 
 #define TRACE() FILE_LOG(logDEBUG1)
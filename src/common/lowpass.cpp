@@ -0,0 +1,47 @@
+/*
+ * lowpass.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: rice
+ */
+
+#include <cmath>
+#include "lowpass.h"
+
+const float LowPass::CORNER = 0.75f;
+
+/**
+ * the analog sections s^2 + 2 cos(phi) s + 1 of the Butterworth poles
+ * through the bilinear transform, prewarped to the corner
+ */
+LowPass::LowPass(float dt, float fmax) :
+  sections(ORDER / 2)
+{
+  double k = std::tan(M_PI * CORNER * fmax * dt);
+  for (int i = 0; i < ORDER / 2; i++) {
+    double c = 2 * std::cos(M_PI * (2 * i + 1) / (2 * ORDER));
+    double norm = 1 / (1 + c * k + k * k);
+    Section &s = sections[i];
+    s.b0 = k * k * norm;
+    s.b1 = 2 * s.b0;
+    s.b2 = s.b0;
+    s.a1 = 2 * (k * k - 1) * norm;
+    s.a2 = (1 - c * k + k * k) * norm;
+  }
+}
+
+void LowPass::apply(float *trace, int nt, int stride) const {
+  for (size_t i = 0; i < sections.size(); i++) {
+    const Section &s = sections[i];
+    double x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+    for (int it = 0; it < nt; it++) {
+      float &v = trace[(size_t)it * stride];
+      double y = s.b0 * v + s.b1 * x1 + s.b2 * x2 - s.a1 * y1 - s.a2 * y2;
+      x2 = x1;
+      x1 = v;
+      y2 = y1;
+      y1 = y;
+      v = y;
+    }
+  }
+}
@@ -0,0 +1,37 @@
+/*
+ * lowpass.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: rice
+ */
+
+#ifndef SRC_COMMON_LOWPASS_H_
+#define SRC_COMMON_LOWPASS_H_
+
+#include <vector>
+
+/**
+ * causal Butterworth low pass of traces of samples dt apart, ORDER poles in
+ * second order sections, the corner at CORNER * fmax, so fmax is damped by
+ * about 15 dB. the filter is causal and time invariant: the data of the low
+ * passed wavelet is the low passed data, the relation FWI needs between the
+ * two. a zero phase filter would cut its response to the wavelet before t = 0
+ */
+class LowPass {
+public:
+  LowPass(float dt, float fmax);
+
+  /// the samples trace[it * stride], it < nt, thread safe
+  void apply(float *trace, int nt, int stride = 1) const;
+
+private:
+  static const int ORDER = 6;
+  static const float CORNER;
+  struct Section {
+    double b0, b1, b2;
+    double a1, a2;
+  };
+  std::vector<Section> sections;
+};
+
+#endif /* SRC_COMMON_LOWPASS_H_ */
@@ -0,0 +1,288 @@
+/*
+ * matrix-transpose.cpp
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include "matrix-transpose.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define TRANSPOSE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/// a 64x64 tile of the source and of the destination fit in L1 together
+#define TRANSPOSE_TILE 64
+/// below this size the threads cost more than they save
+#define TRANSPOSE_OMP_MIN (64 * 1024L)
+/// longest piece of a row the in place transpose of a rectangle moves as one element
+#define TRANSPOSE_PIECE 32
+
+namespace {
+
+/**
+ * dst[c * ld + r] = src[r * ls + c] for an 8x8 block
+ */
+typedef void (*Block8)(const float *src, int ls, float *dst, int ld);
+
+void block8_scalar(const float *src, int ls, float *dst, int ld) {
+  for (int r = 0; r < 8; r++) {
+    for (int c = 0; c < 8; c++) {
+      dst[c * ld + r] = src[r * ls + c];
+    }
+  }
+}
+
+#ifdef TRANSPOSE_X86_SIMD
+
+/**
+ * sse is part of x86_64, no target switch is needed. a 256 bit version
+ * measured slower on gathers that do not fit in cache
+ */
+void block4_sse(const float *src, int ls, float *dst, int ld) {
+  __m128 r0 = _mm_loadu_ps(src);
+  __m128 r1 = _mm_loadu_ps(src + ls);
+  __m128 r2 = _mm_loadu_ps(src + 2 * ls);
+  __m128 r3 = _mm_loadu_ps(src + 3 * ls);
+  _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+  _mm_storeu_ps(dst, r0);
+  _mm_storeu_ps(dst + ld, r1);
+  _mm_storeu_ps(dst + 2 * ld, r2);
+  _mm_storeu_ps(dst + 3 * ld, r3);
+}
+
+void block8_sse(const float *src, int ls, float *dst, int ld) {
+  block4_sse(src, ls, dst, ld);
+  block4_sse(src + 4, ls, dst + 4 * ld, ld);
+  block4_sse(src + 4 * ls, ls, dst + 4, ld);
+  block4_sse(src + 4 * ls + 4, ls, dst + 4 * ld + 4, ld);
+}
+
+int detect_isa() {
+  int isa = TRANSPOSE_ISA_SSE;
+  const char *env = getenv("TRANSPOSE_ISA");
+
+  if (env != NULL && strcmp(env, "scalar") == 0) {
+    isa = TRANSPOSE_ISA_SCALAR;
+  }
+
+  return isa;
+}
+
+#endif /* TRANSPOSE_X86_SIMD */
+
+Block8 block8() {
+  switch (matrix_transpose_isa()) {
+#ifdef TRANSPOSE_X86_SIMD
+  case TRANSPOSE_ISA_SSE:
+    return block8_sse;
+#endif
+  default:
+    return block8_scalar;
+  }
+}
+
+/**
+ * transpose rows [i2b, i2e) x columns [i1b, i1e) of matrix
+ */
+void transposeTile(Block8 kernel, const float *matrix, float *trans, int n1, int n2,
+    int i1b, int i1e, int i2b, int i2e) {
+  int i1f = i1b + (i1e - i1b) / 8 * 8;
+  int i2f = i2b + (i2e - i2b) / 8 * 8;
+
+  /// down the columns of the tile, so that consecutive blocks extend the same 8 rows of trans
+  for (int i1 = i1b; i1 < i1f; i1 += 8) {
+    for (int i2 = i2b; i2 < i2f; i2 += 8) {
+      kernel(matrix + (size_t)i2 * n1 + i1, n1, trans + (size_t)i1 * n2 + i2, n2);
+    }
+  }
+
+  /// ragged right columns and bottom rows of the tile
+  for (int i2 = i2b; i2 < i2e; i2++) {
+    for (int i1 = (i2 < i2f ? i1f : i1b); i1 < i1e; i1++) {
+      trans[(size_t)i1 * n2 + i2] = matrix[(size_t)i2 * n1 + i1];
+    }
+  }
+}
+
+/**
+ * exchange the 8x8 block at a with the transpose of the block at b, a and b
+ * may be the same block on the diagonal
+ */
+void swapBlock(Block8 kernel, float *a, float *b, int n) {
+  float ta[64];
+  float tb[64];
+  for (int r = 0; r < 8; r++) {
+    std::copy(a + (size_t)r * n, a + (size_t)r * n + 8, ta + r * 8);
+    std::copy(b + (size_t)r * n, b + (size_t)r * n + 8, tb + r * 8);
+  }
+  kernel(ta, 8, b, n);
+  kernel(tb, 8, a, n);
+}
+
+void transposeSquareInplace(Block8 kernel, float *matrix, int n) {
+  const int T = TRANSPOSE_TILE;
+  int n8 = n / 8 * 8;
+  int ntile = (n8 + T - 1) / T;
+
+  /// tile row ti swaps with the tiles right of the diagonal, the later rows have less work
+#pragma omp parallel for schedule(dynamic) if((long)n * n >= TRANSPOSE_OMP_MIN)
+  for (int ti = 0; ti < ntile; ti++) {
+    int rb = ti * T;
+    int re = std::min(rb + T, n8);
+    for (int tj = ti; tj < ntile; tj++) {
+      int cb = tj * T;
+      int ce = std::min(cb + T, n8);
+      for (int r = rb; r < re; r += 8) {
+        for (int c = (ti == tj ? r : cb); c < ce; c += 8) {
+          swapBlock(kernel, matrix + (size_t)r * n + c, matrix + (size_t)c * n + r, n);
+        }
+      }
+    }
+  }
+
+  /// pairs with a coordinate beyond the last full block
+  for (int i = 0; i < n; i++) {
+    for (int j = std::max(i + 1, n8); j < n; j++) {
+      std::swap(matrix[(size_t)i * n + j], matrix[(size_t)j * n + i]);
+    }
+  }
+}
+
+/**
+ * the longest piece of at most TRANSPOSE_PIECE floats that n is a multiple of
+ */
+int pieceOf(int n) {
+  for (int b = TRANSPOSE_PIECE; b > 1; b--) {
+    if (n % b == 0) {
+      return b;
+    }
+  }
+  return 1;
+}
+
+/**
+ * transpose a rows x cols matrix of b float elements by following the cycles
+ * of the permutation: element p = r * cols + c goes to c * rows + r, which is
+ * p * rows modulo rows * cols - 1, so the element coming to q is the one at
+ * q * cols modulo rows * cols - 1. one bit per element marks the moved ones
+ */
+void transposeCycles(float *matrix, int rows, int cols, int b) {
+  if (rows == 1 || cols == 1) {
+    return;
+  }
+
+  long last = (long)rows * cols - 1;
+  std::vector<bool> moved(last + 1, false);
+  std::vector<float> hold(b);
+
+  for (long start = 1; start < last; start++) {
+    if (moved[start]) {
+      continue;
+    }
+    std::copy(matrix + start * b, matrix + (start + 1) * b, hold.begin());
+    long cur = start;
+    for (;;) {
+      moved[cur] = true;
+      long src = cur * cols % last;
+      if (src == start) {
+        break;
+      }
+      std::copy(matrix + src * b, matrix + (src + 1) * b, matrix + cur * b);
+      cur = src;
+    }
+    std::copy(hold.begin(), hold.end(), matrix + cur * b);
+  }
+}
+
+/**
+ * transpose nblock consecutive blocks of rows rows of cols floats, each
+ * through the scratch and back to its place
+ */
+void transposeBlocks(float *matrix, int rows, int cols, int nblock, std::vector<float> &scratch) {
+  size_t size = (size_t)rows * cols;
+  scratch.resize(size);
+  for (int i = 0; i < nblock; i++) {
+    float *block = matrix + i * size;
+    matrix_transpose(block, &scratch[0], cols, rows);
+    std::copy(scratch.begin(), scratch.end(), block);
+  }
+}
+
+/**
+ * the rows are cut into pieces of b floats, the longest piece either
+ * dimension is a multiple of. when it is n1, the n2 x n1 / b matrix of pieces
+ * is transposed, which leaves strips of n2 pieces, each an n2 x b matrix that
+ * is transposed on its own. when it is n2, the rows go in blocks of b, and a
+ * block transposed on its own is a column of n1 pieces of the n2 / b x n1
+ * matrix of pieces that is transposed last. only one strip or block is copied
+ */
+void transposeRectInplace(float *matrix, int n1, int n2) {
+  int b1 = pieceOf(n1);
+  int b2 = pieceOf(n2);
+  std::vector<float> scratch;
+
+  if (b1 >= b2) {
+    transposeCycles(matrix, n2, n1 / b1, b1);
+    if (b1 > 1) {
+      transposeBlocks(matrix, n2, b1, n1 / b1, scratch);
+    }
+  } else {
+    transposeBlocks(matrix, b2, n1, n2 / b2, scratch);
+    transposeCycles(matrix, n2 / b2, n1, b2);
+  }
+}
+
+} /* namespace */
+
+int matrix_transpose_isa() {
+  static int isa = -1;
+  if (isa < 0) {
+#ifdef TRANSPOSE_X86_SIMD
+    isa = detect_isa();
+#else
+    isa = TRANSPOSE_ISA_SCALAR;
+#endif
+  }
+  return isa;
+}
+
+const char *matrix_transpose_isa_name() {
+  switch (matrix_transpose_isa()) {
+  case TRANSPOSE_ISA_SSE:
+    return "sse";
+  default:
+    return "scalar";
+  }
+}
+
+void matrix_transpose(const float *matrix, float *trans, int n1, int n2)
+/*< matrix transpose: matrix tansposed to be trans >*/
+{
+  const int T = TRANSPOSE_TILE;
+  Block8 kernel = block8();
+  int ntile1 = (n1 + T - 1) / T;
+  int ntile2 = (n2 + T - 1) / T;
+  long ntile = (long)ntile1 * ntile2;
+
+#pragma omp parallel for schedule(static) if((long)n1 * n2 >= TRANSPOSE_OMP_MIN)
+  for (long t = 0; t < ntile; t++) {
+    int i1b = (int)(t % ntile1) * T;
+    int i2b = (int)(t / ntile1) * T;
+    transposeTile(kernel, matrix, trans, n1, n2, i1b, std::min(i1b + T, n1), i2b, std::min(i2b + T, n2));
+  }
+}
+
+void matrix_transpose_inplace(float *matrix, int n1, int n2) {
+  if (n1 == n2) {
+    transposeSquareInplace(block8(), matrix, n1);
+    return;
+  }
+
+  transposeRectInplace(matrix, n1, n2);
+}
@@ -0,0 +1,42 @@
+/*
+ * matrix-transpose.h
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+#ifndef SRC_COMMON_MATRIX_TRANSPOSE_H_
+#define SRC_COMMON_MATRIX_TRANSPOSE_H_
+
+enum {
+  TRANSPOSE_ISA_SCALAR = 0,
+  TRANSPOSE_ISA_SSE = 1
+};
+
+/**
+ * instruction set of the 8x8 micro kernel, sse on x86_64 and the portable
+ * loop elsewhere. set TRANSPOSE_ISA=scalar in the environment to force the
+ * portable loop.
+ */
+int matrix_transpose_isa();
+const char *matrix_transpose_isa_name();
+
+/**
+ * matrix has n2 rows of n1 floats, trans gets n1 rows of n2 floats:
+ * trans[i2 + n2 * i1] = matrix[i1 + n1 * i2].
+ * the matrix is cut into tiles that fit in L1, every tile is transposed with
+ * 8x8 in-register blocks, the tiles are shared by the openmp threads
+ */
+void matrix_transpose(const float *matrix, float *trans, int n1, int n2);
+
+/**
+ * same result as matrix_transpose, written back to matrix.
+ * a square matrix is transposed by swapping the mirrored blocks. a
+ * rectangular one is transposed as a matrix of row pieces of up to 32 floats
+ * by following the cycles of the permutation, and the strips of pieces are
+ * transposed one by one through a scratch strip, so the extra memory is 32
+ * rows or columns and a bit per piece
+ */
+void matrix_transpose_inplace(float *matrix, int n1, int n2);
+
+#endif /* SRC_COMMON_MATRIX_TRANSPOSE_H_ */
@@ -6,6 +6,7 @@
  */
 
 #include <cstdlib>
+#include <algorithm>
 #include "mpi-utility.h"
 
 void MpiInplaceReduce(void *buf, int count, MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm comm) {
@@ -18,3 +19,133 @@ void MpiInplaceReduce(void *buf, int count, MPI_Datatype datatype, MPI_Op op, in
     MPI_Reduce(buf, NULL, count, datatype, op, root, comm);
   }
 }
+
+void MpiAllreduceSum(const std::vector<double> &local, std::vector<float> &global, MPI_Comm comm) {
+  std::vector<double> sum(local);
+  MpiSumPipeline pipeline(sum, comm);
+  pipeline.post(sum.size());
+  pipeline.allgather(global);
+}
+
+float MpiSumByShot(const std::vector<float> &pershot, MPI_Comm comm) {
+  std::vector<float> all(pershot.size());
+  MPI_Allreduce(const_cast<float *>(&pershot[0]), &all[0], pershot.size(), MPI_FLOAT, MPI_SUM, comm);
+
+  float sum = 0.0f;
+  for (size_t i = 0; i < all.size(); i++) {
+    sum += all[i];
+  }
+  return sum;
+}
+
+const size_t MpiSumPipeline::CHUNK;
+const size_t MpiSumPipeline::SCATTER_MIN;
+
+MpiSumPipeline::MpiSumPipeline(std::vector<double> &buf, MPI_Comm comm) :
+  buf(buf), comm(comm), size(buf.size()), posted(0)
+{
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &np);
+  reduceScatter = size >= SCATTER_MIN;
+}
+
+MpiSumPipeline::~MpiSumPipeline() {
+  waitAll();
+}
+
+size_t MpiSumPipeline::begin(int r) const {
+  return reduceScatter ? size * r / np : 0;
+}
+
+size_t MpiSumPipeline::end(int r) const {
+  return reduceScatter ? size * (r + 1) / np : size;
+}
+
+size_t MpiSumPipeline::begin() const {
+  return begin(rank);
+}
+
+size_t MpiSumPipeline::end() const {
+  return end(rank);
+}
+
+void MpiSumPipeline::post(size_t end) {
+  end = std::min(end, size);
+
+  /// chunks never straddle the boundary of two owners, so every chunk has one root
+  while (posted < end) {
+    int owner = 0;
+    size_t e = std::min(posted + CHUNK, size);
+    if (reduceScatter) {
+      while (this->end(owner) <= posted) {
+        owner++;
+      }
+      e = std::min(e, this->end(owner));
+    }
+    if (e > end) {
+      break;
+    }
+
+    MPI_Request req;
+    int count = e - posted;
+    if (!reduceScatter) {
+      MPI_Iallreduce(MPI_IN_PLACE, &buf[posted], count, MPI_DOUBLE, MPI_SUM, comm, &req);
+    } else if (owner == rank) {
+      MPI_Ireduce(MPI_IN_PLACE, &buf[posted], count, MPI_DOUBLE, MPI_SUM, owner, comm, &req);
+    } else {
+      MPI_Ireduce(&buf[posted], NULL, count, MPI_DOUBLE, MPI_SUM, owner, comm, &req);
+    }
+    requests.push_back(req);
+    posted = e;
+  }
+
+  /// the non blocking collectives only move on inside MPI calls
+  if (!requests.empty()) {
+    int done;
+    MPI_Testall(requests.size(), &requests[0], &done, MPI_STATUSES_IGNORE);
+  }
+}
+
+void MpiSumPipeline::postByShot(const std::vector<float> &pershot) {
+  MPI_Request req;
+  shots.resize(pershot.size());
+  MPI_Iallreduce(const_cast<float *>(&pershot[0]), &shots[0], pershot.size(), MPI_FLOAT, MPI_SUM, comm, &req);
+  requests.push_back(req);
+}
+
+void MpiSumPipeline::waitAll() {
+  if (!requests.empty()) {
+    MPI_Waitall(requests.size(), &requests[0], MPI_STATUSES_IGNORE);
+    requests.clear();
+  }
+}
+
+void MpiSumPipeline::allgather(std::vector<float> &global) {
+  post(size);
+  waitAll();
+
+  global.resize(size);
+  for (size_t i = begin(); i < end(); i++) {
+    global[i] = buf[i];
+  }
+
+  if (reduceScatter) {
+    std::vector<int> counts(np);
+    std::vector<int> displs(np);
+    for (int r = 0; r < np; r++) {
+      counts[r] = end(r) - begin(r);
+      displs[r] = begin(r);
+    }
+    MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, &global[0], &counts[0], &displs[0], MPI_FLOAT, comm);
+  }
+}
+
+float MpiSumPipeline::sumByShot() {
+  waitAll();
+
+  float sum = 0.0f;
+  for (size_t i = 0; i < shots.size(); i++) {
+    sum += shots[i];
+  }
+  return sum;
+}
@@ -9,7 +9,78 @@
 #define SRC_COMMON_MPI_UTILITY_H_
 
 #include <mpi.h>
+#include <vector>
 
 void MpiInplaceReduce(void *buf, int count, MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm comm);
 
+/**
+ * sum the partial sums of all ranks in double precision and round the result
+ * to float once. the float result does not depend on which rank summed which
+ * shots, up to the rounding of the double sums
+ */
+void MpiAllreduceSum(const std::vector<double> &local, std::vector<float> &global, MPI_Comm comm = MPI_COMM_WORLD);
+
+/**
+ * every entry of pershot is set by the one rank that ran the shot and is 0 on
+ * the others. returns the sum over the shots in shot order, it is the same on
+ * every rank and for any number of ranks
+ */
+float MpiSumByShot(const std::vector<float> &pershot, MPI_Comm comm = MPI_COMM_WORLD);
+
+/**
+ * sum of a double buffer over the ranks, started a chunk at a time while the
+ * rest of the buffer is still being finished, so the communication runs
+ * behind the local work. the sum is done in place, buf is consumed.
+ *
+ * small buffers are summed with MPI_Iallreduce. buffers of at least
+ * SCATTER_MIN entries are reduce-scattered: rank r gets the sums of the
+ * entries [begin(r), end(r)), every chunk is reduced to the rank that owns it,
+ * and allgather then shares the owned sums as floats, half the bytes of a
+ * double allreduce.
+ *
+ * every rank makes the same calls in the same order. the parts are fixed at
+ * construction, buf may be released once the sums are taken.
+ */
+class MpiSumPipeline {
+public:
+  static const size_t CHUNK = 1 << 17;        /// entries per collective
+  static const size_t SCATTER_MIN = 1 << 18;
+
+public:
+  MpiSumPipeline(std::vector<double> &buf, MPI_Comm comm = MPI_COMM_WORLD);
+  ~MpiSumPipeline();
+
+  /// the local entries [0, end) are final, start the sums of their chunks
+  void post(size_t end);
+  /// start the sum of the per shot values, see MpiSumByShot. pershot is read until the sums are taken
+  void postByShot(const std::vector<float> &pershot);
+
+  /// the sum of every entry, on every rank
+  void allgather(std::vector<float> &global);
+  /// the sum of the per shot values, the same as MpiSumByShot
+  float sumByShot();
+
+  size_t begin(int r) const;
+  size_t end(int r) const;
+  size_t begin() const;
+  size_t end() const;
+
+private:
+  MpiSumPipeline(const MpiSumPipeline &);
+  MpiSumPipeline &operator=(const MpiSumPipeline &);
+
+  void waitAll();
+
+private:
+  std::vector<double> &buf;
+  MPI_Comm comm;
+  size_t size;
+  int rank;
+  int np;
+  bool reduceScatter;
+  size_t posted;
+  std::vector<MPI_Request> requests;
+  std::vector<float> shots;
+};
+
 #endif /* SRC_COMMON_MPI_UTILITY_H_ */
@@ -0,0 +1,91 @@
+/*
+ * omp-utility.cpp
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+#include <algorithm>
+#include "omp-utility.h"
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+int shotGroupCount(int nshotpar, int ntask) {
+  return std::max(1, std::min(nshotpar, ntask));
+}
+
+int beginShotGroups(int ngroups, int threadsPerShot, int &levels) {
+  int nthreads = 1;
+  levels = 1;
+#ifdef USE_OPENMP
+  nthreads = omp_get_max_threads();
+  levels = omp_get_max_active_levels();
+  if (ngroups > 1) {
+    omp_set_max_active_levels(2);
+  }
+#endif
+  if (threadsPerShot <= 0) {
+    threadsPerShot = std::max(1, nthreads / ngroups);
+  }
+  return threadsPerShot;
+}
+
+void endShotGroups(int levels) {
+#ifdef USE_OPENMP
+  omp_set_max_active_levels(levels);
+#endif
+}
+
+void enterShotGroup(int ngroups, int threadsPerShot) {
+#ifdef USE_OPENMP
+  /// with one group the kernels keep the default team of the rank
+  if (ngroups > 1) {
+    omp_set_num_threads(threadsPerShot);
+  }
+#endif
+}
+
+int shotGroupId() {
+#ifdef USE_OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+namespace {
+
+template <typename T>
+void pairwiseReduce(std::vector<std::vector<T> > &parts, int begin, int end) {
+  const int nparts = parts.size();
+  if (nparts < 2) {
+    return;
+  }
+
+#ifdef USE_OPENMP
+  #pragma omp parallel for
+#endif
+  for (int i = begin; i < end; i++) {
+    for (int stride = 1; stride < nparts; stride *= 2) {
+      for (int j = 0; j + stride < nparts; j += 2 * stride) {
+        parts[j][i] += parts[j + stride][i];
+      }
+    }
+  }
+}
+
+} /// end of name space
+
+void treeReduce(std::vector<std::vector<float> > &parts) {
+  pairwiseReduce(parts, 0, parts.empty() ? 0 : parts[0].size());
+}
+
+void treeReduce(std::vector<std::vector<double> > &parts) {
+  pairwiseReduce(parts, 0, parts.empty() ? 0 : parts[0].size());
+}
+
+void treeReduce(std::vector<std::vector<double> > &parts, int begin, int end) {
+  pairwiseReduce(parts, begin, end);
+}
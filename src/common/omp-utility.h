@@ -0,0 +1,48 @@
+/*
+ * omp-utility.h
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+#ifndef SRC_COMMON_OMP_UTILITY_H_
+#define SRC_COMMON_OMP_UTILITY_H_
+
+#include <vector>
+
+/**
+ * helpers for running several shots of one rank at the same time.
+ * every shot group is one thread of an outer parallel region, the stencil
+ * kernels called by that thread open a nested team of threadsPerShot threads.
+ */
+
+/// # of groups used for ntask shots, nshotpar is clipped to [1, ntask]
+int shotGroupCount(int nshotpar, int ntask);
+
+/**
+ * threads of every group, threadsPerShot <= 0 shares the threads of the rank
+ * evenly. it also enables the nested level when ngroups > 1, so call it
+ * outside of the parallel region. levels gets the max active levels before
+ * the call, for endShotGroups
+ */
+int beginShotGroups(int ngroups, int threadsPerShot, int &levels);
+
+/// restore the max active levels saved by beginShotGroups, after the parallel region of the groups
+void endShotGroups(int levels);
+
+/// called by every group thread before it starts its shots
+void enterShotGroup(int ngroups, int threadsPerShot);
+
+/// id of the calling group thread, 0 outside of a parallel region
+int shotGroupId();
+
+/**
+ * parts[0] += parts[1] + ... in a pairwise tree, the order of the additions
+ * only depends on parts.size()
+ */
+void treeReduce(std::vector<std::vector<float> > &parts);
+void treeReduce(std::vector<std::vector<double> > &parts);
+/// the same on the entries [begin, end) only
+void treeReduce(std::vector<std::vector<double> > &parts, int begin, int end);
+
+#endif /* SRC_COMMON_OMP_UTILITY_H_ */
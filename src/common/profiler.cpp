@@ -0,0 +1,388 @@
+/*
+ * profiler.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: rice
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <sstream>
+#include <algorithm>
+#include <pthread.h>
+#include "profiler.h"
+#include "logger.h"
+
+namespace {
+
+typedef long long Nanos;
+
+Nanos now() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (Nanos)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+struct Node {
+  Node(const char *name, int parent) : name(name), parent(parent), calls(0), total(0), start(0) {}
+  const char *name;
+  int parent;
+  std::vector<int> children;
+  long calls;
+  Nanos total;
+  Nanos start;
+};
+
+/// a region call of the trace
+struct Event {
+  const char *name;
+  Nanos begin;
+  Nanos end;
+};
+
+/// events kept per thread, about 24 MB
+const size_t MAX_EVENTS = 1 << 20;
+
+struct ThreadProfile {
+  explicit ThreadProfile(int id) : id(id), dropped(0) {
+    nodes.push_back(Node("", -1));
+    stack.push_back(0);
+  }
+
+  /// the child region name of node parent, created on the first call
+  int child(int parent, const char *name) {
+    const std::vector<int> &c = nodes[parent].children;
+    for (size_t i = 0; i < c.size(); i++) {
+      const char *n = nodes[c[i]].name;
+      if (n == name || std::strcmp(n, name) == 0) {
+        return c[i];
+      }
+    }
+    int k = nodes.size();
+    nodes.push_back(Node(name, parent));
+    nodes[parent].children.push_back(k);
+    return k;
+  }
+
+  int id;
+  std::vector<Node> nodes;   /// nodes[0] is the root
+  std::vector<int> stack;    /// the open regions, the root first
+  std::vector<Event> events;
+  long dropped;
+};
+
+bool profiling = false;
+bool tracing = false;
+Nanos origin = 0;
+
+pthread_mutex_t registryLock = PTHREAD_MUTEX_INITIALIZER;
+std::vector<ThreadProfile *> registry;
+__thread ThreadProfile *current = NULL;
+
+ThreadProfile &self() {
+  if (current == NULL) {
+    pthread_mutex_lock(&registryLock);
+    current = new ThreadProfile(registry.size());
+    registry.push_back(current);
+    pthread_mutex_unlock(&registryLock);
+  }
+  return *current;
+}
+
+typedef std::vector<std::string> RegionPath;
+
+struct Stat {
+  Stat() : calls(0), seconds(0), threads(0) {}
+  long calls;
+  double seconds;
+  int threads;
+};
+
+struct Summary {
+  Summary() : calls(0), threads(0), ranks(0), min(0), max(0), sum(0) {}
+  long calls;
+  int threads;
+  int ranks;
+  double min, max, sum;
+};
+
+void collect(const ThreadProfile &tp, int n, RegionPath &path, std::map<RegionPath, Stat> &stats) {
+  const Node &node = tp.nodes[n];
+  if (n != 0) {
+    path.push_back(node.name);
+    Stat &s = stats[path];
+    s.calls += node.calls;
+    s.seconds += node.total * 1e-9;
+    s.threads++;
+  }
+  for (size_t i = 0; i < node.children.size(); i++) {
+    collect(tp, node.children[i], path, stats);
+  }
+  if (n != 0) {
+    path.pop_back();
+  }
+}
+
+std::string joinPath(const RegionPath &path) {
+  std::string s;
+  for (size_t i = 0; i < path.size(); i++) {
+    s += (i ? "/" : "") + path[i];
+  }
+  return s;
+}
+
+RegionPath splitPath(const std::string &s) {
+  RegionPath path;
+  std::stringstream ss(s);
+  std::string name;
+  while (std::getline(ss, name, '/')) {
+    path.push_back(name);
+  }
+  return path;
+}
+
+/**
+ * the regions of every rank on rank 0, a rank missing a region counts as 0 s
+ */
+std::map<RegionPath, Summary> gatherSummary(const std::map<RegionPath, Stat> &local, bool mpi, MPI_Comm comm) {
+  int rank = 0, np = 1;
+  if (mpi) {
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &np);
+  }
+
+  std::ostringstream os;
+  os.precision(17);
+  for (std::map<RegionPath, Stat>::const_iterator it = local.begin(); it != local.end(); ++it) {
+    os << it->second.calls << '\t' << it->second.seconds << '\t' << it->second.threads << '\t'
+       << joinPath(it->first) << '\n';
+  }
+  std::string text = os.str();
+
+  int len = text.size();
+  std::vector<int> lens(np, len);
+  std::vector<int> displs(np, 0);
+  std::vector<char> all(text.begin(), text.end());
+  all.push_back(0);
+  if (mpi) {
+    MPI_Gather(&len, 1, MPI_INT, &lens[0], 1, MPI_INT, 0, comm);
+    for (int r = 1; r < np; r++) {
+      displs[r] = displs[r - 1] + lens[r - 1];
+    }
+    all.resize(rank == 0 ? displs[np - 1] + lens[np - 1] + 1 : 1);
+    MPI_Gatherv(const_cast<char *>(text.data()), len, MPI_CHAR, &all[0], &lens[0], &displs[0], MPI_CHAR, 0, comm);
+  }
+
+  std::map<RegionPath, Summary> summary;
+  if (rank != 0) {
+    return summary;
+  }
+
+  std::vector<std::map<RegionPath, Stat> > ranks(np);
+  for (int r = 0; r < np; r++) {
+    std::istringstream is(std::string(&all[displs[r]], lens[r]));
+    std::string line;
+    while (std::getline(is, line)) {
+      std::istringstream ls(line);
+      Stat s;
+      std::string path;
+      ls >> s.calls >> s.seconds >> s.threads;
+      ls.ignore(1);
+      std::getline(ls, path);
+      ranks[r][splitPath(path)] = s;
+      summary[splitPath(path)];
+    }
+  }
+
+  for (std::map<RegionPath, Summary>::iterator it = summary.begin(); it != summary.end(); ++it) {
+    Summary &sum = it->second;
+    for (int r = 0; r < np; r++) {
+      std::map<RegionPath, Stat>::const_iterator s = ranks[r].find(it->first);
+      double t = s == ranks[r].end() ? 0 : s->second.seconds;
+      if (s != ranks[r].end()) {
+        sum.calls += s->second.calls;
+        sum.threads += s->second.threads;
+        sum.ranks++;
+      }
+      sum.min = r == 0 ? t : std::min(sum.min, t);
+      sum.max = r == 0 ? t : std::max(sum.max, t);
+      sum.sum += t;
+    }
+  }
+
+  return summary;
+}
+
+bool endsWith(const std::string &s, const std::string &suffix) {
+  return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void writeSummary(const std::string &file, const std::map<RegionPath, Summary> &summary, int np) {
+  FILE *fp = fopen(file.c_str(), "w");
+  if (fp == NULL) {
+    ERROR() << format("cannot write the profile summary %s") % file;
+    return;
+  }
+
+  bool json = endsWith(file, ".json");
+  if (json) {
+    fprintf(fp, "{\n  \"ranks\": %d,\n  \"regions\": [", np);
+  } else {
+    fprintf(fp, "region,depth,calls,threads,ranks,min,avg,max\n");
+  }
+
+  /// the paths sort in tree order, every region right after its parent
+  const char *sep = "\n";
+  for (std::map<RegionPath, Summary>::const_iterator it = summary.begin(); it != summary.end(); ++it) {
+    const Summary &s = it->second;
+    std::string path = joinPath(it->first);
+    if (json) {
+      fprintf(fp, "%s    {\"region\": \"%s\", \"depth\": %d, \"calls\": %ld, \"threads\": %d, \"ranks\": %d, "
+          "\"min\": %.6f, \"avg\": %.6f, \"max\": %.6f}",
+          sep, path.c_str(), (int)it->first.size() - 1, s.calls, s.threads, s.ranks, s.min, s.sum / np, s.max);
+      sep = ",\n";
+    } else {
+      fprintf(fp, "%s,%d,%ld,%d,%d,%.6f,%.6f,%.6f\n",
+          path.c_str(), (int)it->first.size() - 1, s.calls, s.threads, s.ranks, s.min, s.sum / np, s.max);
+    }
+  }
+
+  if (json) {
+    fprintf(fp, "\n  ]\n}\n");
+  }
+  fclose(fp);
+}
+
+void writeTrace(const std::string &prefix, int rank) {
+  char name[32];
+  sprintf(name, "-%02d.json", rank);
+  std::string file = prefix + name;
+  FILE *fp = fopen(file.c_str(), "w");
+  if (fp == NULL) {
+    ERROR() << format("cannot write the profile trace %s") % file;
+    return;
+  }
+
+  fprintf(fp, "{\"traceEvents\": [");
+  const char *sep = "\n";
+  for (size_t t = 0; t < registry.size(); t++) {
+    const ThreadProfile &tp = *registry[t];
+    for (size_t i = 0; i < tp.events.size(); i++) {
+      const Event &e = tp.events[i];
+      fprintf(fp, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+          sep, e.name, rank, tp.id, (e.begin - origin) * 1e-3, (e.end - e.begin) * 1e-3);
+      sep = ",\n";
+    }
+    if (tp.dropped > 0) {
+      WARNING() << format("profile trace: %ld events of thread %d dropped, %lu kept") % tp.dropped % tp.id % MAX_EVENTS;
+    }
+  }
+  fprintf(fp, "\n], \"displayTimeUnit\": \"ms\"}\n");
+  fclose(fp);
+}
+
+} /* namespace */
+
+Profiler::Scope::Scope(const char *name) : on(profiling) {
+  if (on) {
+    ThreadProfile &tp = self();
+    int n = tp.child(tp.stack.back(), name);
+    tp.stack.push_back(n);
+    tp.nodes[n].start = now();
+  }
+}
+
+Profiler::Scope::~Scope() {
+  if (on) {
+    Nanos t = now();
+    ThreadProfile &tp = *current;
+    Node &node = tp.nodes[tp.stack.back()];
+    node.total += t - node.start;
+    node.calls++;
+    if (tracing) {
+      if (tp.events.size() < MAX_EVENTS) {
+        Event e = { node.name, node.start, t };
+        tp.events.push_back(e);
+      } else {
+        tp.dropped++;
+      }
+    }
+    tp.stack.pop_back();
+  }
+}
+
+/**
+ * the thread that took the path already is in it, nothing is attached then
+ */
+Profiler::Attach::Attach(const Path &path) : depth(0) {
+  if (!profiling || path == Profiler::path()) {
+    return;
+  }
+  ThreadProfile &tp = self();
+  for (size_t i = 0; i < path.size(); i++) {
+    tp.stack.push_back(tp.child(tp.stack.back(), path[i]));
+    depth++;
+  }
+}
+
+Profiler::Attach::~Attach() {
+  if (depth > 0) {
+    current->stack.resize(current->stack.size() - depth);
+  }
+}
+
+void Profiler::enable(bool trace) {
+  origin = now();
+  tracing = trace;
+  profiling = true;
+}
+
+bool Profiler::enabled() {
+  return profiling;
+}
+
+Profiler::Path Profiler::path() {
+  Path p;
+  if (profiling) {
+    ThreadProfile &tp = self();
+    for (size_t i = 1; i < tp.stack.size(); i++) {
+      p.push_back(tp.nodes[tp.stack[i]].name);
+    }
+  }
+  return p;
+}
+
+void Profiler::report(const std::string &summary, const std::string &trace, MPI_Comm comm) {
+  if (!profiling) {
+    return;
+  }
+
+  /// a tool without mpi reports as a single rank
+  int mpi = 0;
+  MPI_Initialized(&mpi);
+  int rank = 0, np = 1;
+  if (mpi) {
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &np);
+  }
+
+  std::map<RegionPath, Stat> local;
+  RegionPath path;
+  for (size_t t = 0; t < registry.size(); t++) {
+    collect(*registry[t], 0, path, local);
+  }
+
+  if (!summary.empty()) {
+    std::map<RegionPath, Summary> all = gatherSummary(local, mpi != 0, comm);
+    if (rank == 0) {
+      writeSummary(summary, all, np);
+      INFO() << format("profile of %d regions written to %s") % all.size() % summary;
+    }
+  }
+
+  if (!trace.empty() && tracing) {
+    writeTrace(trace, rank);
+  }
+}
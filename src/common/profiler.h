@@ -0,0 +1,79 @@
+/*
+ * profiler.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: rice
+ */
+
+#ifndef SRC_COMMON_PROFILER_H_
+#define SRC_COMMON_PROFILER_H_
+
+#include <mpi.h>
+#include <string>
+#include <vector>
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+
+/// time the rest of the enclosing block as the region name, nested in the regions around it
+#define PROFILE(name) Profiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+/**
+ * nested timing regions, e.g. epoch / gradient / shot / adjoint / stencil.
+ *
+ * every thread accumulates the calls and the time of its regions in its own
+ * tree, keyed by the path of region names from the root, timed with the
+ * monotonic clock. a region name must be a string literal, it is kept by
+ * pointer. when the profiler is off a region costs one test of a flag.
+ *
+ * a thread started inside a region, e.g. a shot group of an omp parallel,
+ * attaches to the path of the region so that its regions nest under it.
+ *
+ * report merges the threads of every rank, then gives per region the min,
+ * avg and max over the ranks of its time summed over the threads of the
+ * rank. the trace keeps every region call of every thread as a chrome
+ * tracing event, one file per rank.
+ */
+class Profiler {
+public:
+  class Scope {
+  public:
+    explicit Scope(const char *name);
+    ~Scope();
+  private:
+    Scope(const Scope &);
+    void operator=(const Scope &);
+    bool on;
+  };
+
+  /// names of the regions around the calling thread, the outermost first
+  typedef std::vector<const char *> Path;
+
+  class Attach {
+  public:
+    explicit Attach(const Path &path);
+    ~Attach();
+  private:
+    Attach(const Attach &);
+    void operator=(const Attach &);
+    int depth;
+  };
+
+public:
+  /// start profiling, with a chrome trace if trace is true. call it before any region is entered
+  static void enable(bool trace = false);
+  static bool enabled();
+
+  static Path path();
+
+  /**
+   * collective over comm once mpi is initialized, call it when no region is
+   * open in any thread.
+   * summary, unless empty, gets the regions of all the ranks from rank 0:
+   * json when the name ends with .json, csv otherwise. trace, unless empty,
+   * is the prefix of the per rank trace files <trace>-<rank>.json
+   */
+  static void report(const std::string &summary, const std::string &trace, MPI_Comm comm = MPI_COMM_WORLD);
+};
+
+#endif /* SRC_COMMON_PROFILER_H_ */
@@ -0,0 +1,104 @@
+/*
+ * revolve.cpp
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+#include <cstdlib>
+#include "revolve.h"
+#include "logger.h"
+
+Revolve::Revolve(int nsteps, int snaps) :
+  live(0), nforward(0)
+{
+  if (snaps < 1) {
+    ERROR() << "revolve needs at least one snapshot";
+    exit(1);
+  }
+
+  push(TAKESHOT, 0, 0);
+  reverse(0, nsteps, 0, snaps);
+}
+
+const std::vector<Revolve::Step> &Revolve::schedule() const {
+  return steps;
+}
+
+int Revolve::forwardSteps() const {
+  return nforward;
+}
+
+void Revolve::push(Action action, int step, int slot) {
+  Step s = { action, step, slot };
+  steps.push_back(s);
+}
+
+/**
+ * adjoint steps [a, b) in reverse order, slot holds S_a and nsnap counts it
+ */
+void Revolve::reverse(int a, int b, int slot, int nsnap) {
+  while (b > a) {
+    int m = (b - a == 1) ? a : split(a, b, nsnap);
+
+    if (live != a) {
+      push(RESTORE, a, slot);
+      live = a;
+    }
+    if (m > live) {
+      push(ADVANCE, m, -1);
+      nforward += m - live;
+      live = m;
+    }
+
+    /// the last step of the range is taken straight from the live state
+    if (m == b - 1) {
+      push(YOUTURN, m, -1);
+      b = m;
+      continue;
+    }
+
+    push(TAKESHOT, m, slot + 1);
+    reverse(m, b, slot + 1, nsnap - 1);
+    b = m;
+  }
+}
+
+/**
+ * where to put the next snapshot when l = b - a steps are reversed with nsnap
+ * snapshots, this is the rule of the revolve routine. beta(c, r) = (c + r)! / (c! r!)
+ * is the largest l that c snapshots reverse with r forward sweeps
+ */
+int Revolve::split(int a, int b, int nsnap) {
+  long l = b - a;
+  long c = nsnap;
+  long reps = 0;
+  long range = 1;
+  while (range < l) {
+    reps++;
+    range = range * (reps + c) / reps;
+  }
+
+  long bino1 = range * reps / (c + reps);                                  /// beta(c, reps - 1)
+  long bino2 = c > 1 ? bino1 * c / (c + reps - 1) : 1;                     /// beta(c - 1, reps - 1)
+  long bino3 = c == 1 ? 0 : (c > 2 ? bino2 * (c - 1) / (c + reps - 2) : 1); /// beta(c - 2, reps - 1)
+  long bino4 = bino2 * (reps - 1) / c;                                     /// beta(c - 1, reps - 2)
+  long bino5 = c < 3 ? 0 : (c > 3 ? bino3 * (c - 2) / reps : 1);           /// beta(c - 3, reps)
+
+  long m;
+  if (l <= bino1 + bino3) {
+    m = a + bino4;
+  } else if (l >= range - bino5) {
+    m = a + bino1;
+  } else {
+    m = b - bino2 - bino3;
+  }
+
+  if (m <= a) {
+    m = a + 1;
+  }
+  if (m >= b) {
+    m = b - 1;
+  }
+  return m;
+}
@@ -0,0 +1,53 @@
+/*
+ * revolve.h
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+#ifndef SRC_COMMON_REVOLVE_H_
+#define SRC_COMMON_REVOLVE_H_
+
+#include <vector>
+
+/**
+ * binomial checkpointing schedule of Griewank and Walther (Revolve, ACM TOMS
+ * 26, 2000). the state before step i is S_i, step i takes S_i to S_i+1, and
+ * the adjoint of step i needs S_i. the schedule visits the adjoint steps from
+ * nsteps - 1 down to 0 keeping at most snaps states, S_0 included, and
+ * recomputes the fewest forward steps possible for that memory.
+ */
+class Revolve {
+public:
+  enum Action {
+    ADVANCE,  /// run the forward steps from the live state up to S_step
+    TAKESHOT, /// copy the live state S_step to slot
+    RESTORE,  /// copy slot, which holds S_step, to the live state
+    YOUTURN   /// adjoint of step `step`, the live state is S_step
+  };
+
+  struct Step {
+    Action action;
+    int step;
+    int slot;
+  };
+
+public:
+  /// the schedule starts with the live state S_0 and a TAKESHOT of it
+  Revolve(int nsteps, int snaps);
+
+  const std::vector<Step> &schedule() const;
+  int forwardSteps() const; /// forward steps run by the schedule, the first sweep included
+
+private:
+  void reverse(int a, int b, int slot, int nsnap);
+  void push(Action action, int step, int slot);
+  static int split(int a, int b, int nsnap);
+
+private:
+  std::vector<Step> steps;
+  int live;
+  int nforward;
+};
+
+#endif /* SRC_COMMON_REVOLVE_H_ */
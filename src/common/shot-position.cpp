@@ -39,3 +39,24 @@ int ShotPosition::getz(int idx) const {
 ShotPosition ShotPosition::clip(int idx) const {
   return clipRange(idx, idx);
 }
+
+ShotPosition ShotPosition::shiftx(int dx) const {
+  ShotPosition ret = *this;
+  for (int is = 0; is < ns; is++) {
+    ret.pos[is] += nz * dx;
+  }
+
+  return ret;
+}
+
+ShotPosition ShotPosition::coarsen(int k, int nx, int nz) const {
+  ShotPosition ret = *this;
+  ret.nz = nz;
+  for (int is = 0; is < ns; is++) {
+    int x = std::min((getx(is) + k / 2) / k, nx - 1);
+    int z = std::min((getz(is) + k / 2) / k, nz - 1);
+    ret.pos[is] = z + nz * x;
+  }
+
+  return ret;
+}
@@ -15,6 +15,10 @@ public:
   ShotPosition(int szbeg, int sxbeg, int jsz, int jsx, int ns, int nz);
   ShotPosition clipRange(int begin, int end) const;
   ShotPosition clip(int idx) const;
+  /// the same positions moved dx cells along x
+  ShotPosition shiftx(int dx) const;
+  /// the positions on a grid k times coarser of nx * nz cells, rounded to the nearest cell
+  ShotPosition coarsen(int k, int nx, int nz) const;
   int getx(int idx) const;
   int getz(int idx) const;
 
@@ -0,0 +1,92 @@
+/*
+ * shot-scheduler.cpp
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+#include "shot-scheduler.h"
+#include "logger.h"
+
+void shotBlock(int ns, int np, int rank, int &begin, int &end) {
+  begin = (long)ns * rank / np;
+  end = (long)ns * (rank + 1) / np;
+}
+
+int shotBlockOwner(int ns, int np, int is) {
+  int rank = (long)is * np / ns;
+  int begin, end;
+
+  shotBlock(ns, np, rank, begin, end);
+  while (is >= end) {
+    shotBlock(ns, np, ++rank, begin, end);
+  }
+  while (is < begin) {
+    shotBlock(ns, np, --rank, begin, end);
+  }
+  return rank;
+}
+
+ShotScheduler::ShotScheduler(int ns, MPI_Comm comm) : ns(ns), counter(NULL) {
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &np);
+  exhausted.assign(np, 0);
+
+  MPI_Win_allocate(sizeof(int), sizeof(int), MPI_INFO_NULL, comm, &counter, &win);
+
+  int begin, end;
+  shotBlock(ns, np, rank, begin, end);
+  MPI_Win_lock(MPI_LOCK_EXCLUSIVE, rank, 0, win);
+  *counter = begin;
+  MPI_Win_unlock(rank, win);
+  MPI_Barrier(comm);
+}
+
+ShotScheduler::~ShotScheduler() {
+  MPI_Win_free(&win);
+}
+
+int ShotScheduler::next() {
+  const int one = 1;
+  int shot = -1;
+
+#ifdef USE_OPENMP
+  #pragma omp critical(mpi_call)
+#endif
+  {
+    for (int k = 0; k < np && shot < 0; k++) {
+      int victim = (rank + k) % np;
+      if (exhausted[victim]) {
+        continue;
+      }
+
+      int begin, end, is;
+      shotBlock(ns, np, victim, begin, end);
+      MPI_Win_lock(MPI_LOCK_SHARED, victim, 0, win);
+      MPI_Fetch_and_op(&one, &is, MPI_INT, victim, 0, MPI_SUM, win);
+      MPI_Win_unlock(victim, win);
+
+      if (is < end) {
+        shot = is;
+        if (victim != rank) {
+          DEBUG() << format("steal shot %d from rank %d") % shot % victim;
+        }
+      } else {
+        exhausted[victim] = 1;
+      }
+    }
+  }
+
+  return shot;
+}
+
+void ShotScheduler::next(int n, std::vector<int> &shots) {
+  shots.clear();
+  while (static_cast<int>(shots.size()) < n) {
+    int is = next();
+    if (is < 0) {
+      break;
+    }
+    shots.push_back(is);
+  }
+}
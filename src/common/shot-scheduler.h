@@ -0,0 +1,54 @@
+/*
+ * shot-scheduler.h
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+#ifndef SRC_COMMON_SHOT_SCHEDULER_H_
+#define SRC_COMMON_SHOT_SCHEDULER_H_
+
+#include <mpi.h>
+#include <vector>
+
+/// shots [begin, end) owned by rank, every rank owns floor(ns/np) or ceil(ns/np) shots
+void shotBlock(int ns, int np, int rank, int &begin, int &end);
+int shotBlockOwner(int ns, int np, int is);
+
+/**
+ * hands out the shots 0 .. ns - 1 on demand. every rank keeps the counter of
+ * its own block of shots (see shotBlock) in an MPI window. a rank first takes
+ * the shots of its own block, then steals from the blocks of the other ranks
+ * with MPI_Fetch_and_op, so a rank that finishes early simply takes more
+ * shots, and most shots run where their data is. which rank runs a shot
+ * changes from run to run, sums over the shots are only reproducible when
+ * they are taken in shot order, see MpiSumByShot.
+ *
+ * the constructor and the destructor are collective over comm. next() may
+ * be called by several threads of a rank, the calls are serialized, so MPI
+ * has to be initialized with at least MPI_THREAD_SERIALIZED in that case.
+ */
+class ShotScheduler {
+public:
+  ShotScheduler(int ns, MPI_Comm comm = MPI_COMM_WORLD);
+  ~ShotScheduler();
+
+  /// id of the next shot, -1 when all the shots are handed out
+  int next();
+  /// the next n shots at most, none when all the shots are handed out
+  void next(int n, std::vector<int> &shots);
+
+private:
+  ShotScheduler(const ShotScheduler &);
+  ShotScheduler &operator=(const ShotScheduler &);
+
+private:
+  int ns;
+  int rank;
+  int np;
+  int *counter;
+  MPI_Win win;
+  std::vector<char> exhausted;  /// blocks known to be empty
+};
+
+#endif /* SRC_COMMON_SHOT_SCHEDULER_H_ */
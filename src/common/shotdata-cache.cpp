@@ -0,0 +1,84 @@
+/*
+ * shotdata-cache.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: rice
+ */
+
+#include <algorithm>
+#include <cstring>
+#include "shotdata-cache.h"
+#include "logger.h"
+
+ShotDataCache::ShotDataCache(int ns, int size) :
+  size(size), trials(ns), current(ns), currentModel(ns, 0), cached(ns, 0)
+{
+}
+
+/// FNV-1a over the bits of the values
+ShotDataCache::Key ShotDataCache::modelKey(const std::vector<float> &model) {
+  Key h = 14695981039346656037ULL;
+  for (size_t i = 0; i < model.size(); i++) {
+    uint32_t u;
+    std::memcpy(&u, &model[i], sizeof(u));
+    h = (h ^ u) * 1099511628211ULL;
+  }
+  return (h ^ model.size()) * 1099511628211ULL;
+}
+
+void ShotDataCache::putTrial(int is, Key model, const std::vector<float> &data) {
+  std::vector<Trial> &t = trials[is];
+  for (size_t i = 0; i < t.size(); i++) {
+    if (t[i].model == model) {
+      t[i].data.assign(data.begin(), data.begin() + size);
+      return;
+    }
+  }
+
+  t.push_back(Trial());
+  t.back().model = model;
+  t.back().data.assign(data.begin(), data.begin() + size);
+}
+
+void ShotDataCache::accept(Key model) {
+  int nhit = 0;
+  for (size_t is = 0; is < trials.size(); is++) {
+    std::vector<Trial> &t = trials[is];
+    std::vector<float>().swap(current[is]);
+    cached[is] = 0;
+    for (size_t i = 0; i < t.size(); i++) {
+      if (t[i].model == model) {
+        current[is].swap(t[i].data);
+        currentModel[is] = model;
+        cached[is] = 1;
+        nhit++;
+        break;
+      }
+    }
+    std::vector<Trial>().swap(t);
+  }
+
+  DEBUG() << format("shot data cache: model %016llx, %d shots kept from the line search")
+      % (unsigned long long)model % nhit;
+}
+
+bool ShotDataCache::get(int is, Key model, std::vector<float> &data) const {
+  if (!cached[is]) {
+    return false;
+  }
+  if (currentModel[is] != model) {
+    WARNING() << format("shot data cache: shot %d was kept for model %016llx, not for the current %016llx")
+        % is % (unsigned long long)currentModel[is] % (unsigned long long)model;
+    return false;
+  }
+  std::copy(current[is].begin(), current[is].end(), data.begin());
+  return true;
+}
+
+void ShotDataCache::clear() {
+  for (size_t is = 0; is < trials.size(); is++) {
+    std::vector<Trial>().swap(trials[is]);
+    std::vector<float>().swap(current[is]);
+    cached[is] = 0;
+  }
+}
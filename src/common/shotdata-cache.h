@@ -0,0 +1,70 @@
+/*
+ * shotdata-cache.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: rice
+ */
+
+#ifndef SRC_COMMON_SHOTDATA_CACHE_H_
+#define SRC_COMMON_SHOTDATA_CACHE_H_
+
+#include <vector>
+#include <stdint.h>
+
+/**
+ * modeled data of the shots kept from one FWI iteration to the next.
+ *
+ * the line search models every shot in the trial models v + steplen * d of
+ * the current velocity v and puts the data here under the key of the trial
+ * model, as FwiUpdateVelOp::update builds it. when the velocity moves to one
+ * of them, accept(key) makes the data of that trial the data of the current
+ * model and drops the other trials, so the next gradient finds its data
+ * without modeling the shot again. the data is only handed out for the model
+ * it was put under, two step lengths that clip to the same model share it and
+ * a step that is no trial finds nothing.
+ *
+ * this only holds because the data of a shot does not depend on how it was
+ * propagated: alone, in a batch or with the other trial models. the kernels
+ * of fd4t10s-simd.h do the same operations on a shot in all three, with the
+ * floating point mode of the caller, and the active box of a propagation only
+ * leaves out cells that are zero, see ForwardModeling::activeBox. a kernel
+ * that rounded a shot differently, or a box that clipped the wavefield, would
+ * break it. check-dcache compares the cached data with the data modeled again
+ *
+ * the data of a shot is only touched by the thread that models the shot, so
+ * different shots can be put and read at the same time
+ */
+class ShotDataCache {
+public:
+  typedef uint64_t Key;
+
+  /// 64 bit hash of the values of a model, the same models have the same key
+  static Key modelKey(const std::vector<float> &model);
+
+public:
+  ShotDataCache(int ns, int size);
+
+  /// data (size floats) of shot is in the trial model with key model
+  void putTrial(int is, Key model, const std::vector<float> &data);
+  /// the velocity moved to the model with key model
+  void accept(Key model);
+  /// copy the data of shot is in the model with key model to data, false if it is not cached
+  bool get(int is, Key model, std::vector<float> &data) const;
+  /// the velocity changed some other way, nothing cached is valid
+  void clear();
+
+private:
+  struct Trial {
+    Key model;
+    std::vector<float> data;
+  };
+
+private:
+  int size;
+  std::vector<std::vector<Trial> > trials;  /// by shot
+  std::vector<std::vector<float> > current; /// by shot, data of the accepted model
+  std::vector<Key> currentModel;            /// by shot, key of the model of current
+  std::vector<char> cached;                 /// by shot, current holds data
+};
+
+#endif /* SRC_COMMON_SHOTDATA_CACHE_H_ */
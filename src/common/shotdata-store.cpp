@@ -0,0 +1,131 @@
+/*
+ * shotdata-store.cpp
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "shotdata-store.h"
+#include "shot-scheduler.h"
+#include "logger.h"
+#include "common.h"
+
+ShotDataStore::ShotDataStore(sf_file file, int ns, int nt, int ng, MPI_Comm comm) :
+  ns(ns), nt(nt), ng(ng), local(NULL)
+{
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &np);
+  shotBlock(ns, np, rank, shot_begin, shot_end);
+
+  const int shotSize = nt * ng;
+  MPI_Aint localSize = (MPI_Aint)(shot_end - shot_begin) * shotSize * sizeof(float);
+
+  if (sf_gettype(file) != SF_FLOAT || sf_getform(file) != SF_NATIVE) {
+    ERROR() << "shot data has to be native float";
+    exit(1);
+  }
+
+  char *datapath = sf_histstring(file, "in");
+  if (datapath == NULL || strcmp(datapath, "stdin") == 0) {
+    ERROR() << "shot data has to be in a separate binary file";
+    exit(1);
+  }
+
+  MPI_File fh;
+  int err = MPI_File_open(comm, datapath, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh);
+  if (err != MPI_SUCCESS) {
+    char errstr[MPI_MAX_ERROR_STRING];
+    int len;
+    MPI_Error_string(err, errstr, &len);
+    ERROR() << format("%d: %s: %s") % rank % datapath % errstr;
+    MPI_Abort(comm, err);
+  }
+
+  /// one shot is one element, so the count stays small for large surveys
+  MPI_Datatype shotType;
+  MPI_Type_contiguous(shotSize, MPI_FLOAT, &shotType);
+  MPI_Type_commit(&shotType);
+
+  MPI_Offset offset = (MPI_Offset)shot_begin * shotSize * sizeof(float);
+  MPI_Win_allocate(localSize, sizeof(float), MPI_INFO_NULL, comm, &local, &win);
+  MPI_File_read_at_all(fh, offset, local, shot_end - shot_begin, shotType, MPI_STATUS_IGNORE);
+  MPI_File_close(&fh);
+  MPI_Type_free(&shotType);
+  free(datapath);
+
+  MPI_Win_lock(MPI_LOCK_EXCLUSIVE, rank, 0, win);
+  for (int is = shot_begin; is < shot_end; is++) {
+    matrix_transpose_inplace(local + (size_t)(is - shot_begin) * shotSize, nt, ng);
+  }
+  MPI_Win_unlock(rank, win);
+  MPI_Barrier(comm);
+
+  INFO() << format("shot data store: shots [%d, %d) of %d on rank %d") % shot_begin % shot_end % ns % rank;
+}
+
+ShotDataStore::ShotDataStore(int ns, int nt, int ng, MPI_Comm comm) :
+  ns(ns), nt(nt), ng(ng), local(NULL)
+{
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &np);
+  shotBlock(ns, np, rank, shot_begin, shot_end);
+
+  size_t localCount = (size_t)(shot_end - shot_begin) * nt * ng;
+  MPI_Win_allocate(localCount * sizeof(float), sizeof(float), MPI_INFO_NULL, comm, &local, &win);
+  std::fill(local, local + localCount, 0.0f);
+  MPI_Barrier(comm);
+}
+
+ShotDataStore::~ShotDataStore() {
+  release();
+}
+
+void ShotDataStore::release() {
+  if (win != MPI_WIN_NULL) {
+    MPI_Win_free(&win);
+    local = NULL;
+  }
+}
+
+void ShotDataStore::put(int is, const float *src) {
+  if (!owns(is)) {
+    ERROR() << format("shot %d is not stored on rank %d") % is % rank;
+    exit(1);
+  }
+
+  const int shotSize = nt * ng;
+  MPI_Win_lock(MPI_LOCK_EXCLUSIVE, rank, 0, win);
+  memcpy(local + (size_t)(is - shot_begin) * shotSize, src, sizeof(float) * shotSize);
+  MPI_Win_unlock(rank, win);
+}
+
+bool ShotDataStore::owns(int is) const {
+  return is >= shot_begin && is < shot_end;
+}
+
+void ShotDataStore::get(int is, float *dst) const {
+  const int shotSize = nt * ng;
+
+  if (owns(is)) {
+    memcpy(dst, local + (size_t)(is - shot_begin) * shotSize, sizeof(float) * shotSize);
+    return;
+  }
+
+  int owner = shotBlockOwner(ns, np, is);
+  int begin, end;
+  shotBlock(ns, np, owner, begin, end);
+  MPI_Aint disp = (MPI_Aint)(is - begin) * shotSize;
+
+#ifdef USE_OPENMP
+  #pragma omp critical(mpi_call)
+#endif
+  {
+    MPI_Win_lock(MPI_LOCK_SHARED, owner, 0, win);
+    MPI_Get(dst, shotSize, MPI_FLOAT, owner, disp, shotSize, MPI_FLOAT, win);
+    MPI_Win_unlock(owner, win);
+  }
+  DEBUG() << format("fetch shot %d from rank %d") % is % owner;
+}
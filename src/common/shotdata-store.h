@@ -0,0 +1,56 @@
+/*
+ * shotdata-store.h
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+#ifndef SRC_COMMON_SHOTDATA_STORE_H_
+#define SRC_COMMON_SHOTDATA_STORE_H_
+
+extern "C" {
+#include <rsf.h>
+}
+#include <mpi.h>
+#include <vector>
+
+/**
+ * observed data partitioned by shot. every rank reads only its own block of
+ * shots (see shotBlock in shot-scheduler.h) with one collective MPI-IO read,
+ * and exposes it in an MPI window. a shot of another rank, e.g. one taken by
+ * the ShotScheduler from that rank, is fetched on demand with MPI_Get, so the
+ * memory of a rank scales with ns / np instead of ns.
+ *
+ * the shots are stored the same way as ShotDataReader::serialRead does.
+ * the constructor, release and the destructor are collective over comm.
+ */
+class ShotDataStore {
+public:
+  ShotDataStore(sf_file file, int ns, int nt, int ng, MPI_Comm comm = MPI_COMM_WORLD);
+  /// the same partition of ns shots, all zero, to be filled with put
+  ShotDataStore(int ns, int nt, int ng, MPI_Comm comm = MPI_COMM_WORLD);
+  ~ShotDataStore();
+
+  /// copy shot is (nt * ng floats) to dst, thread safe like ShotScheduler::next()
+  void get(int is, float *dst) const;
+  /// copy src to shot is, which this rank owns. the ranks synchronize, e.g.
+  /// with MPI_Barrier, before another rank gets the shot
+  void put(int is, const float *src);
+  bool owns(int is) const;
+  /// free the window, the shots can't be read any more. a store that lives
+  /// until the end of main must be released before MPI_Finalize
+  void release();
+
+private:
+  ShotDataStore(const ShotDataStore &);
+  ShotDataStore &operator=(const ShotDataStore &);
+
+private:
+  int ns, nt, ng;
+  int rank, np;
+  int shot_begin, shot_end;
+  float *local;  /// the shots [shot_begin, shot_end), memory of the window
+  MPI_Win win;
+};
+
+#endif /* SRC_COMMON_SHOTDATA_STORE_H_ */
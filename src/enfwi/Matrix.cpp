@@ -71,6 +71,10 @@ void Matrix::readFromFile(const std::string &filename) {
 }
 
 void Matrix::print() const {
+  if (!LOG_ENABLED(logDEBUG)) {
+    return;
+  }
+
   std::stringstream ss;
   TRACE() << "print in column-major order";
   for (int col = 0; col < getNumCol(); col++) {
@@ -17,6 +17,7 @@
 #include "dgesvd.h"
 #include "aux.h"
 #include "ReguFactor.h"
+#include "profiler.h"
 
 namespace {
 //std::vector<float> createAMean(const std::vector<float *> &velSet, int modelSize) {
@@ -57,6 +58,7 @@ EnkfAnalyze::EnkfAnalyze(const ForwardModeling &fm, const std::vector<float> &wl
 }
 
 void EnkfAnalyze::analyze(std::vector<float*>& totalVelSet, std::vector<float *> &velSet) const {
+  PROFILE("enkf analyze");
   std::vector<int> code = enkfRandomCodes.genPlus1Minus1(fm.getns());
   Matrix gainMatrix = calGainMatrix(velSet, code);
 
@@ -113,6 +115,7 @@ void EnkfAnalyze::analyze(std::vector<float*>& totalVelSet, std::vector<float *>
 }
 
 void EnkfAnalyze::pAnalyze(std::vector<float *> &velSet, Matrix &lambdaSet, Matrix &ratioSet) const {
+  PROFILE("enkf analyze");
   std::vector<int> code = enkfRandomCodes.genPlus1Minus1(fm.getns());
 
   int local_n = velSet.size();
@@ -136,7 +139,8 @@ void EnkfAnalyze::pAnalyze(std::vector<float *> &velSet, Matrix &lambdaSet, Matr
   int nSamples = N;
   MPI_Bcast(&nSamples, 1, MPI_INT, 0, MPI_COMM_WORLD);
 
-  Matrix::value_type sum_pGainMatrix = pGetSum(pGainMatrix, nSamples);
+  /// the checksums are collective, the ranks all skip them when debug is off
+  Matrix::value_type sum_pGainMatrix = LOG_ENABLED(logDEBUG) ? pGetSum(pGainMatrix, nSamples) : 0;
   if(rank == 0)
   {
     //DEBUG() << "sum of gainMatrix: " << getSum(gainMatrix);
@@ -155,10 +159,10 @@ void EnkfAnalyze::pAnalyze(std::vector<float *> &velSet, Matrix &lambdaSet, Matr
 	sprintf(filename, "HA_Perturb%d.txt", rank);
 	local_A_Perturb.print(filename);
    */
-  Matrix::value_type sum_A_Perturb = pGetSum(local_A_Perturb, nSamples);
+  Matrix::value_type sum_A_Perturb = LOG_ENABLED(logDEBUG) ? pGetSum(local_A_Perturb, nSamples) : 0;
   Matrix local_t5(local_n, modelSize);
   pAlpha_A_B_plus_beta_C(1.0, local_A_Perturb, 1, pGainMatrix, 1, 0.0, local_t5, 1, nSamples);
-  Matrix::value_type sum_local_t5 = pGetSum(local_t5, nSamples);
+  Matrix::value_type sum_local_t5 = LOG_ENABLED(logDEBUG) ? pGetSum(local_t5, nSamples) : 0;
 
   if(rank == 0)
   {
@@ -214,6 +218,7 @@ void EnkfAnalyze::pAnalyze(std::vector<float *> &velSet, Matrix &lambdaSet, Matr
 }
 
 Matrix EnkfAnalyze::calGainMatrix(const std::vector<float*>& velSet, std::vector<int> code) const {
+  PROFILE("gain matrix");
   int local_n = velSet.size();
   int nt = fm.getnt();
   int ng = fm.getng();
@@ -242,10 +247,7 @@ Matrix EnkfAnalyze::calGainMatrix(const std::vector<float*>& velSet, std::vector
     std::vector<float> encsrc  = encoder.encodeSource(wlt);
 
     /// "save encoded data";
-    std::vector<float> trans(encobs.size());
-    matrix_transpose(&encobs[0], &trans[0], ng, nt);
-    const float *pdata = &trans[0];
-    std::copy(pdata, pdata + numDataSamples, local_D.getData() + i * numDataSamples);
+    std::copy(encobs.begin(), encobs.begin() + numDataSamples, local_D.getData() + i * numDataSamples);
 
     DEBUG() << format("sum D %.20f") % getSum(local_D);
 
@@ -258,9 +260,11 @@ Matrix EnkfAnalyze::calGainMatrix(const std::vector<float*>& velSet, std::vector
     newfm.bindVelocity(curvel);
 
     DEBUG() << format("   curvel %.20f") % sum(curvel.dat);
-    newfm.EssForwardModeling(encsrc, dcal);
-    matrix_transpose(&dcal[0], &trans[0], ng, nt);
-    std::copy(pdata, pdata + numDataSamples, local_HOnA.getData() + i * numDataSamples);
+    {
+      PROFILE("forward");
+      newfm.EssForwardModeling(encsrc, dcal);
+    }
+    std::copy(dcal.begin(), dcal.begin() + numDataSamples, local_HOnA.getData() + i * numDataSamples);
 
     DEBUG() << format("   sum HonA %.20f") % getSum(local_HOnA);
   }
@@ -372,6 +376,7 @@ Matrix EnkfAnalyze::calGainMatrix(const std::vector<float*>& velSet, std::vector
 }
 
 Matrix EnkfAnalyze::pCalGainMatrix(const std::vector<float*>& velSet, std::vector<int> code, std::vector<float> &resdSet) const {
+  PROFILE("gain matrix");
   int local_n = velSet.size();
   int nt = fm.getnt();
   int ng = fm.getng();
@@ -401,10 +406,7 @@ Matrix EnkfAnalyze::pCalGainMatrix(const std::vector<float*>& velSet, std::vecto
     std::vector<float> encsrc  = encoder.encodeSource(wlt);
 
     /// "save encoded data";
-    std::vector<float> trans(encobs.size());
-    matrix_transpose(&encobs[0], &trans[0], ng, nt);
-    const float *pdata = &trans[0];
-    std::copy(pdata, pdata + numDataSamples, local_D.getData() + i * numDataSamples);
+    std::copy(encobs.begin(), encobs.begin() + numDataSamples, local_D.getData() + i * numDataSamples);
 
     DEBUG() << format("parallel: sum D %.20f") % getSum(local_D);
 
@@ -417,9 +419,11 @@ Matrix EnkfAnalyze::pCalGainMatrix(const std::vector<float*>& velSet, std::vecto
     newfm.bindVelocity(curvel);
 
     DEBUG() << format("parallel: curvel %.20f") % sum(curvel.dat);
-    newfm.EssForwardModeling(encsrc, dcal);
-    matrix_transpose(&dcal[0], &trans[0], ng, nt);
-    std::copy(pdata, pdata + numDataSamples, local_HOnA.getData() + i * numDataSamples);
+    {
+      PROFILE("forward");
+      newfm.EssForwardModeling(encsrc, dcal);
+    }
+    std::copy(dcal.begin(), dcal.begin() + numDataSamples, local_HOnA.getData() + i * numDataSamples);
 
     DEBUG() << format("parallel: sum HonA %.20f") % getSum(local_HOnA);
 
@@ -435,29 +439,29 @@ Matrix EnkfAnalyze::pCalGainMatrix(const std::vector<float*>& velSet, std::vecto
 
   Matrix t4(N, N); /// HA' * U * SSqInv * U' * (D - HA)
 
-	Matrix::value_type sum_local_D = pGetSum(local_D, N);
-	Matrix::value_type sum_local_HOnA = pGetSum(local_HOnA, N);
+	Matrix::value_type sum_local_D = LOG_ENABLED(logDEBUG) ? pGetSum(local_D, N) : 0;
+	Matrix::value_type sum_local_HOnA = LOG_ENABLED(logDEBUG) ? pGetSum(local_HOnA, N) : 0;
   Matrix local_HA_Perturb(local_n, numDataSamples);
 	pInitGamma(local_HOnA, local_HA_Perturb, nSamples);
-	Matrix::value_type sum_HA_Pertrub = pGetSum(local_HA_Perturb, nSamples);
+	Matrix::value_type sum_HA_Pertrub = LOG_ENABLED(logDEBUG) ? pGetSum(local_HA_Perturb, nSamples) : 0;
   Matrix local_perturbation(local_n, numDataSamples);
   pInitPerturbation(local_perturbation, local_HA_Perturb, rank, nSamples);
-	Matrix::value_type sum_local_perturbation = pGetSum(local_perturbation, nSamples);
+	Matrix::value_type sum_local_perturbation = LOG_ENABLED(logDEBUG) ? pGetSum(local_perturbation, nSamples) : 0;
   std::transform(local_D.getData(), local_D.getData() + local_D.size(), local_perturbation.getData(), local_D.getData(), std::plus<Matrix::value_type>());
-	Matrix::value_type sum_local_D2 = pGetSum(local_D, nSamples);
+	Matrix::value_type sum_local_D2 = LOG_ENABLED(logDEBUG) ? pGetSum(local_D, nSamples) : 0;
   Matrix local_gamma(local_n, numDataSamples);
   pInitGamma(local_perturbation, local_gamma, nSamples);
-	Matrix::value_type sum_local_gamma = pGetSum(local_gamma, nSamples);
+	Matrix::value_type sum_local_gamma = LOG_ENABLED(logDEBUG) ? pGetSum(local_gamma, nSamples) : 0;
   Matrix local_band(local_n, numDataSamples);
   A_plus_B(local_HA_Perturb, local_gamma, local_band);
-	Matrix::value_type sum_local_band = pGetSum(local_band, nSamples);
+	Matrix::value_type sum_local_band = LOG_ENABLED(logDEBUG) ? pGetSum(local_band, nSamples) : 0;
   Matrix local_matU(local_n, numDataSamples);
   Matrix local_matS(1, nSamples);
   Matrix local_matVt(local_n, nSamples);
 	int info = pSvd(local_band, local_matU, local_matS, local_matVt, nSamples);
   Matrix matU2(N, numDataSamples);
   Matrix matVt2(N, nSamples);
-	Matrix::value_type sum_local_matU = pGetSum(local_matU, nSamples);
+	Matrix::value_type sum_local_matU = LOG_ENABLED(logDEBUG) ? pGetSum(local_matU, nSamples) : 0;
   Matrix local_matSSqInv(N, N);
 	if(	rank == 0) {
     DEBUG() << "parallel: sum of local_D: " << sum_local_D;
@@ -495,19 +499,19 @@ Matrix EnkfAnalyze::pCalGainMatrix(const std::vector<float*>& velSet, std::vecto
 	}
   Matrix local_t0(local_n, numDataSamples); /// D - HA
 	A_minus_B(local_D, local_HOnA, local_t0);
-	Matrix::value_type sum_local_t0 = pGetSum(local_t0, nSamples);
+	Matrix::value_type sum_local_t0 = LOG_ENABLED(logDEBUG) ? pGetSum(local_t0, nSamples) : 0;
   Matrix local_t1(local_n, nSamples); /// U' * (D - HA)
   pAlpha_ATrans_B_plus_beta_C(1.0, local_matU, 1, local_t0, 1, 0.0, local_t1, 1, nSamples);
-	Matrix::value_type sum_local_t1 = pGetSum(local_t1, nSamples);
+	Matrix::value_type sum_local_t1 = LOG_ENABLED(logDEBUG) ? pGetSum(local_t1, nSamples) : 0;
   Matrix local_t2(local_n, nSamples); /// U' * (D - HA)
   pAlpha_ATrans_B_plus_beta_C(1.0, local_HA_Perturb, 1, local_matU, 1, 0.0, local_t2, 1, nSamples);
-	Matrix::value_type sum_local_t2 = pGetSum(local_t2, nSamples);
+	Matrix::value_type sum_local_t2 = LOG_ENABLED(logDEBUG) ? pGetSum(local_t2, nSamples) : 0;
   Matrix local_t3(local_n, nSamples); /// U' * (D - HA)
   pAlpha_A_B_plus_beta_C(1.0, local_t2, 1, local_matSSqInv, 0, 0.0, local_t3, 1, nSamples);
-	Matrix::value_type sum_local_t3 = pGetSum(local_t3, nSamples);
+	Matrix::value_type sum_local_t3 = LOG_ENABLED(logDEBUG) ? pGetSum(local_t3, nSamples) : 0;
   Matrix local_t4(local_n, nSamples); /// U' * (D - HA)
   pAlpha_A_B_plus_beta_C(1.0, local_t3, 1, local_t1, 1, 0.0, local_t4, 1, nSamples);
-	Matrix::value_type sum_local_t4 = pGetSum(local_t4, nSamples);
+	Matrix::value_type sum_local_t4 = LOG_ENABLED(logDEBUG) ? pGetSum(local_t4, nSamples) : 0;
 	/*
 	char filename[20];
 	sprintf(filename, "local_t4%d.txt", rank);
@@ -556,10 +560,7 @@ void EnkfAnalyze::initLambdaSet(const std::vector<float*>& velSet, Matrix& lambd
     std::vector<float> encsrc  = encoder.encodeSource(wlt);
 
     TRACE() << "save encoded data";
-    std::vector<float> trans(encobs.size());
-    matrix_transpose(&encobs[0], &trans[0], ng, nt);
-    const float *p= &trans[0];
-    std::copy(p, p + numDataSamples, obsData.begin());
+    std::copy(encobs.begin(), encobs.begin() + numDataSamples, obsData.begin());
 
     std::vector<float> dcal(encobs.size(), 0);
 
@@ -567,9 +568,11 @@ void EnkfAnalyze::initLambdaSet(const std::vector<float*>& velSet, Matrix& lambd
     ForwardModeling newfm = fm;
     Velocity curvel(std::vector<float>(velSet[i], velSet[i] + modelSize), fm.getnx(), fm.getnz());
     newfm.bindVelocity(curvel);
-    newfm.EssForwardModeling(encsrc, dcal);
-    matrix_transpose(&dcal[0], &trans[0], ng, nt);
-    std::copy(p, p + numDataSamples, synData.begin());
+    {
+      PROFILE("forward");
+      newfm.EssForwardModeling(encsrc, dcal);
+    }
+    std::copy(dcal.begin(), dcal.begin() + numDataSamples, synData.begin());
 
     TRACE() << "calculate the data residule";
     float resd = variance(obsData, synData);
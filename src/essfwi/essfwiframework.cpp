@@ -21,6 +21,7 @@ extern "C"
 #include <functional>
 #include <vector>
 #include <set>
+#include <boost/bind.hpp>
 
 #include "logger.h"
 #include "common.h"
@@ -37,15 +38,17 @@ extern "C"
 
 #include "aux.h"
 #include "ReguFactor.h"
+#include "profiler.h"
 
 EssFwiFramework::EssFwiFramework(ForwardModeling &method, const UpdateSteplenOp &updateSteplenOp,
     const UpdateVelOp &_updateVelOp,
     const std::vector<float> &_wlt, const std::vector<float> &_dobs) :
-    FwiBase(method, _wlt, _dobs), updateStenlelOp(updateSteplenOp), updateVelOp(_updateVelOp), essRandomCodes(ESS_SEED)
+    FwiBase(method, _wlt), dobs(_dobs), updateStenlelOp(updateSteplenOp), updateVelOp(_updateVelOp), essRandomCodes(ESS_SEED)
 {
 }
 
 void EssFwiFramework::epoch(int iter, float lambdaX, float lambdaZ) {
+  PROFILE("epoch");
   // create random codes
   const std::vector<int> encodes = essRandomCodes.genPlus1Minus1(ns);
 
@@ -55,50 +58,76 @@ void EssFwiFramework::epoch(int iter, float lambdaX, float lambdaZ) {
 
   Encoder encoder(encodes);
   std::vector<float> encsrc  = encoder.encodeSource(wlt);
-  std::vector<float> encobs_trans = encoder.encodeObsData(dobs, nt, ng);
-  std::vector<float> encobs(nt * ng, 0);
-	matrix_transpose(&encobs_trans[0], &encobs[0], ng, nt);
+  std::vector<float> encobs = encoder.encodeObsData(dobs, nt, ng);
+  fmMethod.removeDirectArrival(&encobs[0]);
+
+  std::vector<float> g1(nx * nz, 0);
+  float obj1 = calObjGrad(encsrc, encobs, lambdaX, lambdaZ, g1);
+  initobj = iter == 0 ? obj1 : initobj;
+
+  /// the codes change every iteration, so the gradient of the accepted velocity is not kept.
+  /// the boundary of every model is refilled from the interior, as the cg update does
+  if (optimizer == OPT_LBFGS) {
+    PROFILE("linesearch");
+    lbfgsStep(boost::bind(&EssFwiFramework::calObjGrad, this, boost::cref(encsrc), boost::cref(encobs), lambdaX, lambdaZ, _1),
+        updateVelOp.getvmin(), updateVelOp.getvmax(), obj1, g1,
+        boost::bind(&ForwardModeling::refillBoundary, &fmMethod, _1));
+    updateobj = obj1;
+    return;
+  }
+
+  updateGrad(&g0[0], &g1[0], &updateDirection[0], g0.size(), iter);
+
+  updateStenlelOp.bindEncSrcObs(encsrc, encobs);
+  float steplen;
+  {
+    PROFILE("linesearch");
+    updateStenlelOp.calsteplen(updateDirection, obj1, iter, lambdaX, lambdaZ, steplen, updateobj);
+  }
+
+  Velocity &exvel = fmMethod.getVelocity();
+  updateVelOp.update(exvel, exvel, updateDirection, steplen);
+
+  fmMethod.refillBoundary(&exvel.dat[0]);
+  fmMethod.refreshVelocity();
+}
 
-  std::vector<float> dcal_trans(nt * ng, 0);
+/**
+ * objective of the bound velocity for the encoded shot, regularization
+ * included, and its scaled and masked gradient in grad. encobs has no direct
+ * arrival
+ */
+float EssFwiFramework::calObjGrad(const std::vector<float> &encsrc, const std::vector<float> &encobs,
+    float lambdaX, float lambdaZ, std::vector<float> &grad) {
+  PROFILE("gradient");
   std::vector<float> dcal(nt * ng, 0);
-  fmMethod.EssForwardModeling(encsrc, dcal_trans);
-	matrix_transpose(&dcal_trans[0], &dcal[0], ng, nt);
-  fmMethod.removeDirectArrival(&encobs[0]);
+  {
+    PROFILE("forward");
+    fmMethod.EssForwardModeling(encsrc, dcal);
+  }
   fmMethod.removeDirectArrival(&dcal[0]);
 
   std::vector<float> vsrc(nt * ng, 0);
   vectorMinus(encobs, dcal, vsrc);
   float obj1 = cal_objective(&vsrc[0], vsrc.size());
-  initobj = iter == 0 ? obj1 : initobj;
   DEBUG() << format("obj: %e") % obj1;
 
-    Velocity &exvel = fmMethod.getVelocity();
-    if (!(lambdaX == 0 && lambdaZ == 0)) {
-      ReguFactor fac(&exvel.dat[0], nx, nz, lambdaX, lambdaZ);
-      obj1 += fac.getReguTerm();
-    }
-
+  Velocity &exvel = fmMethod.getVelocity();
+  if (!(lambdaX == 0 && lambdaZ == 0)) {
+    ReguFactor fac(&exvel.dat[0], nx, nz, lambdaX, lambdaZ);
+    obj1 += fac.getReguTerm();
+  }
 
   transVsrc(vsrc, nt, ng);
 
-  std::vector<float> g1(nx * nz, 0);
-  calgradient(fmMethod, encsrc, vsrc, g1, nt, dt);
-
-  DEBUG() << format("grad %.20f") % sum(g1);
-
-  fmMethod.scaleGradient(&g1[0]);
-  fmMethod.maskGradient(&g1[0]);
+  grad.assign(nx * nz, 0);
+  calgradient(fmMethod, encsrc, vsrc, grad, nt, dt);
 
-  updateGrad(&g0[0], &g1[0], &updateDirection[0], g0.size(), iter);
-
-  updateStenlelOp.bindEncSrcObs(encsrc, encobs);
-  float steplen;
-  updateStenlelOp.calsteplen(updateDirection, obj1, iter, lambdaX, lambdaZ, steplen, updateobj);
-
-//  Velocity &exvel = fmMethod.getVelocity();
-  updateVelOp.update(exvel, exvel, updateDirection, steplen);
+  DEBUG() << format("grad %.20f") % sum(grad);
 
-  fmMethod.refillBoundary(&exvel.dat[0]);
+  fmMethod.scaleGradient(&grad[0]);
+  fmMethod.maskGradient(&grad[0]);
+  return obj1;
 }
 
 void EssFwiFramework::calgradient(const ForwardModeling &fmMethod,
@@ -113,44 +142,46 @@ void EssFwiFramework::calgradient(const ForwardModeling &fmMethod,
   int ng = fmMethod.getng();
   const ShotPosition &allGeoPos = fmMethod.getAllGeoPos();
   const ShotPosition &allSrcPos = fmMethod.getAllSrcPos();
+  PROFILE("adjoint");
+
+  if (nsnap > 0) {
+    checkpointGradient(fmMethod, &encSrc[0], ns, allSrcPos, vsrc, g0, nt, dt);
+    return;
+  }
 
-  std::vector<float> bndr = fmMethod.initBndryVector(nt);
+  BoundaryStore bndr(bndrConfig, fmMethod, nt);
   std::vector<float> sp0(nz * nx, 0);
   std::vector<float> sp1(nz * nx, 0);
   std::vector<float> gp0(nz * nx, 0);
   std::vector<float> gp1(nz * nx, 0);
+  FmWorkspace ws;
 
-
+  ForwardModeling::Box box = fmMethod.activeBox(allSrcPos);
   for(int it=0; it<nt; it++) {
     fmMethod.addSource(&sp1[0], &encSrc[it * ns], allSrcPos);
-    fmMethod.stepForward(sp0,sp1);
+    fmMethod.stepForward(ws, sp0, sp1, box);
     std::swap(sp1, sp0);
-    fmMethod.writeBndry(&bndr[0], &sp0[0], it);
+    bndr.put(it, &sp0[0]);
   }
 
-  std::vector<float> vsrc_trans(nt * ng, 0);
-  matrix_transpose(const_cast<float*>(&vsrc[0]), &vsrc_trans[0], nt, ng);
-
+  ForwardModeling::Box gbox = fmMethod.activeBox(allGeoPos);
   for(int it = nt - 1; it >= 0 ; it--) {
-    fmMethod.readBndry(&bndr[0], &sp0[0], it);
+    if (dt * it <= 0.3) {
+      break;
+    }
+    float scale = dt * it > 0.4 ? 1.0 : (dt * it - 0.3) / 0.1;
+
+    bndr.get(it, &sp0[0]);
     std::swap(sp0, sp1);
-    fmMethod.stepBackward(&sp0[0], &sp1[0]);
-    fmMethod.subEncodedSource(&sp0[0], &encSrc[it * ns]);
+    /// added before the backward step is subtracted from its result, see FwiFramework::calgradient
+    fmMethod.addEncodedSource(&sp0[0], &encSrc[it * ns]);
 
     /**
-     * forward propagate receviers
+     * forward propagate receviers, step both wavefields and correlate them in one sweep
      */
-    fmMethod.addSource(&gp1[0], &vsrc_trans[it * ng], allGeoPos);
-    fmMethod.stepForward(gp0,gp1);
+    fmMethod.addSource(&gp1[0], &vsrc[it * ng], allGeoPos);
+    fmMethod.stepAdjoint(ws, &sp0[0], &sp1[0], &gp0[0], &gp1[0], &g0[0], scale, gbox);
     std::swap(gp1, gp0);
-
-    if (dt * it > 0.4) {
-      cross_correlation(&sp0[0], &gp0[0], &g0[0], g0.size(), 1.0);
-    } else if (dt * it > 0.3) {
-      cross_correlation(&sp0[0], &gp0[0], &g0[0], g0.size(), (dt * it - 0.3) / 0.1);
-    } else {
-      break;
-    }
  }
 }
 
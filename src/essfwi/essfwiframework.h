@@ -26,10 +26,15 @@ public:
     std::vector<float> &g0,
     int nt, float dt);
 
+private:
+  float calObjGrad(const std::vector<float> &encsrc, const std::vector<float> &encobs,
+      float lambdaX, float lambdaZ, std::vector<float> &grad);
+
 private:
   static const int ESS_SEED = 1;
 
 private:
+  const std::vector<float> &dobs; /// actual observed data (nt*ng*ns)
   UpdateSteplenOp updateStenlelOp;
   const UpdateVelOp &updateVelOp;
   RandomCodes essRandomCodes;
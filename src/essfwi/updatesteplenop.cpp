@@ -13,6 +13,7 @@
 #include "parabola-vertex.h"
 #include "sum.h"
 #include "ReguFactor.h"
+#include "profiler.h"
 
 namespace {
 typedef std::pair<float, float> ParaPoint;
@@ -72,10 +73,11 @@ float UpdateSteplenOp::calobjval(const std::vector<float>& grad,
 
   //forward modeling
   int ng = fmMethod.getng();
-  std::vector<float> dcal_trans(nt * ng);
   std::vector<float> dcal(nt * ng);
-  updateMethod.EssForwardModeling(*encsrc, dcal_trans);
-	matrix_transpose(&dcal_trans[0], &dcal[0], ng, nt);
+  {
+    PROFILE("forward");
+    updateMethod.EssForwardModeling(*encsrc, dcal);
+  }
 
   updateMethod.bindVelocity(oldVel);  //-test
   updateMethod.removeDirectArrival(&dcal[0]);
@@ -35,3 +35,11 @@ void UpdateVelOp::update(Velocity& newVel,
     float steplen) const {
   update_vel(&newVel.dat[0], &vel.dat[0], &grad[0], newVel.dat.size(), steplen, vmin, vmax);
 }
+
+float UpdateVelOp::getvmin() const {
+  return vmin;
+}
+
+float UpdateVelOp::getvmax() const {
+  return vmax;
+}
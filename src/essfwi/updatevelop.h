@@ -14,6 +14,9 @@ class UpdateVelOp {
 public:
   UpdateVelOp(float vmin, float vmax, float dx, float dt);
   void update(Velocity &newVel, const Velocity &vel, const std::vector<float> &grad, float steplen) const;
+  /// bounds of the updated velocity, transformed like the modeling velocity
+  float getvmin() const;
+  float getvmax() const;
 
 private:
   float vmin;
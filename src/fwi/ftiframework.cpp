@@ -34,32 +34,62 @@ extern "C"
 #include "sfutil.h"
 #include "parabola-vertex.h"
 #include "ftiframework.h"
+#include "mpi-utility.h"
+#include "shot-scheduler.h"
+
+extern "C"
+{
+#include "ext-imaging.h"
+}
 
 FtiFramework::FtiFramework(ForwardModeling &method, const FwiUpdateSteplenOp &updateSteplenOp,
     const FwiUpdateVelOp &_updateVelOp,
-    const std::vector<float> &_wlt, const std::vector<float> &_dobs, int _jsx, int _jsz) :
+    const std::vector<float> &_wlt, const ShotDataStore &_dobs, int _jsx, int _jsz) :
     FwiFramework(method, updateSteplenOp, _updateVelOp, _wlt, _dobs), jsx(_jsx), jsz(_jsz)
 {
 }
 
+void FtiFramework::setWavefieldStore(const WavefieldStore::Config &config) {
+  wfConfig = config;
+}
+
+/**
+ * rank 0 writes the parts of a distributed image one rank after the other, it
+ * holds one part at a time
+ */
+static void writeDistributed(sf_file file, const std::vector<float> &part, const std::vector<int> &counts) {
+	int rank, np;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &np);
+
+	if(rank != 0) {
+		MPI_Send(const_cast<float *>(&part[0]), part.size(), MPI_FLOAT, 0, 0, MPI_COMM_WORLD);
+		return;
+	}
+
+	sf_floatwrite(const_cast<float *>(&part[0]), part.size(), file);
+	std::vector<float> buf;
+	for(int r = 1 ; r < np ; r ++) {
+		buf.resize(counts[r]);
+		MPI_Recv(&buf[0], buf.size(), MPI_FLOAT, r, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+		sf_floatwrite(&buf[0], buf.size(), file);
+	}
+}
+
 void FtiFramework::epoch(int iter) {
 	int nwx = 200;
 	std::vector<float> tap = taper(ng, nwx);
 	std::vector<float> encobs(ng * nt, 0);
-	int rank, np, k, ntask, shot_begin, shot_end;
+	int rank, np;
 	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 	MPI_Comm_size(MPI_COMM_WORLD, &np);
-	k = std::ceil(ns * 1.0 / np);
-	ntask = std::min(k, ns - rank*k);
-	shot_begin = rank * k;
-	shot_end = shot_begin + ntask;
-	float local_obj1 = 0.0f, obj1 = 0.0f;
+	float obj1 = 0.0f;
 	int H = 60;
-	std::vector<float> img((2 * H + 1) * nx * nz, 0);
-	std::vector<float> g2((2 * H + 1) * nx * nz, 0);
+	size_t size = (size_t)(2 * H + 1) * nx * nz;
+	std::vector<float> objshot(ns, 0.0f);
 
 	///*
-	sf_file sf_g2;
+	sf_file sf_g2 = NULL;
 	if(rank == 0 && iter == 0)
 	{
 		sf_g2 = sf_output("g2.rsf");
@@ -68,64 +98,101 @@ void FtiFramework::epoch(int iter) {
 		sf_putint(sf_g2, "n3", 2 * H + 1);
 	}
 
-	
-	for(int is = shot_begin ; is < shot_end ; is ++) {
-		std::vector<float> encobs_trans(nt * ng, 0.0f);
-		INFO() << format("calculate image, shot id: %d") % is;
-		memcpy(&encobs_trans[0], &dobs[is * ng * nt], sizeof(float) * ng * nt);
-		for(int it = 0 ; it < nt ; it ++) {
-			for(int ig = 0 ; ig < ng ; ig ++) {
-				encobs_trans[it * ng + ig] *= tap[ig];
+	/// the image stays distributed, rank r only sums the entries [displs[r], displs[r] + counts[r])
+	std::vector<int> counts(np), displs(np);
+	for(int r = 0 ; r < np ; r ++) {
+		displs[r] = size * r / np;
+		counts[r] = size * (r + 1) / np - displs[r];
+	}
+	std::vector<float> imgpart(counts[rank], 0);
+
+	/// in every round each rank images the next shot of its block, or an empty one when it has none
+	/// left, so all the ranks know the number of rounds. the reduce scatter of a round is in place,
+	/// its part lands at the start of the shot image, and runs until the next image is computed
+	int shot_begin, shot_end;
+	shotBlock(ns, np, rank, shot_begin, shot_end);
+	int nround = (ns + np - 1) / np;
+	std::vector<float> shotimg(size, 0.0f);
+	MPI_Request req = MPI_REQUEST_NULL;
+	for(int round = 0 ; round < nround ; round ++) {
+		int is = shot_begin + round < shot_end ? shot_begin + round : -1;
+		if(is >= 0) {
+			INFO() << format("calculate image, shot id: %d") % is;
+			dobs.get(is, &encobs[0]);
+			for(int it = 0 ; it < nt ; it ++) {
+				for(int ig = 0 ; ig < ng ; ig ++) {
+					encobs[it * ng + ig] *= tap[ig];
+				}
 			}
+
+			/// the rsf file keeps the trace major layout
+			std::vector<float> encobs_trans(nt * ng, 0.0f);
+			matrix_transpose(&encobs[0], &encobs_trans[0], ng, nt);
+			sf_file shots2 = sf_output("dshots2.rsf");
+			sf_putint(shots2, "n1", nt);
+			sf_putint(shots2, "n2", ng);
+			sf_floatwrite(&encobs_trans[0], nt * ng, shots2);
+		}
+
+		if(req != MPI_REQUEST_NULL) {
+			MPI_Wait(&req, MPI_STATUS_IGNORE);
+			std::transform(imgpart.begin(), imgpart.end(), shotimg.begin(), imgpart.begin(), std::plus<float>());
 		}
-		matrix_transpose(&encobs_trans[0], &encobs[0], ng, nt);
-
-		sf_file shots2 = sf_output("dshots2.rsf");
-		sf_putint(shots2, "n1", nt);
-		sf_putint(shots2, "n2", ng);
-		sf_floatwrite(&encobs[0], nt * ng, shots2);
-
-		//fmMethod.fwiRemoveDirectArrival(&encobs[0], is);
-		img.assign((2 * H + 1) * nx * nz, 0.0f);
-		image_born(fmMethod, wlt, encobs, img, nt, dt, is, rank, H);
-		DEBUG() << ("sum grad: ") << std::accumulate(&img[H * nx * nz], &img[(H + 1) * nx * nz], 0.0f);
-		fmMethod.bornMaskGradient(&img[0], H);
-		std::transform(g2.begin(), g2.end(), img.begin(), g2.begin(), std::plus<float>());
-		DEBUG() << ("global grad: ") << std::accumulate(&g2[H * nx * nz], &g2[(H + 1) * nx * nz], 0.0f);
+
+		shotimg.assign(size, 0.0f);
+		if(is >= 0) {
+			//fmMethod.fwiRemoveDirectArrival(&encobs[0], is);
+			image_born(fmMethod, wlt, encobs, shotimg, nt, dt, is, rank, H);
+			DEBUG() << ("sum grad: ") << std::accumulate(&shotimg[H * nx * nz], &shotimg[(H + 1) * nx * nz], 0.0f);
+			fmMethod.bornMaskGradient(&shotimg[0], H);
+		}
+		MPI_Ireduce_scatter(MPI_IN_PLACE, &shotimg[0], &counts[0], MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD, &req);
 	}
+	if(req != MPI_REQUEST_NULL) {
+		MPI_Wait(&req, MPI_STATUS_IGNORE);
+		std::transform(imgpart.begin(), imgpart.end(), shotimg.begin(), imgpart.begin(), std::plus<float>());
+	}
+	std::vector<float>().swap(shotimg);
+	obj1 = MpiSumByShot(objshot);
 
-	img.assign((2 * H + 1) * nx * nz, 0.0f);
-	MPI_Allreduce(&g2[0], &img[0], g2.size(), MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD);
-	MPI_Allreduce(&local_obj1, &obj1, 1, MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD);
+	double zerosum = 0;
+	size_t imgbeg = displs[rank], imgend = imgbeg + counts[rank];
+	for (size_t i = std::max(imgbeg, (size_t)H * nx * nz); i < std::min(imgend, (size_t)(H + 1) * nx * nz); i++) {
+		zerosum += imgpart[i - imgbeg];
+	}
+	MpiInplaceReduce(&zerosum, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
 
 	if(rank == 0)
 	{
-		DEBUG() << ("****** global grad: ") << std::accumulate(&img[H * nx * nz], &img[(H + 1) * nx * nz], 0.0f);
+		DEBUG() << ("****** global grad: ") << zerosum;
 		DEBUG() << format("****** sum obj: %.20f") % obj1;
 	}
 
-	if(rank == 0 && iter == 0)
+	if(iter == 0)
 	{
-		sf_floatwrite(&img[0], (2 * H + 1) * nx * nz, sf_g2);
+		writeDistributed(sf_g2, imgpart, counts);
 	}
 
 	MPI_Barrier(MPI_COMM_WORLD);
 	exit(1);
 	//*/
 
+	std::vector<float> img(size, 0);
 	sf_file sf_img0 = sf_input("g3.rsf");
-	sf_floatread(&img[0], (2 * H + 1) * nx * nz, sf_img0);
+	sf_floatread(&img[0], size, sf_img0);
 
 	std::vector<float> gd(nx * nz, 0);
+	std::vector<double> gdsum(nx * nz, 0);
 	std::vector<float> grad(nx * nz, 0);
-	for(int is = shot_begin ; is < shot_end ; is ++) {
+	ShotScheduler gradScheduler(ns);
+	for(int is = gradScheduler.next() ; is >= 0 ; is = gradScheduler.next()) {
 		INFO() << format("************Calculating gradient %d:") % is;
-		std::vector<float> encobs_trans(nt * ng, 0.0f);
-		memcpy(&encobs_trans[0], &dobs[is * ng * nt], sizeof(float) * ng * nt);
-		matrix_transpose(&encobs_trans[0], &encobs[0], ng, nt);	//removeDirectArrival?
+		dobs.get(is, &encobs[0]);	//removeDirectArrival?
+		gd.assign(nx * nz, 0.0f);
 		calgradient(fmMethod, wlt, encobs, img, gd, nt, dt, is, rank, H);
+		std::transform(gdsum.begin(), gdsum.end(), gd.begin(), gdsum.begin(), std::plus<double>());
 	}
-	MPI_Allreduce(&gd[0], &grad[0], gd.size(), MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD);
+	MpiAllreduceSum(gdsum, grad);
 	fmMethod.maskGradient(&grad[0]);
 
 	if(rank == 0 && iter == 0) {
@@ -155,7 +222,7 @@ void FtiFramework::epoch(int iter) {
 	float steplen;
 	float obj_val1 = 0, obj_val2 = 0, obj_val3 = 0;
 
-	updateStenlelOp.calsteplen(dobs, updateDirection, obj1, iter, steplen, updateobj, rank, shot_begin, shot_end);
+	updateStenlelOp.calsteplen(dobs, updateDirection, obj1, iter, steplen, updateobj, rank);
 
 
 	float alpha1 = updateStenlelOp.alpha1;
@@ -192,6 +259,7 @@ void FtiFramework::epoch(int iter) {
 		INFO() << format("sum vel %f") % sum(exvel.dat);
 
 	updateVelOp.update(exvel, exvel, updateDirection, steplen);
+	fmMethod.refreshVelocity();
 
 	if(rank == 0)
 		INFO() << format("sum vel2 %f") % sum(exvel.dat);
@@ -236,9 +304,13 @@ void FtiFramework::calgradient(const ForwardModeling &fmMethod,
   std::vector<float> sp1(nz * nx, 0);
   std::vector<float> gp0(nz * nx, 0);
   std::vector<float> gp1(nz * nx, 0);
+  FmWorkspace ws;
 
-	std::vector<float> ps(nt * nx * nz, 0);
-	std::vector<float> pg(nt * nx * nz, 0);
+	WavefieldStore ps(wfConfig, nt, nx * nz);
+	WavefieldStore pg(wfConfig, nt, nx * nz);
+	std::vector<float> ps_it(nx * nz, 0);
+	std::vector<float> pg_it(nx * nz, 0);
+	DEBUG() << format("wavefield store %.1f MB per field") % (ps.footprint() / 1048576.0);
 
   ShotPosition curSrcPos = allSrcPos.clipRange(shot_id, shot_id);
 	std::vector<float> src = wlt;
@@ -265,30 +337,23 @@ void FtiFramework::calgradient(const ForwardModeling &fmMethod,
   for(int it=0; it<nt; it++) {
     //fmMethod.addSource(&sp1[0], &wlt[it], curSrcPos);
     fmMethod.addSource(&sp1[0], &src[it], curSrcPos);
-    fmMethod.stepForward(sp0,sp1,0);
+    fmMethod.stepForward(ws, sp0,sp1,0);
     std::swap(sp1, sp0);
 		/*
 		if(it % dn == 0)
 			sf_floatwrite(&sp0[0], nx * nz, fullwv1);
 			*/
-#pragma omp parallel for
-		for(int ix = 0 ; ix < nx ; ix ++)	//lack of the last timestep?
-			for(int iz = 0 ; iz < nz ; iz ++)
-				//ps[it * nx * nz + ix * nz + iz] = sp1[ix * nz + iz] - sp0[ix * nz + iz];
-				ps[it * nx * nz + ix * nz + iz] = sp0[ix * nz + iz];
+		ps.put(it, &sp0[0]);
   }
 
 	printf("1\n");
-  std::vector<float> vsrc_trans(ng * nt, 0.0f);
-	for(int ig = 0 ; ig < ng ; ig ++)
-		one_order_virtual_source_forth_accuracy(const_cast<float*>(&vsrc[ig * nt]), nt);
-  matrix_transpose(const_cast<float*>(&vsrc[0]), &vsrc_trans[0], nt, ng);
+	one_order_virtual_source_time_major(const_cast<float*>(&vsrc[0]), nt, ng);
 
   for(int it = nt - 1; it >= 0 ; it--) {
 		/*
     //fmMethod.readBndry(&bndr[0], &sp0[0], it);	-test
     //std::swap(sp0, sp1); -test
-    fmMethod.stepBackward(&sp0[0], &sp1[0]);
+    fmMethod.stepBackward(ws, &sp0[0], &sp1[0]);
     //fmMethod.subEncodedSource(&sp0[0], &wlt[it]);
     std::swap(sp0, sp1);	//-test
     fmMethod.subSource(&sp0[0], &wlt[it], curSrcPos);
@@ -297,35 +362,18 @@ void FtiFramework::calgradient(const ForwardModeling &fmMethod,
     /**
      * forward propagate receviers
      */
-    fmMethod.addSource(&gp1[0], &vsrc_trans[it * ng], allGeoPos);
-    fmMethod.stepForward(gp0,gp1,0);
+    fmMethod.addSource(&gp1[0], &vsrc[it * ng], allGeoPos);
+    fmMethod.stepForward(ws, gp0,gp1,0);
     std::swap(gp1, gp0);
 		/*
 		if(it % dn == 0)
 			sf_floatwrite(&gp0[0], nx * nz, fullwv2);
 			*/
-#pragma omp parallel for
-		for(int ix = 0 ; ix < nx ; ix ++)
-			for(int iz = 0 ; iz < nz ; iz ++)
-				//pg[it * nx * nz + ix * nz + iz] = gp1[ix * nz + iz] - gp0[ix * nz + iz];
-				pg[it * nx * nz + ix * nz + iz] = gp0[ix * nz + iz];
+		pg.put(it, &gp0[0]);
 	}
 
 	const Velocity &exvel = fmMethod.getVelocity();
 
-	std::vector<float> ggg(nx * nz, 0.0f);
-	for(int it=0; it<nt; it++) {
-#pragma omp parallel for 
-		for(int ix = 0 ; ix < nx ; ix ++) 
-			for(int iz = 0 ; iz < nz ; iz ++) 
-				ggg[ix * nz + iz] += ps[it * nx * nz + ix * nz + iz] * pg[it * nx * nz + ix * nz + iz];
-	}
-	/*
-	sf_file sf_g2 = sf_output("ggg_test.rsf");
-	sf_putint(sf_g2, "n1", nz);
-	sf_putint(sf_g2, "n2", nx);
-	sf_floatwrite(&ggg[0], nx * nz, sf_g2);
-	*/
 	printf("2\n");
 
 	sp0.assign(nx * nz, 0);
@@ -350,25 +398,11 @@ void FtiFramework::calgradient(const ForwardModeling &fmMethod,
   std::vector<float> dobs_trans(nt * ng, 0);
   std::vector<float> dobs(nt * ng, 0);
   std::vector<float> record(nx * nz, 0);
-	float ps_t = 0, pg_t = 0, img_t = 0;
 	for(int it=0; it<nt; it++) {
-				for(int h = -H ; h <= H ; h ++) {
-					int ind = h + H;
-#pragma omp parallel for private(ps_t, pg_t, img_t)
-		for(int ix = nb ; ix < nx - nb ; ix ++) {
-			//printf("h = %d, H = %d, ix = %d\n", h, H, ix);
-			for(int iz = nb ; iz < nz - nb ; iz ++) { 
-				//for(int h = -H ; h <= H ; h ++) {
-					//int ind = h + H;
-					ps_t = ix + 2 * h >= 0 && ix + 2 * h < nx ? ps[it * nx * nz + (ix + 2 * h) * nz + iz] : 0;
-					img_t = ix + h >= 0 && ix + h < nx ? img[ind * nx * nz + (ix + h) * nz + iz] : 0; 
-					//img_t = ix + h >= nb && ix + h < nx - nb ? img[(ix + h) * nz * (2 * H + 1) + iz * (2 * H + 1) + ind] : 0; 
-					sp1[ix * nz + iz] += ps_t * h * h * img_t;
-					//sp1[ix * nz + iz] += ps_t * img_t;
-				}
-			}
-		}
-		fmMethod.stepForward(sp0,sp1,0);
+		ps.get(it, &ps_it[0]);
+		pg.get(it, &pg_it[0]);
+		ext_image_source(&sp1[0], &ps_it[0], &img[0], 1, H, nx, nz, nb);
+		fmMethod.stepForward(ws, sp0,sp1,0);
 		std::swap(sp1, sp0);
 		if(it % dn == 0)
 			sf_floatwrite(&sp0[0], nx * nz, fullwv3);
@@ -376,7 +410,7 @@ void FtiFramework::calgradient(const ForwardModeling &fmMethod,
 #pragma omp parallel for 
 		for(int ix = 0 ; ix < nx ; ix ++) 
 			for(int iz = 0 ; iz < nz ; iz ++) 
-				gd0[ix * nz + iz] += 2 * sp0[ix * nz + iz] * pg[it * nx * nz + ix * nz + iz] * exvel.dat[ix * nz + iz];
+				gd0[ix * nz + iz] += 2 * sp0[ix * nz + iz] * pg_it[ix * nz + iz] * exvel.dat[ix * nz + iz];
 	}
   matrix_transpose(&dobs_trans[0], &dobs[0], ng, nt);
 	for(int ig = 0 ; ig < ng ; ig ++)
@@ -401,26 +435,15 @@ void FtiFramework::calgradient(const ForwardModeling &fmMethod,
 	gp1.assign(nx * nz, 0);
 
 	for(int it = nt - 1; it >= 0 ; it--) {
-				for(int h = -H ; h <= H ; h ++) {
-					int ind = h + H;
-#pragma omp parallel for private(ps_t, pg_t, img_t)
-		for(int ix = nb ; ix < nx - nb ; ix ++) 
-			for(int iz = nb ; iz < nz - nb ; iz ++) {
-				//for(int h = -H ; h <= H ; h ++) {
-					//int ind = h + H;
-					pg_t = ix - 2 * h >= 0 && ix - 2 * h < nx ? pg[it * nx * nz + (ix - 2 * h) * nz + iz] : 0;
-					img_t = ix - h >= 0 && ix - h < nx ? img[ind * nx * nz + (ix - h) * nz + iz] : 0;
-					//img_t = ix - h >= nb && ix - h < nx - nb ? img[(ix - h) * nz * (2 * H + 1) + iz * (2 * H + 1) + ind] : 0;
-					gp1[ix * nz + iz] +=  pg_t * h * h * img_t;
-					//gp1[ix * nz + iz] +=  pg_t * img_t;
-			}
-		}
-    fmMethod.stepForward(gp0,gp1,0);
+		ps.get(it, &ps_it[0]);
+		pg.get(it, &pg_it[0]);
+		ext_image_source(&gp1[0], &pg_it[0], &img[0], -1, H, nx, nz, nb);
+    fmMethod.stepForward(ws, gp0,gp1,0);
     std::swap(gp1, gp0);
 #pragma omp parallel for 
 		for(int ix = 0 ; ix < nx ; ix ++) 
 			for(int iz = 0 ; iz < nz ; iz ++) 
-				gd0[ix * nz + iz] += 2 * gp0[ix * nz + iz] * ps[it * nx * nz + ix * nz + iz] * exvel.dat[ix * nz + iz];
+				gd0[ix * nz + iz] += 2 * gp0[ix * nz + iz] * ps_it[ix * nz + iz] * exvel.dat[ix * nz + iz];
 	}
 	printf("4\n");
 	char filename[20];
@@ -452,21 +475,20 @@ void FtiFramework::image_born(const ForwardModeling &fmMethod,
   std::vector<float> sp1(nz * nx, 0);
   std::vector<float> gp0(nz * nx, 0);
   std::vector<float> gp1(nz * nx, 0);
+  FmWorkspace ws;
 
 
   ShotPosition curSrcPos = allSrcPos.clipRange(shot_id, shot_id);
 
-	std::vector<float> ps(nt * nx * nz, 0);
+	WavefieldStore ps(wfConfig, nt, nx * nz);
+	std::vector<float> ps_it(nx * nz, 0);
 
   for(int it=0; it<nt; it++) {
     fmMethod.addSource(&sp1[0], &wlt[it], curSrcPos);
     //fmMethod.stepForward(sp0,sp1);
-    fmMethod.stepForward(sp0,sp1,0);
+    fmMethod.stepForward(ws, sp0,sp1,0);
     std::swap(sp1, sp0);
-#pragma omp parallel for
-		for(int ix = 0 ; ix < nx ; ix ++)	//lack of the last timestep?
-			for(int iz = 0 ; iz < nz ; iz ++)
-				ps[it * nx * nz + ix * nz + iz] = sp0[ix * nz + iz];
+		ps.put(it, &sp0[0]);
     //fmMethod.writeBndry(&bndr[0], &sp0[0], it); //-test
 		/*
 		const int check_step = 5;
@@ -497,8 +519,6 @@ void FtiFramework::image_born(const ForwardModeling &fmMethod,
 	fclose(f2);
 	*/
 
-  std::vector<float> vsrc_trans(ng * nt, 0.0f);
-  matrix_transpose(const_cast<float*>(&vsrc[0]), &vsrc_trans[0], nt, ng);
 
   for(int it = nt - 1; it >= 0 ; it--) {
 		/*
@@ -530,7 +550,7 @@ void FtiFramework::image_born(const ForwardModeling &fmMethod,
 		}
     //fmMethod.readBndry(&bndr[0], &sp0[0], it);	//-test
     //std::swap(sp0, sp1); //-test
-    fmMethod.stepBackward(&sp0[0], &sp1[0]);
+    fmMethod.stepBackward(ws, &sp0[0], &sp1[0]);
     //fmMethod.subEncodedSource(&sp0[0], &wlt[it]);
     std::swap(sp0, sp1); //-test
     fmMethod.subSource(&sp0[0], &wlt[it], curSrcPos);
@@ -539,37 +559,16 @@ void FtiFramework::image_born(const ForwardModeling &fmMethod,
     /**
      * forward propagate receviers
      */
-    fmMethod.addSource(&gp1[0], &vsrc_trans[it * ng], allGeoPos);
-    fmMethod.stepForward(gp0,gp1,0);
+    fmMethod.addSource(&gp1[0], &vsrc[it * ng], allGeoPos);
+    fmMethod.stepForward(ws, gp0,gp1,0);
     std::swap(gp1, gp0);
 
-    cross_correlation(&ps[it * nx * nz], &gp0[0], &g0[0], nx, nz, 1.0, H);
+    ps.get(it, &ps_it[0]);
+    cross_correlation(&ps_it[0], &gp0[0], &g0[0], nx, nz, 1.0, H);
  }
 }
 
 void FtiFramework::cross_correlation(float *src_wave, float *vsrc_wave, float *image, int nx, int nz, float scale, int H) {
-	float t_src_wave, t_vsrc_wave;
 	int nb = fmMethod.getbx0();
-#pragma omp parallel for private(t_src_wave, t_vsrc_wave)
-	for(int h = -H ; h <= H ; h ++) {
-		int ind = h + H;
-		/*
-		for (int i = 0 ; i < nx ; i ++) {
-			for (int j = 0 ; j < nz ; j ++) {
-				t_src_wave = i + h < nx && i + h >= 0 ? src_wave[(i + h) * nz + j] : 0;
-				t_vsrc_wave = i - h < nx && i - h >= 0 ? vsrc_wave[(i - h) * nz + j] : 0;
-				image[ind * nx * nz + i * nz + j] += t_src_wave * t_vsrc_wave * scale;
-			}
-		}
-		*/
-
-		for (int i = nb ; i < nx - nb ; i ++) {
-			for (int j = nb ; j < nz - nb ; j ++) {
-				t_src_wave = i + h < nx - nb && i + h >= nb ? src_wave[(i + h) * nz + j] : 0;
-				t_vsrc_wave = i - h < nx - nb && i - h >= nb ? vsrc_wave[(i - h) * nz + j] : 0;
-				image[ind * nx * nz + i * nz + j] += t_src_wave * t_vsrc_wave * scale;
-			}
-		}
-	}
+	ext_image_correlate(image, src_wave, vsrc_wave, scale, H, nx, nz, nb);
 }
-
@@ -13,13 +13,16 @@
 #include "fwiupdatesteplenop.h"
 #include "random-code.h"
 #include "fwiframework.h"
+#include "wavefield-store.h"
 
 class FtiFramework: public FwiFramework {
 public:
   FtiFramework(ForwardModeling &fmMethod, const FwiUpdateSteplenOp &updateSteplenOp,
                   const FwiUpdateVelOp &updateVelOp, const std::vector<float> &wlt,
-                  const std::vector<float> &dobs, int jsx, int jsz);
+                  const ShotDataStore &dobs, int jsx, int jsz);
   void epoch(int iter);
+  /// where calgradient and image_born keep the source and receiver wavefields
+  void setWavefieldStore(const WavefieldStore::Config &config);
 	void calgradient(const ForwardModeling &fmMethod,
     const std::vector<float> &encSrc,
     const std::vector<float> &vsrc,
@@ -35,6 +38,9 @@ public:
 	void cross_correlation(float *src_wave, float *vsrc_wave, float *image, int nx, int nz, float scale, int H);
 
 	int jsx, jsz;
+
+private:
+	WavefieldStore::Config wfConfig;
 };
 
 #endif /* SRC_ESS_FWI2D_ESSFWIFRAMEWORK_H_ */
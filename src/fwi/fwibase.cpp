@@ -34,14 +34,15 @@ extern "C"
 #include "sfutil.h"
 #include "parabola-vertex.h"
 #include "fwibase.h"
+#include "revolve.h"
 
 #include "aux.h"
 
-FwiBase::FwiBase(ForwardModeling &method, const std::vector<float> &_wlt, const std::vector<float> &_dobs) :
-    fmMethod(method), wlt(_wlt), dobs(_dobs),
+FwiBase::FwiBase(ForwardModeling &method, const std::vector<float> &_wlt) :
+    fmMethod(method), wlt(_wlt),
     ns(method.getns()), ng(method.getng()), nt(method.getnt()),
     nx(method.getnx()), nz(method.getnz()), dx(method.getdx()), dt(method.getdt()),
-    updateobj(0), initobj(0)
+    updateobj(0), initobj(0), nsnap(0), optimizer(OPT_CG), lbfgs(5), ntrial(3), maxdv(200)
 {
   g0.resize(nx*nz, 0);
   updateDirection.resize(nx*nz, 0);
@@ -51,6 +52,235 @@ void FwiBase::writeVel(sf_file file) const {
 	fmMethod.sfWriteVel(fmMethod.getVelocity().dat, file);
 }
 
+void FwiBase::setCheckpoints(int nsnap) {
+  this->nsnap = nsnap;
+}
+
+void FwiBase::setBoundaryStore(const BoundaryStore::Config &config) {
+  this->bndrConfig = config;
+}
+
+FwiBase::Optimizer FwiBase::optimizerFromName(const std::string &name) {
+  if (name == "cg") {
+    return OPT_CG;
+  }
+  if (name == "lbfgs") {
+    return OPT_LBFGS;
+  }
+  ERROR() << format("unknown optimizer %s, use cg or lbfgs") % name;
+  exit(1);
+}
+
+void FwiBase::setOptimizer(Optimizer optimizer, int nhist, int ntrial, float maxdv) {
+  this->optimizer = optimizer;
+  this->lbfgs = Lbfgs(nhist);
+  this->ntrial = ntrial;
+  this->maxdv = maxdv;
+}
+
+static double dot(const std::vector<float> &a, const std::vector<float> &b) {
+  double r = 0;
+  for (size_t i = 0; i < a.size(); i++) {
+    r += (double)a[i] * b[i];
+  }
+  return r;
+}
+
+/**
+ * the step along d that slows some point down by maxdv, the rule calsteplen
+ * uses for alpha2
+ */
+static float maxdvStep(const std::vector<float> &vel, const std::vector<float> &d, float dx, float dt, float maxdv) {
+  float alpha = FLT_MAX;
+  for (size_t i = 0; i < vel.size(); i++) {
+    if (std::fabs(d[i]) < 1e-10) {
+      continue;
+    }
+    float v = dx / (dt * std::sqrt(vel[i])) - maxdv;
+    v = (dx / (dt * v)) * (dx / (dt * v));
+    alpha = std::min(alpha, (v - vel[i]) / std::fabs(d[i]));
+  }
+  return alpha;
+}
+
+/**
+ * weak Wolfe line search by bracketing (Lewis and Overton): a trial that does
+ * not decrease the objective ends the bracket, one that still descends too
+ * steeply (grad' d > c2 * grad0' d) starts it, and the step is doubled until
+ * the bracket is closed, then bisected. the gradient is only known up to a
+ * scale, so the sufficient decrease is a plain decrease. every trial costs a
+ * gradient, the accepted one is the gradient of the next iteration.
+ *
+ * when the bracket of an L-BFGS direction closes with no decrease, the memory
+ * is dropped and the search is run once more along the projected gradient,
+ * from half the maxdv step
+ */
+bool FwiBase::lbfgsStep(const Objective &evaluate, float vmin, float vmax, float &obj, std::vector<float> &grad,
+    const ModelHook &prepare) {
+  const float c2 = 0.9f;
+  Velocity &exvel = fmMethod.getVelocity();
+  const std::vector<float> m0 = exvel.dat;
+  int n = m0.size();
+
+  std::vector<float> d;
+  lbfgs.direction(m0, grad, vmin, vmax, d);
+  if (!(dot(grad, d) > 0)) {
+    DEBUG() << "l-bfgs direction is not a descent direction, restart from the gradient";
+    lbfgs.reset();
+    lbfgs.direction(m0, grad, vmin, vmax, d);
+  }
+
+  float bestObj = obj, bestAlpha = 0;
+  std::vector<float> bestGrad;
+  std::vector<float> g(n);
+
+  for (bool retry = false; ; retry = true) {
+    double gd = dot(grad, d);
+
+    /// without curvature pairs d is the gradient and only maxdv scales it, the retry starts at half that
+    float maxStep = 2 * maxdvStep(m0, d, dx, dt, maxdv);
+    float alpha = retry ? maxStep / 4 : lbfgs.size() == 0 ? maxStep / 2 : std::min(1.0f, maxStep);
+    float lo = 0, hi = FLT_MAX;
+
+    for (int k = 0; k < ntrial; k++) {
+      bindTrialModel(m0, d, alpha, vmin, vmax, prepare);
+
+      float f = evaluate(g);
+      double gtd = dot(g, d);
+      INFO() << format("l-bfgs trial %d, alpha = %e, obj = %e, slope ratio = %f") % k % alpha % f % (gtd / gd);
+
+      if (f < bestObj) {
+        bestObj = f;
+        bestAlpha = alpha;
+        bestGrad = g;
+      }
+
+      if (!(f < obj)) {
+        hi = alpha;
+      } else if (gtd > c2 * gd && alpha < maxStep) {
+        lo = alpha;
+      } else {
+        break;
+      }
+      alpha = hi < FLT_MAX ? (lo + hi) / 2 : std::min(2 * alpha, maxStep);
+    }
+
+    if (bestAlpha != 0 || retry || lbfgs.size() == 0) {
+      break;
+    }
+    WARNING() << "l-bfgs line search found no decrease, retry along the gradient";
+    lbfgs.reset();
+    lbfgs.direction(m0, grad, vmin, vmax, d);
+  }
+
+  if (bestAlpha == 0) {
+    WARNING() << "l-bfgs line search found no decrease, keep the velocity";
+    exvel.dat = m0;
+    fmMethod.refreshVelocity();
+    lbfgs.reset();
+    return false;
+  }
+
+  bindTrialModel(m0, d, bestAlpha, vmin, vmax, prepare);
+  std::vector<float> s(n);
+  for (int i = 0; i < n; i++) {
+    s[i] = exvel.dat[i] - m0[i];
+  }
+
+  lbfgs.update(s, grad, bestGrad);
+  obj = bestObj;
+  grad = bestGrad;
+  INFO() << format("l-bfgs steplen = %e, obj = %e, %d pairs") % bestAlpha % obj % lbfgs.size();
+  return true;
+}
+
+void FwiBase::bindTrialModel(const std::vector<float> &m0, const std::vector<float> &d, float alpha,
+    float vmin, float vmax, const ModelHook &prepare) {
+  Velocity &exvel = fmMethod.getVelocity();
+  for (size_t i = 0; i < m0.size(); i++) {
+    exvel.dat[i] = std::min(std::max(m0[i] + alpha * d[i], vmin), vmax);
+  }
+  if (prepare) {
+    prepare(&exvel.dat[0]);
+  }
+  fmMethod.refreshVelocity();
+}
+
+/// forward step of the source wavefield. box only grows, so it still holds after a snapshot is restored
+static void sourceStep(const ForwardModeling &fmMethod, FmWorkspace &ws,
+    std::vector<float> &sp0, std::vector<float> &sp1, const float *src, const ShotPosition &srcPos,
+    ForwardModeling::Box &box) {
+  fmMethod.addSource(&sp1[0], src, srcPos);
+  fmMethod.stepForward(ws, sp0, sp1, box);
+  std::swap(sp1, sp0);
+}
+
+/**
+ * the state before time step it is (sp0, sp1), and sp0 is the wavefield the
+ * backward loop of calgradient correlates at step it
+ */
+void FwiBase::checkpointGradient(const ForwardModeling &fmMethod, const float *src, int srcStride,
+    const ShotPosition &srcPos, const std::vector<float> &vsrc, std::vector<float> &g0, int nt, float dt)
+{
+  int size = fmMethod.getnx() * fmMethod.getnz();
+  int ng = fmMethod.getng();
+  const ShotPosition &allGeoPos = fmMethod.getAllGeoPos();
+
+  std::vector<float> sp0(size, 0);
+  std::vector<float> sp1(size, 0);
+  std::vector<float> gp0(size, 0);
+  std::vector<float> gp1(size, 0);
+  FmWorkspace ws;
+
+  /// only the steps with dt * it > 0.3 are correlated, the earlier ones are not reversed
+  int itmin = nt;
+  while (itmin > 0 && dt * (itmin - 1) > 0.3) {
+    itmin--;
+  }
+  ForwardModeling::Box box = fmMethod.activeBox(srcPos);
+  ForwardModeling::Box gbox = fmMethod.activeBox(allGeoPos);
+  for (int it = 0; it < itmin; it++) {
+    sourceStep(fmMethod, ws, sp0, sp1, src + it * srcStride, srcPos, box);
+  }
+
+  Revolve revolve(nt - itmin, nsnap);
+  const std::vector<Revolve::Step> &schedule = revolve.schedule();
+  std::vector<std::vector<float> > snap0(nsnap);
+  std::vector<std::vector<float> > snap1(nsnap);
+  int cur = itmin;
+
+  for (size_t i = 0; i < schedule.size(); i++) {
+    const Revolve::Step &s = schedule[i];
+    int it = itmin + s.step;
+    switch (s.action) {
+    case Revolve::ADVANCE:
+      for (; cur < it; cur++) {
+        sourceStep(fmMethod, ws, sp0, sp1, src + cur * srcStride, srcPos, box);
+      }
+      break;
+    case Revolve::TAKESHOT:
+      snap0[s.slot] = sp0;
+      snap1[s.slot] = sp1;
+      break;
+    case Revolve::RESTORE:
+      sp0 = snap0[s.slot];
+      sp1 = snap1[s.slot];
+      cur = it;
+      break;
+    case Revolve::YOUTURN:
+      /// forward propagate receivers
+      fmMethod.addSource(&gp1[0], &vsrc[it * ng], allGeoPos);
+      fmMethod.stepForward(ws, gp0, gp1, gbox);
+      std::swap(gp1, gp0);
+      cross_correlation(&sp0[0], &gp0[0], &g0[0], g0.size(), dt * it > 0.4 ? 1.0 : (dt * it - 0.3) / 0.1);
+      break;
+    }
+  }
+
+  DEBUG() << format("revolve: %d steps reversed with %d snapshots, %d forward steps")
+      % (nt - itmin) % nsnap % (itmin + revolve.forwardSteps());
+}
+
 float FwiBase::getUpdateObj() const {
 	return updateobj;
 }
@@ -60,6 +290,9 @@ float FwiBase::getInitObj() const {
 }
 
 void FwiBase::cross_correlation(float *src_wave, float *vsrc_wave, float *image, int model_size, float scale) {
+#ifdef USE_OPENMP
+  #pragma omp parallel for
+#endif
   for (int i = 0; i < model_size; i ++) {
     image[i] -= src_wave[i] * vsrc_wave[i] * scale;
   }
@@ -67,9 +300,7 @@ void FwiBase::cross_correlation(float *src_wave, float *vsrc_wave, float *image,
 }
 
 void FwiBase::transVsrc(std::vector<float> &vsrc, int nt, int ng) {
-  for (int ig = 0; ig < ng; ig++) {
-    second_order_virtual_source_forth_accuracy(&vsrc[ig * nt], nt);
-  }
+  second_order_virtual_source_time_major(&vsrc[0], nt, ng);
 }
 
 void FwiBase::updateGrad(float *pre_gradient, const float *cur_gradient, float *update_direction,
@@ -126,6 +357,49 @@ void FwiBase::one_order_virtual_source_forth_accuracy(float *vsrc, int num) {
   free(tmp_vsrc);
 }
 
+/**
+ * the same stencils as above, applied to every trace of time major shot data
+ * (nt rows of ng samples). the rows are combined as a whole, so the inner
+ * loop runs along the receivers
+ */
+void FwiBase::one_order_virtual_source_time_major(float *vsrc, int nt, int ng) {
+  std::vector<float> tmp_vsrc(vsrc, vsrc + nt * ng);
+  for (int it = 0; it < nt; it++) {
+    float *row = vsrc + it * ng;
+    if (it <= 1 || it >= nt - 2) {
+      std::fill(row, row + ng, 0.0f);
+      continue;
+    }
+
+    const float *prev = &tmp_vsrc[(it - 1) * ng];
+    const float *next = &tmp_vsrc[(it + 1) * ng];
+    for (int ig = 0; ig < ng; ig++) {
+      row[ig] = (- prev[ig] + next[ig]) / 2;
+    }
+  }
+}
+
+void FwiBase::second_order_virtual_source_time_major(float *vsrc, int nt, int ng) {
+  std::vector<float> tmp_vsrc(vsrc, vsrc + nt * ng);
+  for (int it = 0; it < nt; it++) {
+    float *row = vsrc + it * ng;
+    if (it <= 1 || it >= nt - 2) {
+      std::fill(row, row + ng, 0.0f);
+      continue;
+    }
+
+    const float *m2 = &tmp_vsrc[(it - 2) * ng];
+    const float *m1 = &tmp_vsrc[(it - 1) * ng];
+    const float *c0 = &tmp_vsrc[it * ng];
+    const float *p1 = &tmp_vsrc[(it + 1) * ng];
+    const float *p2 = &tmp_vsrc[(it + 2) * ng];
+    for (int ig = 0; ig < ng; ig++) {
+      row[ig] = -1. / 12 * m2[ig] + 4. / 3 * m1[ig] -
+                2.5 * c0[ig] + 4. / 3 * p1[ig] - 1. / 12 * p2[ig];
+    }
+  }
+}
+
 void FwiBase::second_order_virtual_source_forth_accuracy(float *vsrc, int num) {
   float *tmp_vsrc = (float *)malloc(num * sizeof(float));
   memcpy(tmp_vsrc, vsrc, num * sizeof(float));
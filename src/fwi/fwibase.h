@@ -8,25 +8,84 @@
 #ifndef SRC_FWI2D_FWIBASE_H_
 #define SRC_FWI2D_FWIBASE_H_
 
+#include <string>
+#include <boost/function.hpp>
 #include "forwardmodeling.h"
+#include "lbfgs.h"
+#include "boundary-store.h"
 
 class FwiBase {
 public:
-  FwiBase(ForwardModeling &fmMethod, const std::vector<float> &wlt,
-                  const std::vector<float> &dobs);
+  enum Optimizer { OPT_CG, OPT_LBFGS };
+
+  /// "cg" or "lbfgs", exits on anything else
+  static Optimizer optimizerFromName(const std::string &name);
+
+public:
+  FwiBase(ForwardModeling &fmMethod, const std::vector<float> &wlt);
 	void cross_correlation(float *src_wave, float *vsrc_wave, float *image, int model_size, float scale);
 	void transVsrc(std::vector<float> &vsrc, int nt, int ng);
 	void updateGrad(float *pre_gradient, const float *cur_gradient, float *update_direction, int model_size, int iter);
 	void one_order_virtual_source_forth_accuracy(float *vsrc, int num);
 	void second_order_virtual_source_forth_accuracy(float *vsrc, int num);
+	void one_order_virtual_source_time_major(float *vsrc, int nt, int ng);
+	void second_order_virtual_source_time_major(float *vsrc, int nt, int ng);
   void writeVel(sf_file file) const;
+
+  /**
+   * rebuild the source wavefield of the gradient from nsnap in-memory
+   * snapshots on a revolve schedule instead of the saved boundaries.
+   * 0 keeps the boundaries and the backward steps
+   */
+  void setCheckpoints(int nsnap);
+
+  /// how the boundaries of the source wavefield are kept when there are no checkpoints
+  void setBoundaryStore(const BoundaryStore::Config &config);
+
+  /**
+   * OPT_CG is the Polak-Ribiere conjugate gradient of updateGrad with the
+   * parabola line search of the framework. OPT_LBFGS is the bounded L-BFGS
+   * of lbfgsStep with nhist pairs and at most ntrial models per line search,
+   * its first step changes the velocity by maxdv at most
+   */
+  void setOptimizer(Optimizer optimizer, int nhist, int ntrial, float maxdv);
   float getUpdateObj() const;
   float getInitObj() const;
 
+protected:
+  /**
+   * adjoint state gradient of one source with the source wavefield replayed
+   * exactly from checkpoints. the source of time step it is src[it * srcStride]
+   * injected at srcPos
+   */
+  void checkpointGradient(const ForwardModeling &fmMethod, const float *src, int srcStride,
+      const ShotPosition &srcPos, const std::vector<float> &vsrc, std::vector<float> &g0, int nt, float dt);
+
+  /// objective of the velocity bound to fmMethod, its descent direction goes to the argument
+  typedef boost::function<float (std::vector<float> &)> Objective;
+  /// fixes up a velocity of the padded grid in place, before it is bound
+  typedef boost::function<void (float *)> ModelHook;
+
+  /**
+   * one L-BFGS iteration from the bound velocity, whose objective and descent
+   * direction are obj and grad. the line search tries the velocities
+   * clip(v + alpha * d, vmin, vmax) until one satisfies the Wolfe conditions
+   * and leaves it bound, with its objective and descent direction in obj and
+   * grad for the next iteration. an L-BFGS direction that brings no decrease
+   * is followed by one more search along the gradient. false if no trial decreased the
+   * objective, then the velocity is kept and the memory is cleared. every trial and the
+   * accepted velocity go through prepare first when it is given
+   */
+  bool lbfgsStep(const Objective &evaluate, float vmin, float vmax, float &obj, std::vector<float> &grad,
+      const ModelHook &prepare = ModelHook());
+
+  /// binds clip(m0 + alpha * d, vmin, vmax), passed through prepare when it is given
+  void bindTrialModel(const std::vector<float> &m0, const std::vector<float> &d, float alpha,
+      float vmin, float vmax, const ModelHook &prepare);
+
 protected:
   ForwardModeling &fmMethod;
   const std::vector<float> &wlt;  /// wavelet
-  const std::vector<float> &dobs; /// actual observed data (nt*ng*ns)
 
 protected: /// propagate from other construction
   int ns;
@@ -43,6 +102,14 @@ protected:
   float updateobj;
   float initobj;
 	float obj_val4;
+  int nsnap;                           /// checkpoints of the source wavefield, 0 for boundaries
+  BoundaryStore::Config bndrConfig;
+
+protected:
+  Optimizer optimizer;
+  Lbfgs lbfgs;
+  int ntrial;                          /// models of an L-BFGS line search at most
+  float maxdv;
 };
 
 #endif /* SRC_ESS_FWI2D_ESSFWIFRAMEWORK_H_ */
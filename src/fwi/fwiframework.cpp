@@ -21,6 +21,8 @@ extern "C"
 #include <functional>
 #include <vector>
 #include <set>
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
 
 #include "logger.h"
 #include "common.h"
@@ -34,35 +36,77 @@ extern "C"
 #include "sfutil.h"
 #include "parabola-vertex.h"
 #include "fwiframework.h"
+#include "omp-utility.h"
+#include "mpi-utility.h"
+#include "shot-scheduler.h"
+#include "shot-aperture.h"
+#include "profiler.h"
 
 #include "aux.h"
 
 FwiFramework::FwiFramework(ForwardModeling &method, const FwiUpdateSteplenOp &updateSteplenOp,
     const FwiUpdateVelOp &_updateVelOp,
-    const std::vector<float> &_wlt, const std::vector<float> &_dobs) :
-    FwiBase(method, _wlt, _dobs), updateStenlelOp(updateSteplenOp), updateVelOp(_updateVelOp)
+    const std::vector<float> &_wlt, const ShotDataStore &_dobs) :
+    FwiBase(method, _wlt), dobs(_dobs), updateStenlelOp(updateSteplenOp), updateVelOp(_updateVelOp),
+    nshotpar(1), threadsPerShot(0), aperture(0), nbatch(1), dataCache(ns, nt * ng), useDataCache(true), optObj(0)
 {
+  updateStenlelOp.setDataCache(&dataCache);
 }
 
-void FwiFramework::epoch(int iter) {
-	std::vector<float> g1(nx * nz, 0);
-	std::vector<float> g2(nx * nz, 0);
-	std::vector<float> encobs(ng * nt, 0);
-	int rank, np, k, ntask, shot_begin, shot_end;
-	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-	MPI_Comm_size(MPI_COMM_WORLD, &np);
-	k = std::ceil(ns * 1.0 / np);
-	ntask = std::min(k, ns - rank*k);
-	shot_begin = rank * k;
-	shot_end = shot_begin + ntask;
-	float local_obj1 = 0.0f, obj1 = 0.0f;
-
-	for(int is = shot_begin ; is < shot_end ; is ++) {
-		std::vector<float> encobs_trans(nt * ng, 0.0f);
-		INFO() << format("calculate gradient, shot id: %d") % is;
-		memcpy(&encobs_trans[0], &dobs[is * ng * nt], sizeof(float) * ng * nt);
+void FwiFramework::setShotParallelism(int nshotpar, int threadsPerShot) {
+  this->nshotpar = nshotpar;
+  this->threadsPerShot = threadsPerShot;
+  updateStenlelOp.setShotParallelism(nshotpar, threadsPerShot);
+}
+
+void FwiFramework::setAperture(int aperture) {
+  this->aperture = aperture;
+  updateStenlelOp.setAperture(aperture);
+}
+
+void FwiFramework::setShotBatch(int nbatch) {
+  this->nbatch = nbatch;
+  updateStenlelOp.setShotBatch(nbatch);
+}
+
+void FwiFramework::setTrialBatch(bool on) {
+  updateStenlelOp.setTrialBatch(on);
+}
+
+/**
+ * add the gradients of a batch of shots to g2 and their objectives to objshot,
+ * g1 and encobs are the buffers of the calling shot group. model is the key
+ * of the bound velocity in the data cache
+ */
+void FwiFramework::calBatchGrad(const std::vector<int> &batch, ShotDataCache::Key model, std::vector<float> &encobs,
+    std::vector<float> &g1, std::vector<double> &g2, std::vector<float> &objshot, int rank) {
+	/// the shots of a batch are modeled in one propagation, the aperture models every shot on its own window.
+	/// the shots the last line search modeled in this velocity are not modeled again
+	std::vector<std::vector<float> > batchDcal(batch.size(), std::vector<float>(nt * ng, 0));
+	std::vector<char> cached(batch.size(), 0);
+	std::vector<int> uncached;
+	for (size_t ib = 0; ib < batch.size(); ib++) {
+		cached[ib] = useDataCache && dataCache.get(batch[ib], model, batchDcal[ib]);
+		if (!cached[ib]) {
+			uncached.push_back(batch[ib]);
+		}
+	}
+	if (aperture <= 0 && !uncached.empty()) {
+		PROFILE("forward");
+		std::vector<std::vector<float> > dcal(uncached.size(), std::vector<float>(nt * ng, 0));
+		fmMethod.FwiForwardModeling(wlt, dcal, uncached);
+		for (size_t ib = 0, k = 0; ib < batch.size(); ib++) {
+			if (!cached[ib]) {
+				batchDcal[ib].swap(dcal[k++]);
+			}
+		}
+	}
 
-		matrix_transpose(&encobs_trans[0], &encobs[0], ng, nt);
+	for (size_t ib = 0; ib < batch.size(); ib++) {
+		PROFILE("shot");
+		int is = batch[ib];
+		INFO() << format("calculate gradient, shot id: %d") % is;
+		dobs.get(is, &encobs[0]);
 
 		/*
 			 if(iter == 1)
@@ -80,14 +124,20 @@ void FwiFramework::epoch(int iter) {
 			 sf_floatwrite(&wlt[0], nt, sf_wlt);
 			 */
 
-		INFO() << "sum encobs: " << std::accumulate(encobs.begin(), encobs.end(), 0.0f);
-		INFO() << wlt[0] << " " << wlt[132];
-		INFO() << "sum wlt: " << std::accumulate(wlt.begin(), wlt.begin() + nt, 0.0f);
+		DEBUG() << "sum encobs: " << std::accumulate(encobs.begin(), encobs.end(), 0.0f);
+		DEBUG() << wlt[0] << " " << wlt[132];
+		DEBUG() << "sum wlt: " << std::accumulate(wlt.begin(), wlt.begin() + nt, 0.0f);
+
+		boost::scoped_ptr<ShotAperture> shotAperture(aperture > 0 ? new ShotAperture(fmMethod, is, aperture) : NULL);
 
-		std::vector<float> dcal(nt * ng, 0);
-		std::vector<float> dcal_trans(ng * nt, 0.0f);
-		fmMethod.FwiForwardModeling(wlt, dcal_trans, is);
-		matrix_transpose(&dcal_trans[0], &dcal[0], ng, nt);
+		std::vector<float> &dcal = batchDcal[ib];
+		if (shotAperture && !cached[ib]) {
+			PROFILE("forward");
+			shotAperture->FwiForwardModeling(wlt, dcal);
+		}
+		if (cached[ib]) {
+			DEBUG() << format("shot %d: data of the line search reused") % is;
+		}
 
 
 		/*
@@ -111,8 +161,8 @@ void FwiFramework::epoch(int iter) {
 			 }
 			 */
 
-		INFO() << dcal[0];
-		INFO() << "sum dcal: " << std::accumulate(dcal.begin(), dcal.end(), 0.0f);
+		DEBUG() << dcal[0];
+		DEBUG() << "sum dcal: " << std::accumulate(dcal.begin(), dcal.end(), 0.0f);
 
 		fmMethod.fwiRemoveDirectArrival(&encobs[0], is);
 		fmMethod.fwiRemoveDirectArrival(&dcal[0], is);
@@ -136,23 +186,36 @@ void FwiFramework::epoch(int iter) {
 			 }
 			 */
 
-		INFO() << "sum encobs2: " << std::accumulate(encobs.begin(), encobs.end(), 0.0f);
-		INFO() << "sum dcal2: " << std::accumulate(dcal.begin(), dcal.end(), 0.0f);
+		DEBUG() << "sum encobs2: " << std::accumulate(encobs.begin(), encobs.end(), 0.0f);
+		DEBUG() << "sum dcal2: " << std::accumulate(dcal.begin(), dcal.end(), 0.0f);
 
 		std::vector<float> vsrc(nt * ng, 0);
 		vectorMinus(encobs, dcal, vsrc);
-		local_obj1 += cal_objective(&vsrc[0], vsrc.size());
-		initobj = iter == 0 ? local_obj1 : initobj;
+		if (shotAperture) {
+			shotAperture->mute(vsrc);
+		}
+		objshot[is] = cal_objective(&vsrc[0], vsrc.size());
 		//DEBUG() << format("obj: %e") % obj1;
-		INFO() << "obj: " << local_obj1 << "\n";
-
-		transVsrc(vsrc, nt, ng);
-
-		INFO() << "sum vsrc: " << std::accumulate(vsrc.begin(), vsrc.end(), 0.0f);
+		INFO() << "obj: " << objshot[is] << "\n";
 
 		g1.assign(nx * nz, 0.0f);
-		//std::vector<float> g1(nx * nz, 0);
-		calgradient(fmMethod, wlt, vsrc, g1, nt, dt, is, rank);
+		if (shotAperture) {
+			/// the gradient of the window, added to the masked g1 of the global grid
+			const ForwardModeling &apertureFm = shotAperture->getFm();
+			std::vector<float> localVsrc;
+			shotAperture->toLocal(vsrc, localVsrc);
+			transVsrc(localVsrc, nt, shotAperture->getng());
+
+			std::vector<float> localGrad(apertureFm.getnx() * apertureFm.getnz(), 0);
+			calgradient(apertureFm, wlt, localVsrc, localGrad, nt, dt, 0, rank);
+			apertureFm.maskGradient(&localGrad[0]);
+			shotAperture->addGradient(localGrad, g1);
+		} else {
+			transVsrc(vsrc, nt, ng);
+			DEBUG() << "sum vsrc: " << std::accumulate(vsrc.begin(), vsrc.end(), 0.0f);
+			//std::vector<float> g1(nx * nz, 0);
+			calgradient(fmMethod, wlt, vsrc, g1, nt, dt, is, rank);
+		}
 
 		/*
 			 sf_file sf_vsrc= sf_output("vsrc.rsf");
@@ -184,7 +247,7 @@ void FwiFramework::epoch(int iter) {
 			 fclose(f);
 			 */
 
-		std::transform(g2.begin(), g2.end(), g1.begin(), g2.begin(), std::plus<float>());
+		std::transform(g2.begin(), g2.end(), g1.begin(), g2.begin(), std::plus<double>());
 
 		/*
 			 sf_file sf_g2 = sf_output("g2.rsf");
@@ -196,10 +259,93 @@ void FwiFramework::epoch(int iter) {
 
 		DEBUG() << format("global grad %.20f") % sum(g2);
 	}
+}
 
-	g1.assign(nx * nz, 0.0f);
-	MPI_Allreduce(&g2[0], &g1[0], g2.size(), MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD);
-	MPI_Allreduce(&local_obj1, &obj1, 1, MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD);
+/**
+ * objective of the bound velocity summed over the shots of all the ranks, and
+ * its masked gradient in grad. grad is the descent direction, the update
+ * direction of the first iteration.
+ * the objective is summed in shot order, it is the same for any number of
+ * ranks. the gradient is summed in double by shot group and by rank, so it
+ * changes with the ranks and with which shots they took, up to rounding
+ */
+float FwiFramework::calObjGrad(std::vector<float> &grad) {
+	PROFILE("gradient");
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	int ngroups = shotGroupCount(nshotpar, ns);
+	int levels;
+	int nthreadshot = beginShotGroups(ngroups, threadsPerShot, levels);
+	std::vector<std::vector<double> > g2part(ngroups);
+	std::vector<float> objshot(ns, 0.0f);
+	ShotScheduler scheduler(ns);
+	Profiler::Path path = Profiler::path();
+	ShotDataCache::Key model = useDataCache ? ShotDataCache::modelKey(fmMethod.getVelocity().dat) : 0;
+
+	/// every group takes shots from the scheduler until none is left, with its own buffers
+#ifdef USE_OPENMP
+	#pragma omp parallel num_threads(ngroups) if(ngroups > 1)
+#endif
+	{
+		int igroup = shotGroupId();
+		enterShotGroup(ngroups, nthreadshot);
+		Profiler::Attach attach(path);
+
+		std::vector<float> g1(nx * nz, 0);
+		std::vector<double> &g2 = g2part[igroup];
+		g2.assign(nx * nz, 0.0);
+		std::vector<float> encobs(ng * nt, 0);
+
+		std::vector<int> batch;
+		for(scheduler.next(nbatch, batch) ; !batch.empty() ; scheduler.next(nbatch, batch)) {
+			calBatchGrad(batch, model, encobs, g1, g2, objshot, rank);
+		}
+	}
+	endShotGroups(levels);
+
+	/// the partial sums of the groups are merged a chunk at a time, the merged chunks are summed over the ranks meanwhile
+	PROFILE("reduce");
+	std::vector<double> &g2 = g2part[0];
+	MpiSumPipeline gsum(g2);
+	gsum.postByShot(objshot);
+	for (size_t b = 0, e; b < g2.size(); b = e) {
+		e = std::min(b + MpiSumPipeline::CHUNK, g2.size());
+		treeReduce(g2part, b, e);
+		gsum.post(e);
+	}
+	gsum.allgather(grad);
+	return gsum.sumByShot();
+}
+
+void FwiFramework::setDataCache(bool on) {
+  this->useDataCache = on;
+  updateStenlelOp.setDataCache(on ? &dataCache : NULL);
+  dataCache.clear();
+}
+
+void FwiFramework::epoch(int iter) {
+	PROFILE("epoch");
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+	if (optimizer == OPT_LBFGS) {
+		/// the line search of the previous iteration left the gradient of this velocity
+		if (optGrad.empty()) {
+			optGrad.resize(nx * nz);
+			optObj = calObjGrad(optGrad);
+		}
+		initobj = iter == 0 ? optObj : initobj;
+		PROFILE("linesearch");
+		lbfgsStep(boost::bind(&FwiFramework::calObjGrad, this, _1), updateVelOp.getvmin(), updateVelOp.getvmax(),
+		    optObj, optGrad);
+		updateobj = optObj;
+		return;
+	}
+
+	std::vector<float> g1(nx * nz, 0);
+	float obj1 = calObjGrad(g1);
+	initobj = iter == 0 ? obj1 : initobj;
 
 	if(rank == 0)
 	{
@@ -235,7 +381,10 @@ void FwiFramework::epoch(int iter) {
 	float steplen;
 	float obj_val1 = 0, obj_val2 = 0, obj_val3 = 0;
 
-	updateStenlelOp.calsteplen(dobs, updateDirection, obj1, iter, steplen, updateobj, rank, shot_begin, shot_end);
+	{
+		PROFILE("linesearch");
+		updateStenlelOp.calsteplen(dobs, updateDirection, obj1, iter, steplen, updateobj, rank);
+	}
 
 
 	float alpha1 = updateStenlelOp.alpha1;
@@ -272,6 +421,10 @@ void FwiFramework::epoch(int iter) {
 		INFO() << format("sum vel %f") % sum(exvel.dat);
 
 	updateVelOp.update(exvel, exvel, updateDirection, steplen);
+	fmMethod.refreshVelocity();
+	if (useDataCache) {
+		dataCache.accept(ShotDataCache::modelKey(exvel.dat));
+	}
 
 	if(rank == 0)
 		INFO() << format("sum vel2 %f") % sum(exvel.dat);
@@ -307,23 +460,30 @@ void FwiFramework::calgradient(const ForwardModeling &fmMethod,
   int ng = fmMethod.getng();
   const ShotPosition &allGeoPos = fmMethod.getAllGeoPos();
   const ShotPosition &allSrcPos = fmMethod.getAllSrcPos();
+  ShotPosition curSrcPos = allSrcPos.clipRange(shot_id, shot_id);
+  PROFILE("adjoint");
 
-  std::vector<float> bndr = fmMethod.initBndryVector(nt);
+  if (nsnap > 0) {
+    checkpointGradient(fmMethod, &wlt[0], 1, curSrcPos, vsrc, g0, nt, dt);
+    return;
+  }
+
+  BoundaryStore bndr(bndrConfig, fmMethod, nt);
   std::vector<float> sp0(nz * nx, 0);
   std::vector<float> sp1(nz * nx, 0);
   std::vector<float> gp0(nz * nx, 0);
   std::vector<float> gp1(nz * nx, 0);
+  FmWorkspace ws;
 
 
-  ShotPosition curSrcPos = allSrcPos.clipRange(shot_id, shot_id);
-
+  ForwardModeling::Box box = fmMethod.activeBox(curSrcPos);
   for(int it=0; it<nt; it++) {
     fmMethod.addSource(&sp1[0], &wlt[it], curSrcPos);
     //printf("it = %d, forward 1\n", it);
-    fmMethod.stepForward(sp0,sp1);
+    fmMethod.stepForward(ws, sp0, sp1, box);
     //printf("it = %d, forward 2\n", it);
     std::swap(sp1, sp0);
-    fmMethod.writeBndry(&bndr[0], &sp0[0], it); //-test
+    bndr.put(it, &sp0[0]); //-test
 		/*
 		const int check_step = 5;
     if ((it > 0) && (it != (nt - 1)) && !(it % check_step)) {
@@ -353,11 +513,14 @@ void FwiFramework::calgradient(const ForwardModeling &fmMethod,
 	fclose(f2);
 	*/
 
-  std::vector<float> vsrc_trans(ng * nt, 0.0f);
-  matrix_transpose(const_cast<float*>(&vsrc[0]), &vsrc_trans[0], nt, ng);
-
+  ForwardModeling::Box gbox = fmMethod.activeBox(allGeoPos);
   for(int it = nt - 1; it >= 0 ; it--) {
-    fmMethod.readBndry(&bndr[0], &sp0[0], it);	//-test
+    if (dt * it <= 0.3) {
+      break;
+    }
+    float scale = dt * it > 0.4 ? 1.0 : (dt * it - 0.3) / 0.1;
+
+    bndr.get(it, &sp0[0]);	//-test
 		/*
 		const int check_step = 5;
 		if(it == nt - 1)
@@ -388,32 +551,16 @@ void FwiFramework::calgradient(const ForwardModeling &fmMethod,
 		*/
 
     std::swap(sp0, sp1); //-test
-    fmMethod.stepBackward(&sp0[0], &sp1[0]);
-    //fmMethod.subEncodedSource(&sp0[0], &wlt[it]);
-    //std::swap(sp0, sp1);	//-test
-    fmMethod.subSource(&sp0[0], &wlt[it], curSrcPos);
+    /// the backward step takes sp0 with weight -1, so adding the source
+    /// before it is subtracting the source from its result
+    fmMethod.addSource(&sp0[0], &wlt[it], curSrcPos);
 
     /**
-     * forward propagate receviers
+     * forward propagate receviers, step both wavefields and correlate them in one sweep
      */
-    fmMethod.addSource(&gp1[0], &vsrc_trans[it * ng], allGeoPos);
-    //printf("it = %d, receiver 1\n", it);
-    fmMethod.stepForward(gp0,gp1);
-    //printf("it = %d, receiver 2\n", it);
+    fmMethod.addSource(&gp1[0], &vsrc[it * ng], allGeoPos);
+    fmMethod.stepAdjoint(ws, &sp0[0], &sp1[0], &gp0[0], &gp1[0], &g0[0], scale, gbox);
     std::swap(gp1, gp0);
-
-    if (dt * it > 0.4) {
-      //printf("it = %d, cross 1\n", it);
-      cross_correlation(&sp0[0], &gp0[0], &g0[0], g0.size(), 1.0);
-      //printf("it = %d, cross 2\n", it);
-    } else if (dt * it > 0.3) {
-      //printf("it = %d, cross 3\n", it);
-      cross_correlation(&sp0[0], &gp0[0], &g0[0], g0.size(), (dt * it - 0.3) / 0.1);
-      //printf("it = %d, cross 4\n", it);
-    } else {
-      //printf("it = %d, cross 5\n");
-      break;
-    }
  }
 }
 
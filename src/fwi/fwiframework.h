@@ -13,13 +13,49 @@
 #include "fwiupdatevelop.h"
 #include "fwiupdatesteplenop.h"
 #include "random-code.h"
+#include "shotdata-store.h"
 
 class FwiFramework : public FwiBase {
 public:
   FwiFramework(ForwardModeling &fmMethod, const FwiUpdateSteplenOp &updateSteplenOp,
                   const FwiUpdateVelOp &updateVelOp, const std::vector<float> &wlt,
-                  const std::vector<float> &dobs);
+                  const ShotDataStore &dobs);
 	void epoch(int iter);
+
+  /**
+   * run nshotpar shots of a rank at the same time, each with threadsPerShot
+   * threads (<= 0 shares the threads of the rank). the line search uses the
+   * same setting
+   */
+  void setShotParallelism(int nshotpar, int threadsPerShot);
+
+  /**
+   * propagate every shot on the model columns around its source and the
+   * receivers within aperture cells of it, see ShotAperture. 0 uses the whole
+   * model. the line search uses the same setting
+   */
+  void setAperture(int aperture);
+
+  /**
+   * model the shots nbatch at a time in one propagation, see the batch version
+   * of ForwardModeling::FwiForwardModeling. the line search uses the same setting
+   */
+  void setShotBatch(int nbatch);
+
+  /**
+   * the line search models the trial step lengths of a shot in one
+   * propagation, see the models version of ForwardModeling::FwiForwardModeling.
+   * it is used when the shots are neither batched nor modeled on an aperture
+   */
+  void setTrialBatch(bool on);
+
+  /**
+   * keep the data the line search models in the trial velocities, see
+   * ShotDataCache. when the model taken is one of the trial models, the next
+   * gradient reuses the data instead of modeling the shot again. it costs
+   * the data of the local shots in two trial models
+   */
+  void setDataCache(bool on);
 	void calgradient(const ForwardModeling &fmMethod,
     const std::vector<float> &encSrc,
     const std::vector<float> &vsrc,
@@ -28,9 +64,23 @@ public:
 		int shot_id, int rank);
 
 
+private:
+  float calObjGrad(std::vector<float> &grad);
+  void calBatchGrad(const std::vector<int> &batch, ShotDataCache::Key model, std::vector<float> &encobs,
+      std::vector<float> &g1, std::vector<double> &g2, std::vector<float> &objshot, int rank);
+
 protected:
+  const ShotDataStore &dobs; /// actual observed data, partitioned by shot
   FwiUpdateSteplenOp updateStenlelOp;
   const FwiUpdateVelOp &updateVelOp;
+  int nshotpar;
+  int threadsPerShot;
+  int aperture;
+  int nbatch;
+  ShotDataCache dataCache;
+  bool useDataCache;
+  float optObj;                /// objective and gradient of the bound velocity, kept by the L-BFGS iterations
+  std::vector<float> optGrad;
 };
 
 #endif /* SRC_ESS_FWI2D_ESSFWIFRAMEWORK_H_ */
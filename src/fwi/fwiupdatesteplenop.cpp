@@ -7,12 +7,18 @@
 
 #include <set>
 #include <cmath>
+#include <boost/ptr_container/ptr_vector.hpp>
 #include "fwiupdatesteplenop.h"
 #include "logger.h"
 #include "common.h"
 #include "parabola-vertex.h"
 #include "sum.h"
 #include "mpi.h"
+#include "omp-utility.h"
+#include "mpi-utility.h"
+#include "shot-scheduler.h"
+#include "shot-aperture.h"
+#include "profiler.h"
 
 namespace {
 typedef std::pair<float, float> ParaPoint;
@@ -51,14 +57,45 @@ void calMaxAlpha2_3(const Velocity &exvel,  const float *grad, float dt, float d
 
 FwiUpdateSteplenOp::FwiUpdateSteplenOp(const ForwardModeling &fmMethod, const FwiUpdateVelOp &updateVelOp,
     int max_iter_select_alpha3, float maxdv, int ns, int ng, int nt, std::vector<float> *encsrc) :
-  fmMethod(fmMethod), updateVelOp(updateVelOp), encsrc(encsrc), encobs(NULL),
-  max_iter_select_alpha3(max_iter_select_alpha3), maxdv(maxdv), ns(ns), ng(ng), nt(nt)
+  fmMethod(fmMethod), updateVelOp(updateVelOp), encsrc(encsrc),
+  max_iter_select_alpha3(max_iter_select_alpha3), maxdv(maxdv), ns(ns), ng(ng), nt(nt),
+  nshotpar(1), threadsPerShot(0), aperture(0), nbatch(1), trialBatch(true), dataCache(NULL)
 {
 
 }
 
-float FwiUpdateSteplenOp::calobjval(const std::vector<float>& grad,
-    float steplen, int shot_id) const {
+void FwiUpdateSteplenOp::setShotParallelism(int nshotpar, int threadsPerShot) {
+  this->nshotpar = nshotpar;
+  this->threadsPerShot = threadsPerShot;
+}
+
+void FwiUpdateSteplenOp::setAperture(int aperture) {
+  this->aperture = aperture;
+}
+
+void FwiUpdateSteplenOp::setShotBatch(int nbatch) {
+  this->nbatch = nbatch;
+}
+
+void FwiUpdateSteplenOp::setTrialBatch(bool on) {
+  this->trialBatch = on;
+}
+
+void FwiUpdateSteplenOp::setDataCache(ShotDataCache *cache) {
+  this->dataCache = cache;
+}
+
+ShotDataCache::Key FwiUpdateSteplenOp::trialKey(const std::vector<float> &grad, float steplen) const {
+  if (!dataCache) {
+    return 0;
+  }
+  Velocity trialVel(fmMethod.getnx(), fmMethod.getnz());
+  updateVelOp.update(trialVel, fmMethod.getVelocity(), grad, steplen);
+  return ShotDataCache::modelKey(trialVel.dat);
+}
+
+void FwiUpdateSteplenOp::calobjval(const std::vector<float>& grad, float steplen, ShotDataCache::Key key,
+    const std::vector<int> &shot_ids, const std::vector<std::vector<float> > &encobs, std::vector<float> &val) const {
   int nx = fmMethod.getnx();
   int nz = fmMethod.getnz();
   int nt = fmMethod.getnt();
@@ -93,10 +130,20 @@ float FwiUpdateSteplenOp::calobjval(const std::vector<float>& grad,
 
   //forward modeling
   int ng = fmMethod.getng();
-  std::vector<float> dcal(nt * ng);
-  std::vector<float> dcal_trans(nt * ng);
-  updateMethod.FwiForwardModeling(*encsrc, dcal_trans, shot_id);
-	matrix_transpose(&dcal_trans[0], &dcal[0], ng, nt);
+  int nbat = shot_ids.size();
+  std::vector<std::vector<float> > dcal(nbat, std::vector<float>(nt * ng));
+  /// one window per shot of the batch with the aperture, none without
+  boost::ptr_vector<ShotAperture> shotAperture;
+  if (aperture > 0) {
+    PROFILE("forward");
+    for (int ib = 0; ib < nbat; ib++) {
+      shotAperture.push_back(new ShotAperture(updateMethod, shot_ids[ib], aperture));
+      shotAperture[ib].FwiForwardModeling(*encsrc, dcal[ib]);
+    }
+  } else {
+    PROFILE("forward");
+    updateMethod.FwiForwardModeling(*encsrc, dcal, shot_ids);
+  }
 
   /*
 	sf_file sf_dcal2 = sf_output("dcal2.rsf");
@@ -107,7 +154,6 @@ float FwiUpdateSteplenOp::calobjval(const std::vector<float>& grad,
   */
 
   updateMethod.bindVelocity(oldVel);  //-test
-  updateMethod.fwiRemoveDirectArrival(&dcal[0], shot_id);
   //updateMethod.bindVelocity(newVel);  //-test
 
 	/*
@@ -118,36 +164,98 @@ float FwiUpdateSteplenOp::calobjval(const std::vector<float>& grad,
   exit(1);
 	*/
 
-  std::vector<float> vdiff(nt * ng, 0);
-		INFO() << "****sum encobs: " << std::accumulate((*encobs).begin(), (*encobs).begin() + ng * nt, 0.0f);
-		INFO() << "****sum2 dcal: " << std::accumulate(dcal.begin(), dcal.begin() + ng * nt, 0.0f);
+  val.resize(nbat);
+  for (int ib = 0; ib < nbat; ib++) {
+    if (dataCache) {
+      dataCache->putTrial(shot_ids[ib], key, dcal[ib]);
+    }
+    updateMethod.fwiRemoveDirectArrival(&dcal[ib][0], shot_ids[ib]);
+
+    std::vector<float> vdiff(nt * ng, 0);
+		DEBUG() << "****sum encobs: " << std::accumulate(encobs[ib].begin(), encobs[ib].begin() + ng * nt, 0.0f);
+		DEBUG() << "****sum2 dcal: " << std::accumulate(dcal[ib].begin(), dcal[ib].begin() + ng * nt, 0.0f);
 	
-  vectorMinus(*encobs, dcal, vdiff);
-  float val = cal_objective(&vdiff[0], vdiff.size());
+    vectorMinus(encobs[ib], dcal[ib], vdiff);
+    if (!shotAperture.empty()) {
+      shotAperture[ib].mute(vdiff);
+    }
+    val[ib] = cal_objective(&vdiff[0], vdiff.size());
 
-  DEBUG() << format("curr_alpha = %e, pure object value = %e") % steplen % val;
+    DEBUG() << format("shot %d, curr_alpha = %e, pure object value = %e") % shot_ids[ib] % steplen % val[ib];
+  }
+}
+
+void FwiUpdateSteplenOp::calobjval(const std::vector<float> &grad, const std::vector<float> &steplen,
+    const std::vector<ShotDataCache::Key> &key, int shot_id, const std::vector<float> &encobs, std::vector<float> &val) const {
+  int nt = fmMethod.getnt();
+  int ng = fmMethod.getng();
+  int nmod = steplen.size();
+
+  /// the updated velocities are never built, the propagation updates the coefficients it loads
+  std::vector<std::vector<float> > dcal(nmod, std::vector<float>(nt * ng));
+  {
+    PROFILE("forward");
+    fmMethod.FwiForwardModeling(*encsrc, grad, steplen, updateVelOp.getvmin(), updateVelOp.getvmax(), dcal, shot_id);
+  }
+
+  val.resize(nmod);
+  for (int im = 0; im < nmod; im++) {
+    if (dataCache) {
+      dataCache->putTrial(shot_id, key[im], dcal[im]);
+    }
+    fmMethod.fwiRemoveDirectArrival(&dcal[im][0], shot_id);
 
-  return val;
+    std::vector<float> vdiff(nt * ng, 0);
+    vectorMinus(encobs, dcal[im], vdiff);
+    val[im] = cal_objective(&vdiff[0], vdiff.size());
+
+    DEBUG() << format("shot %d, curr_alpha = %e, pure object value = %e") % shot_id % steplen[im] % val[im];
+  }
 }
 
 bool FwiUpdateSteplenOp::refineAlpha(const std::vector<float> &grad, float obj_val1, float maxAlpha3,
-    float& _alpha2, float& _obj_val2, float& _alpha3, float& _obj_val3, int shot_id) const {
+    float& _alpha2, std::vector<float> &_obj_val2, float& _alpha3, std::vector<float> &_obj_val3,
+    ShotDataCache::Key key2, ShotDataCache::Key key3,
+    const std::vector<int> &shot_ids, std::vector<std::vector<float> > &encobs) const {
 
   TRACE() << "SELECTING THE RIGHT OBJECTIVE VALUE 3";
 
   float alpha3 = _alpha3;
   float alpha2 = _alpha2;
-  float obj_val2, obj_val3 = 0;
+  std::vector<float> obj_val2, obj_val3;
 
-	fmMethod.fwiRemoveDirectArrival(&(*encobs)[0], shot_id);
+  for (size_t ib = 0; ib < shot_ids.size(); ib++) {
+    fmMethod.fwiRemoveDirectArrival(&encobs[ib][0], shot_ids[ib]);
+  }
 
-  obj_val2 = calobjval(grad, alpha2, shot_id);
-  obj_val3 = calobjval(grad, alpha3, shot_id);
+  /// the trial models of a shot share one propagation, unless the shots are batched or
+  /// each is modeled on its own window
+  if (trialBatch && aperture <= 0 && nbatch <= 1) {
+    std::vector<float> steplen(2), val;
+    std::vector<ShotDataCache::Key> key(2);
+    steplen[0] = alpha2;
+    steplen[1] = alpha3;
+    key[0] = key2;
+    key[1] = key3;
+    obj_val2.resize(shot_ids.size());
+    obj_val3.resize(shot_ids.size());
+    for (size_t ib = 0; ib < shot_ids.size(); ib++) {
+      calobjval(grad, steplen, key, shot_ids[ib], encobs[ib], val);
+      obj_val2[ib] = val[0];
+      obj_val3[ib] = val[1];
+    }
+  } else {
+    calobjval(grad, alpha2, key2, shot_ids, encobs, obj_val2);
+    calobjval(grad, alpha3, key3, shot_ids, encobs, obj_val3);
+  }
 
   //DEBUG() << "BEFORE TUNNING";
   DEBUG() << __FUNCTION__ << format(" alpha1 = %e, obj_val1 = %e") % 0. % obj_val1;
-  DEBUG() << __FUNCTION__ << format(" alpha2 = %e, obj_val2 = %e") % alpha2 % obj_val2;
-  DEBUG() << __FUNCTION__ << format(" alpha3 = %e, obj_val3 = %e") % alpha3 % obj_val3;
+  for (size_t ib = 0; ib < shot_ids.size(); ib++) {
+    DEBUG() << __FUNCTION__ << format(" shot %d") % shot_ids[ib];
+    DEBUG() << __FUNCTION__ << format(" alpha2 = %e, obj_val2 = %e") % alpha2 % obj_val2[ib];
+    DEBUG() << __FUNCTION__ << format(" alpha3 = %e, obj_val3 = %e") % alpha3 % obj_val3[ib];
+  }
 
 
 	/*
@@ -330,8 +438,8 @@ void FwiUpdateSteplenOp::parabola_fit(float alpha1, float alpha2, float alpha3,
 }
 */
 
-void FwiUpdateSteplenOp::calsteplen(const std::vector<float> &dobs, const std::vector<float>& grad,
-    float obj_val1, int iter, float &steplen, float &objval, int rank, int shot_begin, int shot_end) {
+void FwiUpdateSteplenOp::calsteplen(const ShotDataStore &dobs, const std::vector<float>& grad,
+    float obj_val1, int iter, float &steplen, float &objval, int rank) {
 
   float dt = fmMethod.getdt();
   float dx = fmMethod.getdx();
@@ -346,30 +454,60 @@ void FwiUpdateSteplenOp::calsteplen(const std::vector<float> &dobs, const std::v
 	this->obj_val1 = obj_val1;
   initAlpha23(max_alpha3, alpha2, alpha3);
   DEBUG() << format("after init alpha,  alpha2 = %e,      alpha3: = %e") % alpha2 % alpha3;
-	float local_obj_val2_sum = 0.0f;
-	float local_obj_val3_sum = 0.0f;
 	obj_val1_sum = 0.0f;
 	obj_val2_sum = 0.0f;
 	obj_val3_sum = 0.0f;
 
 	maxAlpha3 = max_alpha3;
-
-	for(int is = shot_begin ; is < shot_end ; is ++)
+	/// the same trial models for every shot, their keys are computed once
+	ShotDataCache::Key key2 = trialKey(grad, alpha2);
+	ShotDataCache::Key key3 = trialKey(grad, alpha3);
+
+	int ngroups = shotGroupCount(nshotpar, ns);
+	int levels;
+	int nthreadshot = beginShotGroups(ngroups, threadsPerShot, levels);
+	std::vector<float> obj2shot(ns, 0.0f);
+	std::vector<float> obj3shot(ns, 0.0f);
+	std::vector<int> parabolicshot(ns, 0);
+	ShotScheduler scheduler(ns);
+	Profiler::Path path = Profiler::path();
+
+#ifdef USE_OPENMP
+	#pragma omp parallel num_threads(ngroups) if(ngroups > 1)
+#endif
 	{
-		std::vector<float> t_obs(ng * nt);
-		std::vector<float> t_obs_trans(ng * nt);
-		memcpy(&t_obs_trans[0], &dobs[is * ng * nt], sizeof(float) * ng * nt);
-	  matrix_transpose(&t_obs_trans[0], &t_obs[0], ng, nt);
-
-		encobs = &t_obs;
-		INFO() << format("calculate steplen, shot id: %d") % is;
-		toParabolic = refineAlpha(grad, obj_val1, max_alpha3, alpha2, obj_val2, alpha3, obj_val3, is);
-		local_obj_val2_sum += obj_val2;
-		local_obj_val3_sum += obj_val3;
+		enterShotGroup(ngroups, nthreadshot);
+		Profiler::Attach attach(path);
+
+		std::vector<int> batch;
+		for(scheduler.next(nbatch, batch) ; !batch.empty() ; scheduler.next(nbatch, batch))
+		{
+			PROFILE("shot");
+			std::vector<std::vector<float> > t_obs(batch.size(), std::vector<float>(ng * nt));
+			for (size_t ib = 0; ib < batch.size(); ib++) {
+				dobs.get(batch[ib], &t_obs[ib][0]);
+				INFO() << format("calculate steplen, shot id: %d") % batch[ib];
+			}
+
+			float a2 = alpha2, a3 = alpha3;
+			std::vector<float> o2, o3;
+			bool parabolic = refineAlpha(grad, obj_val1, max_alpha3, a2, o2, a3, o3, key2, key3, batch, t_obs);
+			for (size_t ib = 0; ib < batch.size(); ib++) {
+				parabolicshot[batch[ib]] = parabolic;
+				obj2shot[batch[ib]] = o2[ib];
+				obj3shot[batch[ib]] = o3[ib];
+			}
+		}
 	}
+	endShotGroups(levels);
+
 	obj_val1_sum = obj_val1;
-	MPI_Allreduce(&local_obj_val2_sum, &obj_val2_sum, 1, MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD);
-	MPI_Allreduce(&local_obj_val3_sum, &obj_val3_sum, 1, MPI_FLOAT, MPI_SUM, MPI_COMM_WORLD);
+	obj_val2_sum = MpiSumByShot(obj2shot);
+	obj_val3_sum = MpiSumByShot(obj3shot);
+	/// toParabolic of the last shot, as the serial loop did
+	int lastParabolic = parabolicshot[ns - 1], parabolic = 0;
+	MPI_Allreduce(&lastParabolic, &parabolic, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+	toParabolic = parabolic;
 	if(rank == 0)
 	{
 		INFO() << format("In calsteplen(): iter %d  alpha = %e total obj_val1 = %e") % iter % alpha1 % obj_val1_sum;
@@ -11,14 +11,25 @@
 #include <vector>
 #include "forwardmodeling.h"
 #include "fwiupdatevelop.h"
+#include "shotdata-store.h"
+#include "shotdata-cache.h"
 
 class FwiUpdateSteplenOp {
 public:
   FwiUpdateSteplenOp(const ForwardModeling &fmMethod, const FwiUpdateVelOp &updateVelOp, int max_iter_select_alpha3, float maxdv, int ns, int ng, int nt, std::vector<float> *encsrc);
 
   void bindEncSrcObs(const std::vector<float> &encsrc, const std::vector<float> &encobs);
-  void calsteplen(const std::vector<float> &dobs, const std::vector<float> &grad, float obj_val1, int iter, float &steplen, float &objval, int rank, int shot_begin, int shot_end);
+  void calsteplen(const ShotDataStore &dobs, const std::vector<float> &grad, float obj_val1, int iter, float &steplen, float &objval, int rank);
 	void parabola_fit(float alpha1, float alpha2, float alpha3, float obj_val1, float obj_val2, float obj_val3, float maxAlpha3, bool toParabolic, int iter, float &steplen, float &objval);
+  void setShotParallelism(int nshotpar, int threadsPerShot);
+  /// model the shots on their aperture, see FwiFramework::setAperture
+  void setAperture(int aperture);
+  /// model nbatch shots in one propagation, see FwiFramework::setShotBatch
+  void setShotBatch(int nbatch);
+  /// model the trial step lengths of a shot in one propagation, see FwiFramework::setTrialBatch
+  void setTrialBatch(bool on);
+  /// put the data of every trial model in cache, NULL keeps none
+  void setDataCache(ShotDataCache *cache);
 
 public:
 	float alpha1, alpha2, alpha3, obj_val1, obj_val2, obj_val3;
@@ -27,8 +38,19 @@ public:
 	bool	toParabolic;
 
 private:
-  float calobjval(const std::vector<float> &grad, float steplen, int shot_id) const;
-  bool refineAlpha(const std::vector<float> &grad, float obj_val1, float maxAlpha3, float &_alpha2, float &_obj_val2, float &_alpha3, float &_obj_val3, int shot_id) const;
+  /// key of the trial model at steplen in the data cache, 0 without a cache
+  ShotDataCache::Key trialKey(const std::vector<float> &grad, float steplen) const;
+  /// objective values of the shots at steplen, the shots are modeled together. key is trialKey(grad, steplen)
+  void calobjval(const std::vector<float> &grad, float steplen, ShotDataCache::Key key, const std::vector<int> &shot_ids,
+      const std::vector<std::vector<float> > &encobs, std::vector<float> &val) const;
+  /// objective values of shot shot_id at every step length of steplen, the models are modeled together.
+  /// key[im] is trialKey(grad, steplen[im])
+  void calobjval(const std::vector<float> &grad, const std::vector<float> &steplen, const std::vector<ShotDataCache::Key> &key,
+      int shot_id, const std::vector<float> &encobs, std::vector<float> &val) const;
+  /// key2 and key3 are the trial keys of _alpha2 and _alpha3
+  bool refineAlpha(const std::vector<float> &grad, float obj_val1, float maxAlpha3, float &_alpha2, std::vector<float> &_obj_val2,
+      float &_alpha3, std::vector<float> &_obj_val3, ShotDataCache::Key key2, ShotDataCache::Key key3,
+      const std::vector<int> &shot_ids, std::vector<std::vector<float> > &encobs) const;
   void initAlpha23(float maxAlpha3, float &initAlpha2, float &initAlpha3);
 
 private:
@@ -43,11 +65,16 @@ private:
   const ForwardModeling &fmMethod;
   const FwiUpdateVelOp &updateVelOp;
   const std::vector<float> *encsrc;
-  std::vector<float> *encobs;
 
   int max_iter_select_alpha3;
   float maxdv;
 	int ns, ng, nt;
+  int nshotpar;
+  int threadsPerShot;
+  int aperture;
+  int nbatch;
+  bool trialBatch;
+  ShotDataCache *dataCache;
 };
 
 #endif /* SRC_ESS_FWI2D_UPDATESTEPLENOP_H_ */
@@ -0,0 +1,165 @@
+/*
+ * multiscale-fwi.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: rice
+ */
+
+#include <cmath>
+#include <algorithm>
+#include "multiscale-fwi.h"
+#include "fwiupdatevelop.h"
+#include "fwiupdatesteplenop.h"
+#include "shot-scheduler.h"
+#include "lowpass.h"
+#include "logger.h"
+
+const float MultiscaleFwi::SAFETY = 0.8f;
+const int MultiscaleFwi::INTERVALS = 4;
+
+MultiscaleFwi::MultiscaleFwi(const ShotPosition &allSrcPos, const ShotPosition &allGeoPos, float dt, float dx, float fm,
+    int nb, int nt, int freeSurface, float vmin, float vmax, float maxdv, int nita,
+    const std::vector<float> &wlt, const ShotDataStore &dobs) :
+  allSrcPos(allSrcPos), allGeoPos(allGeoPos), dt(dt), dx(dx), fm(fm),
+  nb(nb), nt(nt), freeSurface(freeSurface), vmin(vmin), vmax(vmax), maxdv(maxdv), nita(nita),
+  wlt(wlt), dobs(dobs), maxk(4)
+{
+}
+
+void MultiscaleFwi::setMaxCoarsening(int maxk) {
+  this->maxk = std::max(1, maxk);
+}
+
+void MultiscaleFwi::setSetup(const Setup &setup) {
+  this->setup = setup;
+}
+
+int MultiscaleFwi::coarsening(float fmax) const {
+  float wavelength = SAFETY * vmin / fmax;
+  int k = 1;
+  while (k < maxk && wavelength > INTERVALS * std::sqrt(2.0f) * dx * (k + 1)) {
+    k++;
+  }
+  return k;
+}
+
+/**
+ * the slowness averaged over the cells within k / 2 of every coarse cell
+ */
+Velocity MultiscaleFwi::restrict(const Velocity &v, int k) {
+  Velocity ret((v.nx - 1) / k + 1, (v.nz - 1) / k + 1);
+  for (int ix = 0; ix < ret.nx; ix++) {
+    for (int iz = 0; iz < ret.nz; iz++) {
+      int x0 = std::max(ix * k - k / 2, 0), x1 = std::min(ix * k + k / 2, v.nx - 1);
+      int z0 = std::max(iz * k - k / 2, 0), z1 = std::min(iz * k + k / 2, v.nz - 1);
+      double s = 0;
+      for (int x = x0; x <= x1; x++) {
+        for (int z = z0; z <= z1; z++) {
+          s += 1.0 / v.dat[x * v.nz + z];
+        }
+      }
+      ret.dat[ix * ret.nz + iz] = (x1 - x0 + 1) * (z1 - z0 + 1) / s;
+    }
+  }
+  return ret;
+}
+
+/**
+ * v += the bilinear interpolation of vnew - vold, coarse cell (ix, iz) is at full cell (ix * k, iz * k)
+ */
+void MultiscaleFwi::prolongUpdate(const Velocity &vold, const Velocity &vnew, int k, Velocity &v) {
+  int nzc = vold.nz;
+  for (int ix = 0; ix < v.nx; ix++) {
+    int cx0 = std::min(ix / k, vold.nx - 1);
+    int cx1 = std::min(cx0 + 1, vold.nx - 1);
+    float wx = (float)(ix - cx0 * k) / k;
+    for (int iz = 0; iz < v.nz; iz++) {
+      int cz0 = std::min(iz / k, nzc - 1);
+      int cz1 = std::min(cz0 + 1, nzc - 1);
+      float wz = (float)(iz - cz0 * k) / k;
+      float d00 = vnew.dat[cx0 * nzc + cz0] - vold.dat[cx0 * nzc + cz0];
+      float d01 = vnew.dat[cx0 * nzc + cz1] - vold.dat[cx0 * nzc + cz1];
+      float d10 = vnew.dat[cx1 * nzc + cz0] - vold.dat[cx1 * nzc + cz0];
+      float d11 = vnew.dat[cx1 * nzc + cz1] - vold.dat[cx1 * nzc + cz1];
+      float d = (1 - wx) * ((1 - wz) * d00 + wz * d01) + wx * ((1 - wz) * d10 + wz * d11);
+      v.dat[ix * v.nz + iz] += d;
+    }
+  }
+}
+
+void MultiscaleFwi::run(float fmax, int niter, Velocity &v) {
+  int rank, np;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &np);
+
+  int ns = allSrcPos.ns;
+  int ng = allGeoPos.ns;
+  int k = coarsening(fmax);
+  int nxc = (v.nx - 1) / k + 1;
+  int nzc = (v.nz - 1) / k + 1;
+  int ntc = (nt - 1) / k + 1;
+  float dxc = dx * k;
+  float dtc = dt * k;
+
+  INFO() << format("band below %.2f Hz: grid %d x %d, dx %.2f, %d steps of %.5f s") % fmax % nxc % nzc % dxc % ntc % dtc;
+  /// stops the run if the band grid is unstable, warns if it is too coarse for fmax
+  cfl_acoustic(vmin, vmax, dxc, -1, dxc, dtc, fmax, SAFETY, INTERVALS);
+
+  /// wavelet and data low passed on the full time axis, then every k-th sample
+  LowPass lowpass(dt, fmax);
+  std::vector<float> w = wlt;
+  lowpass.apply(&w[0], nt);
+  /// a step records the wavefield one step after it injects the source, that
+  /// is k - 1 samples later on the band grid, so the band wavelet is delayed as much
+  std::vector<float> wltc(ntc, 0.0f);
+  for (int it = 1; it < ntc; it++) {
+    wltc[it] = w[it * k - (k - 1)];
+  }
+
+  ShotDataStore dobsc(ns, ntc, ng);
+  std::vector<float> shot(nt * ng);
+  std::vector<float> shotc(ntc * ng);
+  int begin, end;
+  shotBlock(ns, np, rank, begin, end);
+  for (int is = begin; is < end; is++) {
+    dobs.get(is, &shot[0]);
+#ifdef USE_OPENMP
+    #pragma omp parallel for
+#endif
+    for (int ig = 0; ig < ng; ig++) {
+      lowpass.apply(&shot[ig], nt, ng);
+    }
+    for (int it = 0; it < ntc; it++) {
+      std::copy(&shot[it * k * ng], &shot[(it * k + 1) * ng], &shotc[it * ng]);
+    }
+    dobsc.put(is, &shotc[0]);
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  ShotPosition srcPos = allSrcPos.coarsen(k, nxc, nzc);
+  ShotPosition geoPos = allGeoPos.coarsen(k, nxc, nzc);
+  ForwardModeling fmMethod(srcPos, geoPos, dtc, dxc, fm, nb, ntc, freeSurface);
+  Velocity vc = restrict(v, k);
+  Velocity exvel = fmMethod.expandDomain(vc);
+  fmMethod.bindVelocity(exvel);
+
+  FwiUpdateVelOp updatevelop(vmin, vmax, dxc, dtc);
+  FwiUpdateSteplenOp updateSteplenOp(fmMethod, updatevelop, nita, maxdv, ns, ng, ntc, &wltc);
+  FwiFramework fwi(fmMethod, updateSteplenOp, updatevelop, wltc, dobsc);
+  if (setup) {
+    setup(fwi, fmMethod, k);
+  }
+
+  for (int iter = 0; iter < niter; iter++) {
+    INFO() << format("band below %.2f Hz, iter %d") % fmax % iter;
+    fwi.epoch(iter);
+    if (iter == 0) {
+      INFO() << format("band below %.2f Hz, initial objective %e") % fmax % fwi.getInitObj();
+    }
+  }
+
+  prolongUpdate(vc, fmMethod.recoverDomain(), k, v);
+  for (size_t i = 0; i < v.dat.size(); i++) {
+    v.dat[i] = std::min(std::max(v.dat[i], vmin), vmax);
+  }
+}
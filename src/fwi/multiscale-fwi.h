@@ -0,0 +1,70 @@
+/*
+ * multiscale-fwi.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: rice
+ */
+
+#ifndef SRC_FWI_MULTISCALE_FWI_H_
+#define SRC_FWI_MULTISCALE_FWI_H_
+
+#include <vector>
+#include <boost/function.hpp>
+#include "forwardmodeling.h"
+#include "fwiframework.h"
+#include "shotdata-store.h"
+
+/**
+ * frequency bands of a multiscale FWI run before the full band one. a band
+ * low passes the wavelet and the observed data below its fmax and inverts
+ * them on a grid k times coarser in x, z and t, k as large as the accuracy
+ * check of cfl_acoustic allows for vmin and fmax, and at most maxk. the
+ * Courant number of the band grid is the one of the full grid, so a band
+ * costs about 1 / k^3 of a full band iteration.
+ *
+ * a band starts from the model restricted to its grid, and the update it
+ * makes is prolonged back to the full grid bilinearly. the band grid keeps nb
+ * sponge cells, k times thicker than the full grid ones, so the bands fit data
+ * without the low frequency sponge reflections of a thin full grid boundary.
+ */
+class MultiscaleFwi {
+public:
+  /// settings of the FwiFramework of a band, k is the coarsening of the band grid
+  typedef boost::function<void (FwiFramework &fwi, ForwardModeling &fm, int k)> Setup;
+
+public:
+  MultiscaleFwi(const ShotPosition &allSrcPos, const ShotPosition &allGeoPos, float dt, float dx, float fm,
+      int nb, int nt, int freeSurface, float vmin, float vmax, float maxdv, int nita,
+      const std::vector<float> &wlt, const ShotDataStore &dobs);
+
+  void setMaxCoarsening(int maxk);
+  void setSetup(const Setup &setup);
+
+  /// the coarsening of the grid of the band below fmax
+  int coarsening(float fmax) const;
+
+  /// niter iterations of the band below fmax starting from v, the model on the full grid, which gets the result
+  void run(float fmax, int niter, Velocity &v);
+
+private:
+  static Velocity restrict(const Velocity &v, int k);
+  static void prolongUpdate(const Velocity &vold, const Velocity &vnew, int k, Velocity &v);
+
+private:
+  static const float SAFETY;    /// cfl_acoustic: a wavelength of SAFETY * vmin / fmax
+  static const int INTERVALS;   ///   spans more than INTERVALS diagonals of a cell
+
+private:
+  const ShotPosition &allSrcPos;
+  const ShotPosition &allGeoPos;
+  float dt, dx, fm;
+  int nb, nt, freeSurface;
+  float vmin, vmax, maxdv;
+  int nita;
+  const std::vector<float> &wlt;
+  const ShotDataStore &dobs;
+  int maxk;
+  Setup setup;
+};
+
+#endif /* SRC_FWI_MULTISCALE_FWI_H_ */
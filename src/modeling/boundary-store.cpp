@@ -0,0 +1,363 @@
+/*
+ * boundary-store.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: rice
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include "boundary-store.h"
+#include "forwardmodeling.h"
+#include "logger.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BOUNDARY_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/// the largest value of a strip becomes 2^15, the smallest normal half is then 2^-29 of it
+const float HALF_RANGE = 32768.0f;
+
+/**
+ * round to nearest even, the same as the f16c conversion
+ */
+uint16_t halfFromFloat(float f) {
+  uint32_t x;
+  std::memcpy(&x, &f, sizeof(x));
+  uint32_t sign = (x >> 16) & 0x8000;
+  uint32_t a = x & 0x7fffffff;
+
+  if (a >= 0x47800000) {
+    /// 2^16 and above, inf and nan
+    return sign | (a > 0x7f800000 ? 0x7e00 : 0x7c00);
+  }
+  if (a < 0x38800000) {
+    /// below 2^-14 the half is subnormal, its mantissa counts 2^-24
+    float af;
+    std::memcpy(&af, &a, sizeof(af));
+    return sign | (uint16_t)lrintf(af * 16777216.0f);
+  }
+
+  uint32_t r = a - 0x38000000;
+  r += 0xfff + ((r >> 13) & 1);
+  return sign | (uint16_t)(r >> 13);
+}
+
+float floatFromHalf(uint16_t h) {
+  uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  uint32_t e = (h >> 10) & 0x1f;
+  uint32_t m = h & 0x3ff;
+
+  if (e == 0) {
+    float f = m * (1.0f / 16777216.0f);
+    return sign ? -f : f;
+  }
+
+  uint32_t x = sign | (e == 31 ? 0x7f800000 | (m << 13) : ((e + 112) << 23) | (m << 13));
+  float f;
+  std::memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+void encodeScalar(const float *src, uint16_t *dst, int n, float f) {
+  for (int i = 0; i < n; i++) {
+    dst[i] = halfFromFloat(src[i] * f);
+  }
+}
+
+void decodeScalar(const uint16_t *src, float *dst, int n, float f) {
+  for (int i = 0; i < n; i++) {
+    dst[i] = floatFromHalf(src[i]) * f;
+  }
+}
+
+#ifdef BOUNDARY_X86_SIMD
+
+#pragma GCC push_options
+#pragma GCC target ("avx,f16c")
+
+void encodeF16c(const float *src, uint16_t *dst, int n, float f) {
+  __m256 vf = _mm256_set1_ps(f);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i h = _mm256_cvtps_ph(_mm256_mul_ps(_mm256_loadu_ps(src + i), vf), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), h);
+  }
+  encodeScalar(src + i, dst + i, n - i, f);
+}
+
+void decodeF16c(const uint16_t *src, float *dst, int n, float f) {
+  __m256 vf = _mm256_set1_ps(f);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtph_ps(h), vf));
+  }
+  decodeScalar(src + i, dst + i, n - i, f);
+}
+
+#pragma GCC pop_options
+
+#endif /* BOUNDARY_X86_SIMD */
+
+typedef void (*Encode)(const float *src, uint16_t *dst, int n, float f);
+typedef void (*Decode)(const uint16_t *src, float *dst, int n, float f);
+
+#ifdef BOUNDARY_X86_SIMD
+
+/**
+ * f16c where the cpu has it, set BOUNDARY_ISA=scalar in the environment to
+ * force the portable loops. both round the same way
+ */
+bool detectF16c() {
+  const char *env = getenv("BOUNDARY_ISA");
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c") &&
+      !(env != NULL && std::strcmp(env, "scalar") == 0);
+}
+
+bool useF16c() {
+  static const bool f16c = detectF16c();
+  return f16c;
+}
+
+#endif /* BOUNDARY_X86_SIMD */
+
+Encode encoder() {
+#ifdef BOUNDARY_X86_SIMD
+  if (useF16c()) {
+    return encodeF16c;
+  }
+#endif
+  return encodeScalar;
+}
+
+Decode decoder() {
+#ifdef BOUNDARY_X86_SIMD
+  if (useF16c()) {
+    return decodeF16c;
+  }
+#endif
+  return decodeScalar;
+}
+
+} /* namespace */
+
+BoundaryStore::Config::Config() :
+  format(BS_FLOAT), async(true)
+{
+}
+
+BoundaryStore::Format BoundaryStore::formatFromName(const std::string &name) {
+  if (name == "float") {
+    return BS_FLOAT;
+  }
+  if (name == "half") {
+    return BS_HALF;
+  }
+  ERROR() << format("unknown boundary format %s, use float or half") % name;
+  exit(1);
+}
+
+BoundaryStore::BoundaryStore(const Config &config, const ForwardModeling &fm, int nt) :
+  nt(nt), nzpad(fm.getnz()), storeFormat(config.format), async(config.async && config.format == BS_HALF),
+  head(0), tail(0), quit(false)
+{
+  int w = fm.getFDLEN();
+  xl = fm.getbx0();
+  xr = fm.getnx() - fm.getbxn();
+  x0 = xl - w;
+  x1 = xr + w;
+  zt = fm.getbz0();
+  zb = nzpad - fm.getbzn();
+  /// with a free surface the rows above the inner grid are not stepped
+  z0 = zt > w ? zt - w : zt;
+  z1 = zb + w;
+
+  offset[0] = 0;
+  offset[1] = offset[0] + (xl - x0) * (z1 - z0);
+  offset[2] = offset[1] + (x1 - xr) * (z1 - z0);
+  offset[3] = offset[2] + (xr - xl) * (zt - z0);
+  offset[4] = offset[3] + (xr - xl) * (z1 - zb);
+  size = offset[NSTRIP];
+
+  if (storeFormat == BS_HALF) {
+    half.resize((size_t)nt * size);
+    scales.resize((size_t)nt * NSTRIP);
+  } else {
+    data.resize((size_t)nt * size);
+  }
+  buf.resize(size);
+
+  for (int i = 0; i < NSLOT; i++) {
+    slotStep[i] = -1;
+  }
+  if (async) {
+    for (int i = 0; i < NSLOT; i++) {
+      slots[i].resize(size);
+    }
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&cond, NULL);
+    if (pthread_create(&thread, NULL, worker, this) != 0) {
+      ERROR() << "cannot start the boundary encoding thread";
+      exit(1);
+    }
+  }
+}
+
+BoundaryStore::~BoundaryStore() {
+  if (async) {
+    pthread_mutex_lock(&mutex);
+    quit = true;
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(thread, NULL);
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&mutex);
+  }
+}
+
+/**
+ * a column of a side strip is contiguous in p, so is a column of the top and
+ * of the bottom strip
+ */
+void BoundaryStore::gather(const float *p, float *b) const {
+  int h = z1 - z0;
+  for (int ix = x0; ix < xl; ix++) {
+    std::memcpy(b + offset[0] + (ix - x0) * h, p + (size_t)ix * nzpad + z0, h * sizeof(float));
+  }
+  for (int ix = xr; ix < x1; ix++) {
+    std::memcpy(b + offset[1] + (ix - xr) * h, p + (size_t)ix * nzpad + z0, h * sizeof(float));
+  }
+
+  int ht = zt - z0;
+  int hb = z1 - zb;
+  for (int ix = xl; ix < xr; ix++) {
+    const float *col = p + (size_t)ix * nzpad;
+    std::copy(col + z0, col + zt, b + offset[2] + (ix - xl) * ht);
+    std::copy(col + zb, col + z1, b + offset[3] + (ix - xl) * hb);
+  }
+}
+
+void BoundaryStore::scatter(const float *b, float *p) const {
+  int h = z1 - z0;
+  for (int ix = x0; ix < xl; ix++) {
+    std::memcpy(p + (size_t)ix * nzpad + z0, b + offset[0] + (ix - x0) * h, h * sizeof(float));
+  }
+  for (int ix = xr; ix < x1; ix++) {
+    std::memcpy(p + (size_t)ix * nzpad + z0, b + offset[1] + (ix - xr) * h, h * sizeof(float));
+  }
+
+  int ht = zt - z0;
+  int hb = z1 - zb;
+  for (int ix = xl; ix < xr; ix++) {
+    float *col = p + (size_t)ix * nzpad;
+    std::copy(b + offset[2] + (ix - xl) * ht, b + offset[2] + (ix - xl + 1) * ht, col + z0);
+    std::copy(b + offset[3] + (ix - xl) * hb, b + offset[3] + (ix - xl + 1) * hb, col + zb);
+  }
+}
+
+void BoundaryStore::encode(int it, const float *b) {
+  Encode enc = encoder();
+  uint16_t *dst = &half[(size_t)it * size];
+  float *scale = &scales[(size_t)it * NSTRIP];
+
+  for (int s = 0; s < NSTRIP; s++) {
+    float m = 0;
+    for (int i = offset[s]; i < offset[s + 1]; i++) {
+      m = std::max(m, std::fabs(b[i]));
+    }
+    scale[s] = m / HALF_RANGE;
+    enc(b + offset[s], dst + offset[s], offset[s + 1] - offset[s], m > 0 ? HALF_RANGE / m : 0);
+  }
+}
+
+void *BoundaryStore::worker(void *arg) {
+  BoundaryStore *self = static_cast<BoundaryStore *>(arg);
+
+  pthread_mutex_lock(&self->mutex);
+  for (;;) {
+    while (self->slotStep[self->tail] < 0 && !self->quit) {
+      pthread_cond_wait(&self->cond, &self->mutex);
+    }
+    if (self->slotStep[self->tail] < 0) {
+      break;
+    }
+
+    int slot = self->tail;
+    pthread_mutex_unlock(&self->mutex);
+    self->encode(self->slotStep[slot], &self->slots[slot][0]);
+    pthread_mutex_lock(&self->mutex);
+
+    self->slotStep[slot] = -1;
+    self->tail = (slot + 1) % NSLOT;
+    pthread_cond_broadcast(&self->cond);
+  }
+  pthread_mutex_unlock(&self->mutex);
+
+  return NULL;
+}
+
+void BoundaryStore::put(int it, const float *p) {
+  if (storeFormat == BS_FLOAT) {
+    gather(p, &data[(size_t)it * size]);
+    return;
+  }
+
+  if (!async) {
+    gather(p, &buf[0]);
+    encode(it, &buf[0]);
+    return;
+  }
+
+  /// the slot is only touched by this thread while it is free
+  pthread_mutex_lock(&mutex);
+  while (slotStep[head] >= 0) {
+    pthread_cond_wait(&cond, &mutex);
+  }
+  pthread_mutex_unlock(&mutex);
+
+  gather(p, &slots[head][0]);
+
+  pthread_mutex_lock(&mutex);
+  slotStep[head] = it;
+  head = (head + 1) % NSLOT;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&mutex);
+}
+
+void BoundaryStore::drain() {
+  pthread_mutex_lock(&mutex);
+  while (slotStep[tail] >= 0) {
+    pthread_cond_wait(&cond, &mutex);
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+void BoundaryStore::get(int it, float *p) {
+  if (storeFormat == BS_FLOAT) {
+    scatter(&data[(size_t)it * size], p);
+    return;
+  }
+
+  if (async) {
+    drain();
+  }
+
+  Decode dec = decoder();
+  const uint16_t *src = &half[(size_t)it * size];
+  const float *scale = &scales[(size_t)it * NSTRIP];
+  for (int s = 0; s < NSTRIP; s++) {
+    dec(src + offset[s], &buf[offset[s]], offset[s + 1] - offset[s], scale[s]);
+  }
+  scatter(&buf[0], p);
+}
+
+size_t BoundaryStore::footprint() const {
+  return data.size() * sizeof(float) + half.size() * sizeof(uint16_t) + scales.size() * sizeof(float);
+}
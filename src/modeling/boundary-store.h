@@ -0,0 +1,98 @@
+/*
+ * boundary-store.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: rice
+ */
+
+#ifndef SRC_MODELING_BOUNDARY_STORE_H_
+#define SRC_MODELING_BOUNDARY_STORE_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <pthread.h>
+
+class ForwardModeling;
+
+/**
+ * the strips of a wavefield around the inner grid of a ForwardModeling over
+ * nt steps, what the backward steps of the gradient need to rebuild the
+ * source wavefield. the strips are FDLEN cells wide: the left and right ones
+ * span the whole height of the ring, the bottom one and, without a free
+ * surface, the top one the columns between them.
+ *
+ * the strips of a step are kept as
+ *   BS_FLOAT  plain floats
+ *   BS_HALF   ieee half floats, every strip scaled by its own max|v| so that
+ *             the relative error is 2^-11 of the largest value of the strip.
+ *             with async the strips are converted on a background thread
+ *             while the caller goes on with the next step
+ */
+class BoundaryStore {
+public:
+  enum Format { BS_FLOAT, BS_HALF };
+
+  struct Config {
+    Config();
+    Format format;
+    bool async;       /// convert the BS_HALF strips on a background thread
+  };
+
+  /// "float" or "half", exits on anything else
+  static Format formatFromName(const std::string &name);
+
+public:
+  BoundaryStore(const Config &config, const ForwardModeling &fm, int nt);
+  ~BoundaryStore();
+
+  /// the strips of p at step it
+  void put(int it, const float *p);
+  /// writes the strips of step it back to p, the steps put are all finished first
+  void get(int it, float *p);
+
+  /// bytes held by the strips of the nt steps
+  size_t footprint() const;
+
+private:
+  BoundaryStore(const BoundaryStore &);
+  void operator=(const BoundaryStore &);
+
+  void gather(const float *p, float *buf) const;
+  void scatter(const float *buf, float *p) const;
+  void encode(int it, const float *buf);
+  void drain();
+  static void *worker(void *arg);
+
+private:
+  static const int NSTRIP = 4;    /// left, right, top, bottom
+  static const int NSLOT = 2;     /// steps waiting for the background thread
+
+  int nt;
+  int nzpad;
+  int x0, x1;                     /// columns of the ring [x0, x1)
+  int xl, xr;                     /// inner columns [xl, xr)
+  int z0, z1;                     /// rows of the ring [z0, z1)
+  int zt, zb;                     /// top strip [z0, zt), bottom strip [zb, z1)
+  int size;                       /// floats of the strips of a step
+  int offset[NSTRIP + 1];         /// strip s is [offset[s], offset[s + 1]) of a step
+
+  Format storeFormat;
+  bool async;
+  std::vector<float> data;        /// BS_FLOAT
+  std::vector<uint16_t> half;     /// BS_HALF, with the scale of every strip in scales
+  std::vector<float> scales;
+  std::vector<float> buf;         /// gathered strips
+
+  /// the background thread encodes the slots in the order they are put
+  std::vector<float> slots[NSLOT];
+  int slotStep[NSLOT];            /// step held by the slot, -1 when it is free
+  int head;                       /// next slot to fill
+  int tail;                       /// next slot to encode
+  bool quit;
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+};
+
+#endif /* SRC_MODELING_BOUNDARY_STORE_H_ */
@@ -7,33 +7,37 @@ CPML::CPML() {
 	count = 0;
 }
 
-void CPML::GetXBoundaryMPos(int xPos, int zPos, int *xMPos, int *zMPos, const int nx, const int nz, const ForwardModeling &fm) const 
+/**
+ * geometry of a step, the x strips are the columns [d, bx0) and [nx - bxn, nx - d),
+ * the z strips the rows [d, bz0) and [nz - bzn, nz - d), a corner belongs to both
+ */
+struct CPML::Strips {
+	int nx, nz;
+	int d;
+	int bx0, bxn, bz0, bzn;
+	int nb;
+	float dx, dt;
+	float blengthx, blengthz;
+};
+
+void CPML::GetXBoundaryMPos(int xPos, int zPos, int *xMPos, int *zMPos, const Strips &g) const
 {
-	int d = fm.getFDLEN();
-	int bx0 = fm.getbx0();
-	int bxn = fm.getbxn();
-	int nb = bx0 - d;
-	int cnx = nx - bx0 - bxn;
-	if(xPos - d < nb)
-		*xMPos = xPos - d;
+	int cnx = g.nx - g.bx0 - g.bxn;
+	if(xPos - g.d < g.nb)
+		*xMPos = xPos - g.d;
 	else
-		*xMPos = xPos - d - cnx;
-	*zMPos = zPos - d;
+		*xMPos = xPos - g.d - cnx;
+	*zMPos = zPos - g.d;
 }
 
-void CPML::GetZBoundaryMPos(int xPos, int zPos, int *xMPos, int *zMPos, const int nx, const int nz, const ForwardModeling &fm) const
+void CPML::GetZBoundaryMPos(int xPos, int zPos, int *xMPos, int *zMPos, const Strips &g) const
 {
-	int d = fm.getFDLEN();
-	int bx0 = fm.getbx0();
-	int bz0 = fm.getbz0();
-	int bzn = fm.getbzn();
-	int nb = bx0 - d;
-	int cnz = nz - bz0 - bzn;
-	*xMPos = xPos - d;
-	if(zPos - d < nb)
-		*zMPos = zPos - d;
+	int cnz = g.nz - g.bz0 - g.bzn;
+	*xMPos = xPos - g.d;
+	if(zPos - g.d < g.nb)
+		*zMPos = zPos - g.d;
 	else
-		*zMPos = zPos - d - cnz;
+		*zMPos = zPos - g.d - cnz;
 }
 
 void CPML::initCPML(const int nx, const int nz, const ForwardModeling &fm) {
@@ -89,15 +93,11 @@ void CPML::initCPML(const int nx, const int nz, const ForwardModeling &fm) {
 	phi2ZLa.assign(2 * nb * (nx - d * 2),0);
 	u002BZLa.assign(2 * nb * (nx - d * 2),0);
 
-	ux.resize(nx * nz);
-	uxLa.resize(nx * nz);
-	uz.resize(nx * nz);
-	uzLa.resize(nx * nz);
-
-	ux.assign(nx * nz,0);
-	uxLa.assign(nx * nz,0);
-	uz.assign(nx * nz,0);
-	uzLa.assign(nx * nz,0);
+	/// the first derivatives are only kept where the absorbing terms use them
+	ux.assign(2 * nb * (nz - d * 2),0);
+	uxLa.assign(2 * nb * (nz - d * 2),0);
+	uz.assign(2 * nb * (nx - d * 2),0);
+	uzLa.assign(2 * nb * (nx - d * 2),0);
 
 	psixlen = nz - d * 2;
 	psizlen = 2 * nb;
@@ -109,7 +109,6 @@ void CPML::initCPML(const int nx, const int nz, const ForwardModeling &fm) {
 void CPML::applyCPML(float *uLa, float *u, float *uNe, const float *vel, const int nx, const int nz, const ForwardModeling &fm) {
 	if(count == 0) {
 		initCPML(nx, nz, fm);
-		INFO() << "Warning: the same CPML variables can not be used in two different forward modeling at the same time!!!";
 		if(!init) {
 			INFO() << "CPML no initialization!!";
 			exit(1);
@@ -119,137 +118,177 @@ void CPML::applyCPML(float *uLa, float *u, float *uNe, const float *vel, const i
 		}
 	}
 	count = (count + 1) % fm.getnt();
-	int d = fm.getFDLEN();
-	int bx0 = fm.getbx0();
-	int bxn = fm.getbxn();
-	int bz0 = fm.getbz0();
-	int bzn = fm.getbzn();
-	float dx = fm.getdx();
-	float dt = fm.getdt();
-	int nBMPosX, nBMPosZ;
-	float lB, dDlB, dD2lB, alphaDlB, alphaD2lB;
-	float DlB0; //Larger ValuedxB leads to stronger attenation
-	float alphaDlB0; //Larger ValueAlphaxB leads to faster phase variation
-	int cnx = nx - bx0 - bxn;
-	int cnz = nz - bz0 - bzn;
-	float blengthx = cnx * dx;
-	float blengthz = cnz * dx;
-	float u020 = 0.0f, u002 = 0.0f, aB, bB;
+
+	Strips g;
+	g.nx = nx;
+	g.nz = nz;
+	g.d = fm.getFDLEN();
+	g.bx0 = fm.getbx0();
+	g.bxn = fm.getbxn();
+	g.bz0 = fm.getbz0();
+	g.bzn = fm.getbzn();
+	g.nb = g.bx0 - g.d;
+	g.dx = fm.getdx();
+	g.dt = fm.getdt();
+	g.blengthx = (nx - g.bx0 - g.bxn) * g.dx;
+	g.blengthz = (nz - g.bz0 - g.bzn) * g.dx;
+
+	/// column jx of the x strips, the left strip first
+	int nxs = 2 * g.nb;
+	int cnx = nx - g.bx0 - g.bxn;
+
+	/// x strips without the corners
+#ifdef USE_OPENMP
+	#pragma omp parallel for
+#endif
+	for(int jx = 0 ; jx < nxs ; jx ++) {
+		int ix = jx < g.nb ? jx + g.d : jx + g.d + cnx;
+		for(int iz = g.bz0 ; iz < nz - g.bzn ; iz ++) {
+			stepPoint(ix, iz, true, false, g, uLa, u, uNe, vel);
+		}
+	}
+
+	/// z strips without the corners
+#ifdef USE_OPENMP
+	#pragma omp parallel for
+#endif
+	for(int ix = g.bx0 ; ix < nx - g.bxn ; ix ++) {
+		for(int iz = g.d ; iz < g.bz0 ; iz ++) {
+			stepPoint(ix, iz, false, true, g, uLa, u, uNe, vel);
+		}
+		for(int iz = nz - g.bzn ; iz < nz - g.d ; iz ++) {
+			stepPoint(ix, iz, false, true, g, uLa, u, uNe, vel);
+		}
+	}
+
+	/// the corners, in both strips
 #ifdef USE_OPENMP
-	#pragma omp parallel for private(nBMPosX, nBMPosZ, lB, dDlB, dD2lB, alphaDlB, alphaD2lB, DlB0, alphaDlB0, u020, u002, aB, bB)
+	#pragma omp parallel for
 #endif
-	for(int ix = d ; ix < nx - d ; ix ++) { 
-		for(int iz = d ; iz < nz - d ; iz ++) {
-			ux[ix * nz + iz] = (2. / 3. * (u[(ix + 1) * nz + iz] - u[(ix - 1) * nz + iz]) - 1. / 12. * (u[(ix + 2) * nz + iz] - u[(ix - 2) * nz + iz])) / dx;
-			uz[ix * nz + iz] = (2. / 3. * (u[ix * nz + iz + 1] - u[ix * nz + iz - 1]) - 1. / 12. * (u[ix * nz + iz + 2] - u[ix * nz + iz - 2])) / dx;
-
-			if (ix < bx0 || ix >= nx - bxn || iz < bz0 || iz >= nz - bzn)
-			{
-				u020 = 1.0 / 12.0 * (-30 * u[ix * nz + iz] + 16 *(u[(ix - 1) * nz + iz]+u[(ix + 1) * nz + iz]) - (u[(ix - 2) * nz + iz]+u[(ix + 2) * nz + iz])) / dx / dx;	
-				u002 = 1.0 / 12.0 * (-30 * u[ix * nz + iz] + 16 *(u[ix * nz + iz - 1]+u[ix * nz + iz + 1]) - (u[ix * nz + iz - 2]+u[ix * nz + iz + 2])) / dx / dx;
-
-				//X boundaries
-				if(ix < bx0 || ix >= nx - bxn)
-				{
-					DlB0 = 80000; //Larger ValuedxB leads to stronger attenation
-					alphaDlB0 = 0; //Larger ValueAlphaxB leads to faster phase variation
-					//Generate boundary coordinates
-					GetXBoundaryMPos(ix, iz, &nBMPosX, &nBMPosZ, nx, nz, fm);
-					//Compute the convolutions
-					if(ix < bx0)
-						lB = (ix - bx0) * dx;
-					else
-						lB = (ix - (nx - bxn - 1)) * dx;
-					dDlB = DlB0 * (lB / blengthx) * (lB / blengthx);
-					dD2lB = DlB0 * 2 * lB / (blengthx * blengthx);
-					//alphaDlB = alphaDlB0 * fabs(lB) / blengthx;
-					//alphaD2lB = SIGN(alphaDlB0 / blengthx, lB);
-					alphaDlB = alphaDlB0 * (1 - fabs(lB) / blengthx);
-					alphaD2lB = -SIGN(alphaDlB0 / blengthx, lB);
-					
-					bB = exp(-(dDlB + alphaDlB) * dt);
-					aB = (1 - bB) / (dDlB + alphaDlB);
-					psi2X[nBMPosX * psixlen + nBMPosZ] = bB * psi2XLa[nBMPosX * psixlen + nBMPosZ] \
-						+ aB * 0.5 * (u020 + u020BXLa[nBMPosX * psixlen + nBMPosZ]);
-					phi2X[nBMPosX * psixlen + nBMPosZ] = bB * phi2XLa[nBMPosX * psixlen + nBMPosZ] \
-						+ aB * 0.5 * (psi2X[nBMPosX * psixlen + nBMPosZ] + psi2XLa[nBMPosX * psixlen + nBMPosZ]);
-					psiX[nBMPosX * psixlen + nBMPosZ] = bB * psiXLa[nBMPosX * psixlen + nBMPosZ] \
-						+ aB * 0.5 * (ux[ix * nz + iz] + uxLa[ix * nz + iz]);
-					phiX[nBMPosX * psixlen + nBMPosZ] = bB * phiXLa[nBMPosX * psixlen + nBMPosZ] \
-						+ aB * 0.5 * (psiX[nBMPosX * psixlen + nBMPosZ] + psiXLa[nBMPosX * psixlen + nBMPosZ]);
-					EtaX[nBMPosX * psixlen + nBMPosZ] = bB * EtaXLa[nBMPosX * psixlen + nBMPosZ] \
-						+ aB * 0.5 * (phiX[nBMPosX * psixlen + nBMPosZ] + phiXLa[nBMPosX * psixlen + nBMPosZ]);
-
-					//Update the former status
-					u020BXLa[nBMPosX * psixlen + nBMPosZ] = u020;
-					psi2XLa[nBMPosX * psixlen + nBMPosZ] = psi2X[nBMPosX * psixlen + nBMPosZ];
-					phi2XLa[nBMPosX * psixlen + nBMPosZ] = phi2X[nBMPosX * psixlen + nBMPosZ];
-					psiXLa[nBMPosX * psixlen + nBMPosZ] = psiX[nBMPosX * psixlen + nBMPosZ];
-					phiXLa[nBMPosX * psixlen + nBMPosZ] = phiX[nBMPosX * psixlen + nBMPosZ];
-					EtaXLa[nBMPosX * psixlen + nBMPosZ] = EtaX[nBMPosX * psixlen + nBMPosZ];
-
-					u020 = u020\
-								 - 2 * dDlB * psi2X[nBMPosX * psixlen + nBMPosZ] + (dDlB * dDlB) * phi2X[nBMPosX * psixlen + nBMPosZ]\
-								 - dD2lB * psiX[nBMPosX * psixlen + nBMPosZ]\
-								 + dDlB * (2 * dD2lB + alphaD2lB) * phiX[nBMPosX * psixlen + nBMPosZ]\
-								 - (dDlB * dDlB) * (dD2lB+alphaD2lB) * EtaX[nBMPosX * psixlen + nBMPosZ];
-				}
-
-				//Z boundaries
-				if(iz < bz0 || iz >= nz - bzn)
-				{
-					if(iz < bz0) {
-						DlB0 = 2000; //Larger ValuedxB leads to stronger attenation
-						alphaDlB0 = 0; //Larger ValueAlphaxB leads to faster phase variation
-					}
-					else {
-						DlB0 = 4000;
-						alphaDlB0 = 0; //Larger ValueAlphaxB leads to faster phase variation
-					}
-					//Generate boundary coordinates
-					GetZBoundaryMPos(ix, iz, &nBMPosX, &nBMPosZ, nx , nz, fm);
-					//Compute the convolutions
-					if(iz < bz0)
-						lB = (iz - bz0) * dx;
-					else
-						lB = (iz - (nz - bzn - 1)) * dx;
-					dDlB = DlB0 * (lB / blengthz) * (lB / blengthz);
-					dD2lB = DlB0 * 2 * lB / (blengthz * blengthz);
-					alphaDlB = alphaDlB0 * fabs(lB) / blengthz;
-					alphaD2lB = SIGN(alphaDlB0 / blengthz, lB);
-					
-					bB = exp(-(dDlB + alphaDlB) * dt);
-					aB = (1 - bB) / (dDlB + alphaDlB);
-					psi2Z[nBMPosX * psizlen + nBMPosZ] = bB * psi2ZLa[nBMPosX * psizlen + nBMPosZ] \
-						+ aB * 0.5 * (u002 + u002BZLa[nBMPosX * psizlen + nBMPosZ]);
-					phi2Z[nBMPosX * psizlen + nBMPosZ] = bB * phi2ZLa[nBMPosX * psizlen + nBMPosZ] \
-						+ aB * 0.5 * (psi2Z[nBMPosX * psizlen + nBMPosZ] + psi2ZLa[nBMPosX * psizlen + nBMPosZ]);
-					psiZ[nBMPosX * psizlen + nBMPosZ] = bB * psiZLa[nBMPosX * psizlen + nBMPosZ] \
-						+ aB * 0.5 * (uz[ix * nz + iz] + uzLa[ix * nz + iz]);
-					phiZ[nBMPosX * psizlen + nBMPosZ] = bB * phiZLa[nBMPosX * psizlen + nBMPosZ] \
-						+ aB * 0.5 * (psiZ[nBMPosX * psizlen + nBMPosZ] + psiZLa[nBMPosX * psizlen + nBMPosZ]);
-					EtaZ[nBMPosX * psizlen + nBMPosZ] = bB * EtaZLa[nBMPosX * psizlen + nBMPosZ] \
-						+ aB * 0.5 * (phiZ[nBMPosX * psizlen + nBMPosZ] + phiZLa[nBMPosX * psizlen + nBMPosZ]);
-
-					//Update the former status
-					u002BZLa[nBMPosX * psizlen + nBMPosZ] = u002;
-					psi2ZLa[nBMPosX * psizlen + nBMPosZ] = psi2Z[nBMPosX * psizlen + nBMPosZ];
-					phi2ZLa[nBMPosX * psizlen + nBMPosZ] = phi2Z[nBMPosX * psizlen + nBMPosZ];
-					psiZLa[nBMPosX * psizlen + nBMPosZ] = psiZ[nBMPosX * psizlen + nBMPosZ];
-					phiZLa[nBMPosX * psizlen + nBMPosZ] = phiZ[nBMPosX * psizlen + nBMPosZ];
-					EtaZLa[nBMPosX * psizlen + nBMPosZ] = EtaZ[nBMPosX * psizlen + nBMPosZ];
-					//Update u002
-					u002 = u002 \
-						- 2 * dDlB * psi2Z[nBMPosX * psizlen + nBMPosZ] + (dDlB * dDlB) * phi2Z[nBMPosX * psizlen + nBMPosZ] \
-						- dD2lB * psiZ[nBMPosX * psizlen + nBMPosZ] \
-						+ dDlB * (2 * dD2lB + alphaD2lB) * phiZ[nBMPosX * psizlen + nBMPosZ] \
-						- (dDlB * dDlB) * (dD2lB + alphaD2lB) * EtaZ[nBMPosX * psizlen + nBMPosZ];
-				}
-				uNe[ix * nz + iz] = 2 * u[ix * nz + iz] - uLa[ix * nz + iz] + (1.0f / vel[ix * nz + iz]) * (u002 + u020) * dx * dx;
-			}
+	for(int jx = 0 ; jx < nxs ; jx ++) {
+		int ix = jx < g.nb ? jx + g.d : jx + g.d + cnx;
+		for(int iz = g.d ; iz < g.bz0 ; iz ++) {
+			stepPoint(ix, iz, true, true, g, uLa, u, uNe, vel);
+		}
+		for(int iz = nz - g.bzn ; iz < nz - g.d ; iz ++) {
+			stepPoint(ix, iz, true, true, g, uLa, u, uNe, vel);
 		}
 	}
+
 	std::swap(ux, uxLa);
 	std::swap(uz, uzLa);
 }
 
+/**
+ * the next value of a point of the strips, xStrip and zStrip tell which
+ * absorbing terms apply to it
+ */
+void CPML::stepPoint(int ix, int iz, bool xStrip, bool zStrip, const Strips &g,
+		const float *uLa, const float *u, float *uNe, const float *vel) {
+	int nz = g.nz;
+	float dx = g.dx;
+	float dt = g.dt;
+	float blengthx = g.blengthx;
+	float blengthz = g.blengthz;
+	int nBMPosX, nBMPosZ;
+	float lB, dDlB, dD2lB, alphaDlB, alphaD2lB;
+	float DlB0; //Larger ValuedxB leads to stronger attenation
+	float alphaDlB0; //Larger ValueAlphaxB leads to faster phase variation
+	float u020, u002, aB, bB;
+
+	u020 = 1.0 / 12.0 * (-30 * u[ix * nz + iz] + 16 *(u[(ix - 1) * nz + iz]+u[(ix + 1) * nz + iz]) - (u[(ix - 2) * nz + iz]+u[(ix + 2) * nz + iz])) / dx / dx;
+	u002 = 1.0 / 12.0 * (-30 * u[ix * nz + iz] + 16 *(u[ix * nz + iz - 1]+u[ix * nz + iz + 1]) - (u[ix * nz + iz - 2]+u[ix * nz + iz + 2])) / dx / dx;
+
+	//X boundaries
+	if(xStrip)
+	{
+		DlB0 = 80000; //Larger ValuedxB leads to stronger attenation
+		alphaDlB0 = 0; //Larger ValueAlphaxB leads to faster phase variation
+		//Generate boundary coordinates
+		GetXBoundaryMPos(ix, iz, &nBMPosX, &nBMPosZ, g);
+		int k = nBMPosX * psixlen + nBMPosZ;
+		ux[k] = (2. / 3. * (u[(ix + 1) * nz + iz] - u[(ix - 1) * nz + iz]) - 1. / 12. * (u[(ix + 2) * nz + iz] - u[(ix - 2) * nz + iz])) / dx;
+		//Compute the convolutions
+		if(ix < g.bx0)
+			lB = (ix - g.bx0) * dx;
+		else
+			lB = (ix - (g.nx - g.bxn - 1)) * dx;
+		dDlB = DlB0 * (lB / blengthx) * (lB / blengthx);
+		dD2lB = DlB0 * 2 * lB / (blengthx * blengthx);
+		//alphaDlB = alphaDlB0 * fabs(lB) / blengthx;
+		//alphaD2lB = SIGN(alphaDlB0 / blengthx, lB);
+		alphaDlB = alphaDlB0 * (1 - fabs(lB) / blengthx);
+		alphaD2lB = -SIGN(alphaDlB0 / blengthx, lB);
+
+		bB = exp(-(dDlB + alphaDlB) * dt);
+		aB = (1 - bB) / (dDlB + alphaDlB);
+		psi2X[k] = bB * psi2XLa[k] + aB * 0.5 * (u020 + u020BXLa[k]);
+		phi2X[k] = bB * phi2XLa[k] + aB * 0.5 * (psi2X[k] + psi2XLa[k]);
+		psiX[k] = bB * psiXLa[k] + aB * 0.5 * (ux[k] + uxLa[k]);
+		phiX[k] = bB * phiXLa[k] + aB * 0.5 * (psiX[k] + psiXLa[k]);
+		EtaX[k] = bB * EtaXLa[k] + aB * 0.5 * (phiX[k] + phiXLa[k]);
+
+		//Update the former status
+		u020BXLa[k] = u020;
+		psi2XLa[k] = psi2X[k];
+		phi2XLa[k] = phi2X[k];
+		psiXLa[k] = psiX[k];
+		phiXLa[k] = phiX[k];
+		EtaXLa[k] = EtaX[k];
+
+		u020 = u020\
+					 - 2 * dDlB * psi2X[k] + (dDlB * dDlB) * phi2X[k]\
+					 - dD2lB * psiX[k]\
+					 + dDlB * (2 * dD2lB + alphaD2lB) * phiX[k]\
+					 - (dDlB * dDlB) * (dD2lB+alphaD2lB) * EtaX[k];
+	}
+
+	//Z boundaries
+	if(zStrip)
+	{
+		if(iz < g.bz0) {
+			DlB0 = 2000; //Larger ValuedxB leads to stronger attenation
+			alphaDlB0 = 0; //Larger ValueAlphaxB leads to faster phase variation
+		}
+		else {
+			DlB0 = 4000;
+			alphaDlB0 = 0; //Larger ValueAlphaxB leads to faster phase variation
+		}
+		//Generate boundary coordinates
+		GetZBoundaryMPos(ix, iz, &nBMPosX, &nBMPosZ, g);
+		int k = nBMPosX * psizlen + nBMPosZ;
+		uz[k] = (2. / 3. * (u[ix * nz + iz + 1] - u[ix * nz + iz - 1]) - 1. / 12. * (u[ix * nz + iz + 2] - u[ix * nz + iz - 2])) / dx;
+		//Compute the convolutions
+		if(iz < g.bz0)
+			lB = (iz - g.bz0) * dx;
+		else
+			lB = (iz - (nz - g.bzn - 1)) * dx;
+		dDlB = DlB0 * (lB / blengthz) * (lB / blengthz);
+		dD2lB = DlB0 * 2 * lB / (blengthz * blengthz);
+		alphaDlB = alphaDlB0 * fabs(lB) / blengthz;
+		alphaD2lB = SIGN(alphaDlB0 / blengthz, lB);
+
+		bB = exp(-(dDlB + alphaDlB) * dt);
+		aB = (1 - bB) / (dDlB + alphaDlB);
+		psi2Z[k] = bB * psi2ZLa[k] + aB * 0.5 * (u002 + u002BZLa[k]);
+		phi2Z[k] = bB * phi2ZLa[k] + aB * 0.5 * (psi2Z[k] + psi2ZLa[k]);
+		psiZ[k] = bB * psiZLa[k] + aB * 0.5 * (uz[k] + uzLa[k]);
+		phiZ[k] = bB * phiZLa[k] + aB * 0.5 * (psiZ[k] + psiZLa[k]);
+		EtaZ[k] = bB * EtaZLa[k] + aB * 0.5 * (phiZ[k] + phiZLa[k]);
+
+		//Update the former status
+		u002BZLa[k] = u002;
+		psi2ZLa[k] = psi2Z[k];
+		phi2ZLa[k] = phi2Z[k];
+		psiZLa[k] = psiZ[k];
+		phiZLa[k] = phiZ[k];
+		EtaZLa[k] = EtaZ[k];
+		//Update u002
+		u002 = u002 \
+			- 2 * dDlB * psi2Z[k] + (dDlB * dDlB) * phi2Z[k] \
+			- dD2lB * psiZ[k] \
+			+ dDlB * (2 * dD2lB + alphaD2lB) * phiZ[k] \
+			- (dDlB * dDlB) * (dD2lB + alphaD2lB) * EtaZ[k];
+	}
+	uNe[ix * nz + iz] = 2 * u[ix * nz + iz] - uLa[ix * nz + iz] + (1.0f / vel[ix * nz + iz]) * (u002 + u020) * dx * dx;
+}
@@ -9,13 +9,16 @@ class CPML {
 		void applyCPML(float *uLa, float *u, float *uNe, const float *vel, const int nx, const int nz, const ForwardModeling &fm);
 
 	private:
-		void GetXBoundaryMPos(int xPos, int zPos, int *xMPos, int *zMPos, const int nx, const int nz, const ForwardModeling &fm) const;
-		void GetZBoundaryMPos(int xPos, int zPos, int *xMPos, int *zMPos, const int nx, const int nz, const ForwardModeling &fm) const;
+		struct Strips;
+		void GetXBoundaryMPos(int xPos, int zPos, int *xMPos, int *zMPos, const Strips &g) const;
+		void GetZBoundaryMPos(int xPos, int zPos, int *xMPos, int *zMPos, const Strips &g) const;
+		void stepPoint(int ix, int iz, bool xStrip, bool zStrip, const Strips &g,
+				const float *uLa, const float *u, float *uNe, const float *vel);
 
 	private:
 		std::vector<float> psiX, psiXLa, phiX, phiXLa, EtaX, EtaXLa, psi2X, psi2XLa, phi2X, phi2XLa, u020BXLa;
 		std::vector<float> psiZ, psiZLa, phiZ, phiZLa, EtaZ, EtaZLa, psi2Z, psi2ZLa, phi2Z, phi2ZLa, u002BZLa;
-		std::vector<float> ux, uz, uxLa, uzLa;
+		std::vector<float> ux, uz, uxLa, uzLa;	/// first derivatives in the x strips and in the z strips
 		int psixlen, psizlen;
 		bool init;
 		int count;
@@ -0,0 +1,97 @@
+/*
+ * ext-imaging-kernel.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: rice
+ */
+
+/**
+ * body of the extended imaging kernels, included once per instruction set
+ * by ext-imaging.c. no include guard on purpose.
+ *
+ * the includer defines
+ *   VF, VW            vector type and its width in floats
+ *   VLOAD, VSTORE     unaligned load / store
+ *   VSET1, VADD, VMUL
+ *   FN(name)          name decorated with the instruction set
+ */
+
+/**
+ * o[iz] += w[iz] * h * h * m[iz] for iz in [z0, z1)
+ */
+static inline void FN(source_rows)(float *o, const float *w, const float *m, float h, int z0, int z1) {
+  VF vh = VSET1(h);
+  int iz = z0;
+  for (; iz + VW <= z1; iz += VW) {
+    VF t = VMUL(VMUL(VMUL(VLOAD(w + iz), vh), vh), VLOAD(m + iz));
+    VSTORE(o + iz, VADD(VLOAD(o + iz), t));
+  }
+  for (; iz < z1; iz++) {
+    o[iz] += w[iz] * h * h * m[iz];
+  }
+}
+
+/**
+ * im[iz] += s[iz] * g[iz] * scale for iz in [z0, z1)
+ */
+static inline void FN(correlate_rows)(float *im, const float *s, const float *g, float scale, int z0, int z1) {
+  VF vs = VSET1(scale);
+  int iz = z0;
+  for (; iz + VW <= z1; iz += VW) {
+    VF t = VMUL(VMUL(VLOAD(s + iz), VLOAD(g + iz)), vs);
+    VSTORE(im + iz, VADD(VLOAD(im + iz), t));
+  }
+  for (; iz < z1; iz++) {
+    im[iz] += s[iz] * g[iz] * scale;
+  }
+}
+
+static void FN(source)(float *out, const float *wave, const float *image, int shift, int H,
+    int nx, int nz, int nb) {
+  const size_t plane = (size_t)nx * nz;
+  int ix;
+
+#ifdef USE_OPENMP
+  #pragma omp parallel for schedule(static)
+#endif
+  for (ix = nb; ix < nx - nb; ix++) {
+    int hlo = -H, hhi = H;
+    int z0, h;
+    clip_offsets(ix, 2 * shift, 0, nx, &hlo, &hhi);
+    clip_offsets(ix, shift, 0, nx, &hlo, &hhi);
+
+    /// the offsets are swept over one tile of the column at a time, in the order of the plain loop
+    for (z0 = nb; z0 < nz - nb; z0 += EXT_TILE_NZ) {
+      int z1 = z0 + EXT_TILE_NZ < nz - nb ? z0 + EXT_TILE_NZ : nz - nb;
+      float *o = out + (size_t)ix * nz;
+      for (h = hlo; h <= hhi; h++) {
+        const float *w = wave + (size_t)(ix + 2 * shift * h) * nz;
+        const float *m = image + (size_t)(h + H) * plane + (size_t)(ix + shift * h) * nz;
+        FN(source_rows)(o, w, m, (float)h, z0, z1);
+      }
+    }
+  }
+}
+
+static void FN(correlate)(float *image, const float *src_wave, const float *rcv_wave, float scale, int H,
+    int nx, int nz, int nb) {
+  const size_t plane = (size_t)nx * nz;
+  int ix;
+
+#ifdef USE_OPENMP
+  #pragma omp parallel for schedule(static)
+#endif
+  for (ix = nb; ix < nx - nb; ix++) {
+    int hlo = -H, hhi = H;
+    int h;
+    clip_offsets(ix, 1, nb, nx - nb, &hlo, &hhi);
+    clip_offsets(ix, -1, nb, nx - nb, &hlo, &hhi);
+
+    for (h = hlo; h <= hhi; h++) {
+      float *im = image + (size_t)(h + H) * plane + (size_t)ix * nz;
+      const float *s = src_wave + (size_t)(ix + h) * nz;
+      const float *g = rcv_wave + (size_t)(ix - h) * nz;
+      FN(correlate_rows)(im, s, g, scale, nb, nz - nb);
+    }
+  }
+}
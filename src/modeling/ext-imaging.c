@@ -0,0 +1,168 @@
+/*
+ * ext-imaging.c
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: rice
+ */
+
+#include <stddef.h>
+#include "ext-imaging.h"
+#include "fd4t10s-simd.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EXT_IMAGING_X86_SIMD
+#endif
+
+#ifdef EXT_IMAGING_X86_SIMD
+/// keep the compiler from contracting the multiplies and adds, the results follow the plain loops
+#pragma GCC optimize ("fp-contract=off")
+#include <immintrin.h>
+#endif
+
+/// rows of a column tile, the tile of the output stays in L1 while the offsets are swept
+#define EXT_TILE_NZ 512
+
+static int floor_div(int a, int b) {
+  int q = a / b;
+  if (a % b != 0 && ((a < 0) != (b < 0))) {
+    q--;
+  }
+  return q;
+}
+
+/**
+ * narrows [*hlo, *hhi] to the offsets h with lo <= ix + m * h < hi, m != 0
+ */
+static void clip_offsets(int ix, int m, int lo, int hi, int *hlo, int *hhi) {
+  int a = lo - ix;      /// m * h >= a
+  int b = hi - 1 - ix;  /// m * h <= b
+  int l, u;
+  if (m > 0) {
+    l = -floor_div(-a, m);
+    u = floor_div(b, m);
+  } else {
+    l = -floor_div(-b, m);
+    u = floor_div(a, m);
+  }
+  *hlo = l > *hlo ? l : *hlo;
+  *hhi = u < *hhi ? u : *hhi;
+}
+
+/*********************************** scalar ***********************************/
+#define VF float
+#define VW 1
+#define VLOAD(p) (*(p))
+#define VSTORE(p, v) (*(p) = (v))
+#define VSET1(x) (x)
+#define VADD(x, y) ((x) + (y))
+#define VMUL(x, y) ((x) * (y))
+#define FN(name) name##_scalar
+
+#include "ext-imaging-kernel.h"
+
+#undef VF
+#undef VW
+#undef VLOAD
+#undef VSTORE
+#undef VSET1
+#undef VADD
+#undef VMUL
+#undef FN
+
+#ifdef EXT_IMAGING_X86_SIMD
+
+/************************************ avx2 ************************************/
+#pragma GCC push_options
+#pragma GCC target ("avx2")
+
+#define VF __m256
+#define VW 8
+#define VLOAD(p) _mm256_loadu_ps(p)
+#define VSTORE(p, v) _mm256_storeu_ps(p, v)
+#define VSET1(x) _mm256_set1_ps(x)
+#define VADD(x, y) _mm256_add_ps(x, y)
+#define VMUL(x, y) _mm256_mul_ps(x, y)
+#define FN(name) name##_avx2
+
+#include "ext-imaging-kernel.h"
+
+#undef VF
+#undef VW
+#undef VLOAD
+#undef VSTORE
+#undef VSET1
+#undef VADD
+#undef VMUL
+#undef FN
+
+#pragma GCC pop_options
+
+/*********************************** avx512 ***********************************/
+#pragma GCC push_options
+#pragma GCC target ("avx512f")
+
+#define VF __m512
+#define VW 16
+#define VLOAD(p) _mm512_loadu_ps(p)
+#define VSTORE(p, v) _mm512_storeu_ps(p, v)
+#define VSET1(x) _mm512_set1_ps(x)
+#define VADD(x, y) _mm512_add_ps(x, y)
+#define VMUL(x, y) _mm512_mul_ps(x, y)
+#define FN(name) name##_avx512
+
+#include "ext-imaging-kernel.h"
+
+#undef VF
+#undef VW
+#undef VLOAD
+#undef VSTORE
+#undef VSET1
+#undef VADD
+#undef VMUL
+#undef FN
+
+#pragma GCC pop_options
+
+#endif /* EXT_IMAGING_X86_SIMD */
+
+void ext_image_source(float *out, const float *wave, const float *image, int shift, int H,
+    int nx, int nz, int nb) {
+  if (nb >= nx - nb || nb >= nz - nb) {
+    return;
+  }
+
+  switch (fd4t10s_simd_isa()) {
+#ifdef EXT_IMAGING_X86_SIMD
+  case FD4T10S_ISA_AVX512:
+    source_avx512(out, wave, image, shift, H, nx, nz, nb);
+    break;
+  case FD4T10S_ISA_AVX2:
+    source_avx2(out, wave, image, shift, H, nx, nz, nb);
+    break;
+#endif
+  default:
+    source_scalar(out, wave, image, shift, H, nx, nz, nb);
+    break;
+  }
+}
+
+void ext_image_correlate(float *image, const float *src_wave, const float *rcv_wave, float scale, int H,
+    int nx, int nz, int nb) {
+  if (nb >= nx - nb || nb >= nz - nb) {
+    return;
+  }
+
+  switch (fd4t10s_simd_isa()) {
+#ifdef EXT_IMAGING_X86_SIMD
+  case FD4T10S_ISA_AVX512:
+    correlate_avx512(image, src_wave, rcv_wave, scale, H, nx, nz, nb);
+    break;
+  case FD4T10S_ISA_AVX2:
+    correlate_avx2(image, src_wave, rcv_wave, scale, H, nx, nz, nb);
+    break;
+#endif
+  default:
+    correlate_scalar(image, src_wave, rcv_wave, scale, H, nx, nz, nb);
+    break;
+  }
+}
@@ -0,0 +1,41 @@
+/*
+ * ext-imaging.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: rice
+ */
+
+#ifndef SRC_MODELING_EXT_IMAGING_H_
+#define SRC_MODELING_EXT_IMAGING_H_
+
+/**
+ * subsurface offset extended imaging along x. an extended image has 2H+1
+ * planes of nx*nz, plane h + H holds offset h, the wavefields are single
+ * nx*nz planes, all laid out [ix][iz].
+ *
+ * both kernels run one parallel loop over the columns. the offsets a column
+ * can reach are worked out once per column, so the loops over iz carry no
+ * bounds checks and are vectorized with the instruction set of
+ * fd4t10s_simd_isa(). the partial sums of a column tile stay in L1 while the
+ * offsets are swept. the arithmetic and the order of the additions are the
+ * ones of the plain loops, the results agree with them bit by bit.
+ */
+
+/**
+ * source term of the extended image in the points [nb, nx - nb) x [nb, nz - nb):
+ *   out[ix][iz] += sum_h wave[ix + 2 s h][iz] * h * h * image[h + H][ix + s h][iz]
+ * for h = -H .. H, s = shift is +1 or -1, the terms that fall outside of the
+ * columns [0, nx) are left out
+ */
+void ext_image_source(float *out, const float *wave, const float *image, int shift, int H,
+    int nx, int nz, int nb);
+
+/**
+ * cross correlation into the extended image in the points [nb, nx - nb) x [nb, nz - nb):
+ *   image[h + H][ix][iz] += src_wave[ix + h][iz] * rcv_wave[ix - h][iz] * scale
+ * for h = -H .. H, the terms that fall outside of the columns [nb, nx - nb) are left out
+ */
+void ext_image_correlate(float *image, const float *src_wave, const float *rcv_wave, float scale, int H,
+    int nx, int nz, int nb);
+
+#endif /* SRC_MODELING_EXT_IMAGING_H_ */
@@ -0,0 +1,72 @@
+/*
+ * fd4t10s-coef.c
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+#include "fd4t10s-coef.h"
+
+/**
+ * same profile as fd4t10s_damp_zjh_2d_vtrans, the bottom strip wins over the
+ * left/right strips which win over the top strip
+ */
+void fd4t10s_damp_coef(float *k1, float *k2, int nx, int nz, int nb, int freeSurface) {
+  const int bz = nb;
+  const int bx = nb;
+  const float max_delta = 0.05;
+  int ix, iz;
+
+#ifdef USE_OPENMP
+  #pragma omp parallel for default(shared) private(ix, iz)
+#endif
+  for (ix = 0; ix < nx; ix++) {
+    for (iz = 0; iz < nz; iz++) {
+      float dist = 0;
+      if (!freeSurface && iz < bz) {
+        dist = (float)(bz - iz) / bz;
+      }
+      if (ix < bx) {
+        dist = (float)(bx - ix) / bx;
+      }
+      if (ix >= nx - bx) {
+        dist = (float)(ix - (nx - bx) + 1) / bx;
+      }
+      if (iz >= nz - bz) {
+        dist = (float)(iz - (nz - bz) + 1) / bz;
+      }
+
+      float delta = max_delta * dist * dist;
+      k1[ix * nz + iz] = (2.0f - 2.0f * delta) + delta * delta;
+      k2[ix * nz + iz] = 1.0f - 2.0f * delta;
+    }
+  }
+}
+
+void fd4t10s_vel_coef(float *rv, float *rv12, const float *vel, int n) {
+  int i;
+
+#ifdef USE_OPENMP
+  #pragma omp parallel for default(shared) private(i)
+#endif
+  for (i = 0; i < n; i++) {
+    float r = 1.0f / vel[i];
+    rv[i] = r;
+    rv12[i] = (1.0f / 12) * (r * r);
+  }
+}
+
+void fd4t10s_correlate_frame(float *image, const float *s, const float *g, float scale, int nx, int nz, int d) {
+  int ix, iz;
+  for (ix = 0; ix < nx; ix++) {
+    int inner = ix >= d && ix < nx - d;
+    for (iz = 0; iz < nz; iz++) {
+      if (inner && iz == d) {
+        iz = nz - d - 1;
+        continue;
+      }
+      int curPos = ix * nz + iz;
+      image[curPos] -= s[curPos] * g[curPos] * scale;
+    }
+  }
+}
@@ -0,0 +1,32 @@
+/*
+ * fd4t10s-coef.h
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+#ifndef SRC_MODELING_FD4T10S_COEF_H_
+#define SRC_MODELING_FD4T10S_COEF_H_
+
+/**
+ * coefficient planes consumed by the fd4t10s_simd_* kernels, all of them nx * nz
+ *
+ * damping profile, it only depends on the geometry:
+ *   k1 = 2 - 2 * delta + delta * delta
+ *   k2 = 1 - 2 * delta
+ *
+ * velocity terms, the velocity is transformed:
+ *   rv   = 1 / vel
+ *   rv12 = 1 / 12 * rv * rv
+ */
+void fd4t10s_damp_coef(float *k1, float *k2, int nx, int nz, int nb, int freeSurface);
+void fd4t10s_vel_coef(float *rv, float *rv12, const float *vel, int n);
+
+/**
+ * image -= s * g * scale on the cells within d of the edges. the adjoint
+ * kernels of fd4t10s-fused.h and fd4t10s-simd.h leave them to this function,
+ * their steps only sweep the inner cells
+ */
+void fd4t10s_correlate_frame(float *image, const float *s, const float *g, float scale, int nx, int nz, int d);
+
+#endif /* SRC_MODELING_FD4T10S_COEF_H_ */
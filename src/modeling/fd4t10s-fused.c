@@ -0,0 +1,272 @@
+/*
+ * fd4t10s-fused.c
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+#include "fd4t10s-fused.h"
+#include "fd4t10s-coef.h"
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+/// height of the z tile, the rolling buffer holds 3 columns of one tile
+#define FUSED_TILE_NZ 256
+
+static const float a[6] = {
+  /// Zhang, Jinhai's method
+  +1.53400796,
+  +1.78858721,
+  -0.31660756,
+  +0.07612173,
+  -0.01626042,
+  +0.00216736
+};
+
+/**
+ * u2 of column ix for iz in [zb, ze), stored in u2col[iz - zb]
+ */
+static void laplacian_column(float *u2col, const float *curr_wave, int ix, int nz, int zb, int ze) {
+  int iz;
+  for (iz = zb; iz < ze; iz++) {
+    int curPos = ix * nz + iz;
+    u2col[iz - zb] = -4.0 * a[0] * curr_wave[curPos] +
+                     a[1] * (curr_wave[curPos - 1]  +  curr_wave[curPos + 1]  +
+                             curr_wave[curPos - nz]  +  curr_wave[curPos + nz])  +
+                     a[2] * (curr_wave[curPos - 2]  +  curr_wave[curPos + 2]  +
+                             curr_wave[curPos - 2 * nz]  +  curr_wave[curPos + 2 * nz])  +
+                     a[3] * (curr_wave[curPos - 3]  +  curr_wave[curPos + 3]  +
+                             curr_wave[curPos - 3 * nz]  +  curr_wave[curPos + 3 * nz])  +
+                     a[4] * (curr_wave[curPos - 4]  +  curr_wave[curPos + 4]  +
+                             curr_wave[curPos - 4 * nz]  +  curr_wave[curPos + 4 * nz])  +
+                     a[5] * (curr_wave[curPos - 5]  +  curr_wave[curPos + 5]  +
+                             curr_wave[curPos - 5 * nz]  +  curr_wave[curPos + 5 * nz]);
+  }
+}
+
+/**
+ * same profile as fd4t10s_damp_zjh_2d_vtrans
+ */
+static float damp_delta(int ix, int iz, int nx, int nz, int nb, int freeSurface) {
+  const int bz = nb;
+  const int bx = nb;
+  const float max_delta = 0.05;
+  float dist = 0;
+
+  if (!freeSurface && iz < bz) {
+    dist = (float)(bz - iz) / bz;
+  }
+  if (ix < bx) {
+    dist = (float)(bx - ix) / bx;
+  }
+  if (ix >= nx - bx) {
+    dist = (float)(ix - (nx - bx) + 1) / bx;
+  }
+  if (iz >= nz - bz) {
+    dist = (float)(iz - (nz - bz) + 1) / bz;
+  }
+
+  return max_delta * dist * dist;
+}
+
+/**
+ * update rows [z0, ze) of column ix, the u2 columns start at row z0 - 1.
+ * next_wave may be the same array as prev_wave, every point of prev_wave is
+ * read only once, right before it is overwritten
+ */
+static void update_rows(const float *prev_wave, const float *curr_wave, float *next_wave, const float *vel,
+    const float *u2l, const float *u2c, const float *u2r, int ix, int nx, int nz, int z0, int ze,
+    int nb, int freeSurface, int damp) {
+  int iz;
+  for (iz = z0; iz < ze; iz++) {
+    int curPos = ix * nz + iz;
+    int k = iz - z0 + 1;
+    float curvel = vel[curPos];
+    float lap4 = u2c[k - 1] + u2c[k + 1] + u2l[k] + u2r[k] - 4 * u2c[k];
+
+    if (damp) {
+      float delta = damp_delta(ix, iz, nx, nz, nb, freeSurface);
+      next_wave[curPos] = (2. - 2 * delta + delta * delta) * curr_wave[curPos] - (1 - 2 * delta) * prev_wave[curPos]  +
+                          (1.0f / curvel) * u2c[k] + /// 2nd order
+                          1.0f / 12 * (1.0f / curvel) * (1.0f / curvel) * lap4; /// 4th order
+    } else {
+      next_wave[curPos] = 2. * curr_wave[curPos] - prev_wave[curPos]  +
+                          (1.0f / curvel) * u2c[k] + /// 2nd order
+                          1.0f / 12 * (1.0f / curvel) * (1.0f / curvel) * lap4; /// 4th order
+    }
+  }
+}
+
+/**
+ * update columns [x0, x1) and rows [z0, z1), clipped to d cells from the edges
+ */
+static void fused_step(const float *prev_wave, const float *curr_wave, float *next_wave, const float *vel,
+    int nx, int nz, int nb, int freeSurface, int damp, int x0, int x1, int z0, int z1) {
+  const int d = 6;
+
+  x0 = x0 > d ? x0 : d;
+  x1 = x1 < nx - d ? x1 : nx - d;
+  z0 = z0 > d ? z0 : d;
+  z1 = z1 < nz - d ? z1 : nz - d;
+  if (x0 >= x1 || z0 >= z1) {
+    return;
+  }
+
+#ifdef USE_OPENMP
+  #pragma omp parallel
+#endif
+  {
+    float ring[3][FUSED_TILE_NZ + 2];
+    int nthreads = 1;
+    int tid = 0;
+#ifdef USE_OPENMP
+    nthreads = omp_get_num_threads();
+    tid = omp_get_thread_num();
+#endif
+
+    /// every thread sweeps a contiguous block of columns, so the rolling buffer is reused along x
+    int ncol = x1 - x0;
+    int xb = x0 + (int)((long)ncol * tid / nthreads);
+    int xe = x0 + (int)((long)ncol * (tid + 1) / nthreads);
+    int zb, ix;
+
+    for (zb = z0; zb < z1 && xb < xe; zb += FUSED_TILE_NZ) {
+      int ze = zb + FUSED_TILE_NZ < z1 ? zb + FUSED_TILE_NZ : z1;
+      float *u2l = ring[0];
+      float *u2c = ring[1];
+      float *u2r = ring[2];
+
+      /// u2 rows [zb - 1, ze + 1), element 0 of a column is row zb - 1
+      laplacian_column(u2l, curr_wave, xb - 1, nz, zb - 1, ze + 1);
+      laplacian_column(u2c, curr_wave, xb, nz, zb - 1, ze + 1);
+
+      for (ix = xb; ix < xe; ix++) {
+        laplacian_column(u2r, curr_wave, ix + 1, nz, zb - 1, ze + 1);
+        update_rows(prev_wave, curr_wave, next_wave, vel, u2l, u2c, u2r, ix, nx, nz, zb, ze, nb, freeSurface, damp);
+
+        /// rotate the buffer, the oldest column is recycled for ix + 2
+        float *t = u2l;
+        u2l = u2c;
+        u2c = u2r;
+        u2r = t;
+      }
+    }
+  }
+}
+
+/**
+ * fused_step of both wavefields, the new source column is correlated while it is in cache.
+ * the receiver wavefield is only stepped and correlated in columns [gx0, gx1) and rows [gz0, gz1)
+ */
+static void fused_adjoint_step(float *sp_prev, const float *sp_curr, float *gp_prev, const float *gp_curr,
+    const float *vel, float *image, float scale, int nx, int nz, int nb, int freeSurface,
+    int gx0, int gx1, int gz0, int gz1) {
+  const int d = 6;
+
+#ifdef USE_OPENMP
+  #pragma omp parallel
+#endif
+  {
+    float sring[3][FUSED_TILE_NZ + 2];
+    float gring[3][FUSED_TILE_NZ + 2];
+    int nthreads = 1;
+    int tid = 0;
+#ifdef USE_OPENMP
+    nthreads = omp_get_num_threads();
+    tid = omp_get_thread_num();
+#endif
+
+    int ncol = nx - 2 * d;
+    int xb = d + (int)((long)ncol * tid / nthreads);
+    int xe = d + (int)((long)ncol * (tid + 1) / nthreads);
+    int gxb = xb > gx0 ? xb : gx0;
+    int gxe = xe < gx1 ? xe : gx1;
+    int z0, ix, iz;
+
+    for (z0 = d; z0 < nz - d && xb < xe; z0 += FUSED_TILE_NZ) {
+      int ze = z0 + FUSED_TILE_NZ < nz - d ? z0 + FUSED_TILE_NZ : nz - d;
+      int gzb = z0 > gz0 ? z0 : gz0;
+      int gze = ze < gz1 ? ze : gz1;
+      int gtile = gxb < gxe && gzb < gze;
+      float *su2l = sring[0];
+      float *su2c = sring[1];
+      float *su2r = sring[2];
+      float *gu2l = gring[0];
+      float *gu2c = gring[1];
+      float *gu2r = gring[2];
+
+      laplacian_column(su2l, sp_curr, xb - 1, nz, z0 - 1, ze + 1);
+      laplacian_column(su2c, sp_curr, xb, nz, z0 - 1, ze + 1);
+      if (gtile) {
+        laplacian_column(gu2l, gp_curr, gxb - 1, nz, gzb - 1, gze + 1);
+        laplacian_column(gu2c, gp_curr, gxb, nz, gzb - 1, gze + 1);
+      }
+
+      for (ix = xb; ix < xe; ix++) {
+        laplacian_column(su2r, sp_curr, ix + 1, nz, z0 - 1, ze + 1);
+        update_rows(sp_prev, sp_curr, sp_prev, vel, su2l, su2c, su2r, ix, nx, nz, z0, ze, 0, 0, 0);
+
+        float *t = su2l;
+        su2l = su2c;
+        su2c = su2r;
+        su2r = t;
+
+        if (!gtile || ix < gxb || ix >= gxe) {
+          continue;
+        }
+        laplacian_column(gu2r, gp_curr, ix + 1, nz, gzb - 1, gze + 1);
+        update_rows(gp_prev, gp_curr, gp_prev, vel, gu2l, gu2c, gu2r, ix, nx, nz, gzb, gze, nb, freeSurface, 1);
+        for (iz = gzb; iz < gze; iz++) {
+          int curPos = ix * nz + iz;
+          image[curPos] -= sp_prev[curPos] * gp_curr[curPos] * scale;
+        }
+
+        t = gu2l;
+        gu2l = gu2c;
+        gu2c = gu2r;
+        gu2r = t;
+      }
+    }
+  }
+}
+
+/**
+ * please note that the velocity is transformed
+ */
+void fd4t10s_fused_damp_2d_vtrans(float *prev_wave, const float *curr_wave, const float *vel, int nx, int nz, int nb, int freeSurface) {
+  fused_step(prev_wave, curr_wave, prev_wave, vel, nx, nz, nb, freeSurface, 1, 0, nx, 0, nz);
+}
+
+void fd4t10s_fused_damp_2d_vtrans_box(float *prev_wave, const float *curr_wave, const float *vel, int nx, int nz, int nb, int freeSurface,
+    int x0, int x1, int z0, int z1) {
+  fused_step(prev_wave, curr_wave, prev_wave, vel, nx, nz, nb, freeSurface, 1, x0, x1, z0, z1);
+}
+
+void fd4t10s_fused_2d_vtrans(float *prev_wave, const float *curr_wave, const float *vel, int nx, int nz) {
+  fused_step(prev_wave, curr_wave, prev_wave, vel, nx, nz, 0, 0, 0, 0, nx, 0, nz);
+}
+
+void fd4t10s_fused_2d_vtrans_3vars(const float *prev_wave, const float *curr_wave, float *next_wave, const float *vel, int nx, int nz) {
+  fused_step(prev_wave, curr_wave, next_wave, vel, nx, nz, 0, 0, 0, 0, nx, 0, nz);
+}
+
+void fd4t10s_fused_adjoint_2d_vtrans(float *sp_prev, const float *sp_curr, float *gp_prev, const float *gp_curr,
+    const float *vel, float *image, float scale, int nx, int nz, int nb, int freeSurface) {
+  fd4t10s_fused_adjoint_2d_vtrans_box(sp_prev, sp_curr, gp_prev, gp_curr, vel, image, scale, nx, nz, nb, freeSurface,
+      0, nx, 0, nz);
+}
+
+void fd4t10s_fused_adjoint_2d_vtrans_box(float *sp_prev, const float *sp_curr, float *gp_prev, const float *gp_curr,
+    const float *vel, float *image, float scale, int nx, int nz, int nb, int freeSurface,
+    int gx0, int gx1, int gz0, int gz1) {
+  const int d = 6;
+
+  gx0 = gx0 > d ? gx0 : d;
+  gx1 = gx1 < nx - d ? gx1 : nx - d;
+  gz0 = gz0 > d ? gz0 : d;
+  gz1 = gz1 < nz - d ? gz1 : nz - d;
+  fused_adjoint_step(sp_prev, sp_curr, gp_prev, gp_curr, vel, image, scale, nx, nz, nb, freeSurface, gx0, gx1, gz0, gz1);
+  fd4t10s_correlate_frame(image, sp_prev, gp_curr, scale, nx, nz, d);
+}
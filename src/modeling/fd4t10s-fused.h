@@ -0,0 +1,38 @@
+/*
+ * fd4t10s-fused.h
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+#ifndef SRC_MODELING_FD4T10S_FUSED_H_
+#define SRC_MODELING_FD4T10S_FUSED_H_
+
+/**
+ * single pass versions of the fd4t10s kernels, the laplacian u2 is kept in a
+ * rolling buffer of three columns instead of a full nx * nz plane.
+ * the results are the same as the two pass kernels, bit by bit
+ */
+void fd4t10s_fused_damp_2d_vtrans(float *prev_wave, const float *curr_wave, const float *vel, int nx, int nz, int nb, int freeSurface);
+/// fd4t10s_fused_damp_2d_vtrans restricted to columns [x0, x1) and rows [z0, z1), the points outside keep prev_wave
+void fd4t10s_fused_damp_2d_vtrans_box(float *prev_wave, const float *curr_wave, const float *vel, int nx, int nz, int nb, int freeSurface,
+    int x0, int x1, int z0, int z1);
+void fd4t10s_fused_2d_vtrans(float *prev_wave, const float *curr_wave, const float *vel, int nx, int nz);
+void fd4t10s_fused_2d_vtrans_3vars(const float *prev_wave, const float *curr_wave, float *next_wave, const float *vel, int nx, int nz);
+
+/**
+ * one time step of the gradient backward loop in a single sweep:
+ * sp_prev gets fd4t10s_fused_2d_vtrans of the source wavefield,
+ * gp_prev gets fd4t10s_fused_damp_2d_vtrans of the receiver wavefield,
+ * and image -= sp_prev * gp_curr * scale over the whole grid, that is the new
+ * source wavefield against the receiver wavefield before the step
+ */
+void fd4t10s_fused_adjoint_2d_vtrans(float *sp_prev, const float *sp_curr, float *gp_prev, const float *gp_curr,
+    const float *vel, float *image, float scale, int nx, int nz, int nb, int freeSurface);
+/// fd4t10s_fused_adjoint_2d_vtrans with the receiver wavefield restricted to columns [gx0, gx1) and rows [gz0, gz1),
+/// the points outside keep gp_prev and are not correlated
+void fd4t10s_fused_adjoint_2d_vtrans_box(float *sp_prev, const float *sp_curr, float *gp_prev, const float *gp_curr,
+    const float *vel, float *image, float scale, int nx, int nz, int nb, int freeSurface,
+    int gx0, int gx1, int gz0, int gz1);
+
+#endif /* SRC_MODELING_FD4T10S_FUSED_H_ */
@@ -0,0 +1,518 @@
+/*
+ * fd4t10s-simd-kernel.h
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+/**
+ * body of the vectorized fd4t10s kernels, included once per instruction set
+ * by fd4t10s-simd.c. no include guard on purpose.
+ *
+ * the includer defines
+ *   VF, VW            vector type and its width in floats
+ *   VLOAD, VSTORE     unaligned load / store
+ *   VSET1, VADD, VSUB, VMUL, VDIV
+ *   VMIN, VMAX        x < y ? x : y and x > y ? x : y
+ *   VFMADD(a, b, c)   a * b + c
+ *   VFNMADD(a, b, c)  c - a * b
+ *   FN(name)          name decorated with the instruction set
+ */
+
+/**
+ * scalar tails of the vector kernels, same operation order as one vector lane.
+ * they are compiled for the instruction set of the includer, so fmaf is one
+ * instruction where the vectors have fma. zs and xs are the strides of a step
+ * along z and along x
+ */
+static inline float FN(laplacian_point)(const float *p, int zs, int xs) {
+  float s1 = (p[-zs] + p[zs]) + (p[-xs] + p[xs]);
+  float s2 = (p[-2 * zs] + p[2 * zs]) + (p[-2 * xs] + p[2 * xs]);
+  float s3 = (p[-3 * zs] + p[3 * zs]) + (p[-3 * xs] + p[3 * xs]);
+  float s4 = (p[-4 * zs] + p[4 * zs]) + (p[-4 * xs] + p[4 * xs]);
+  float s5 = (p[-5 * zs] + p[5 * zs]) + (p[-5 * xs] + p[5 * xs]);
+  float acc = (-4.0f * a[0]) * p[0];
+  acc = fmaf(a[1], s1, acc);
+  acc = fmaf(a[2], s2, acc);
+  acc = fmaf(a[3], s3, acc);
+  acc = fmaf(a[4], s4, acc);
+  acc = fmaf(a[5], s5, acc);
+  return acc;
+}
+
+static inline float FN(update_point)(float curr, float prev, float k1, float k2, float rv, float rv12, float u2c, float lap4) {
+  float acc = k1 * curr;
+  acc = fmaf(-k2, prev, acc);
+  acc = fmaf(rv, u2c, acc);
+  acc = fmaf(rv12, lap4, acc);
+  return acc;
+}
+
+static void FN(laplacian_column)(float *u2col, const float *curr_wave, int ix, int nz, int zb, int ze) {
+  const float *col = curr_wave + ix * nz;
+  const VF c0 = VSET1(-4.0f * a[0]);
+  const VF c1 = VSET1(a[1]);
+  const VF c2 = VSET1(a[2]);
+  const VF c3 = VSET1(a[3]);
+  const VF c4 = VSET1(a[4]);
+  const VF c5 = VSET1(a[5]);
+  int iz = zb;
+
+  for (; iz + VW <= ze; iz += VW) {
+    const float *p = col + iz;
+    VF s1 = VADD(VADD(VLOAD(p - 1), VLOAD(p + 1)), VADD(VLOAD(p - nz), VLOAD(p + nz)));
+    VF s2 = VADD(VADD(VLOAD(p - 2), VLOAD(p + 2)), VADD(VLOAD(p - 2 * nz), VLOAD(p + 2 * nz)));
+    VF s3 = VADD(VADD(VLOAD(p - 3), VLOAD(p + 3)), VADD(VLOAD(p - 3 * nz), VLOAD(p + 3 * nz)));
+    VF s4 = VADD(VADD(VLOAD(p - 4), VLOAD(p + 4)), VADD(VLOAD(p - 4 * nz), VLOAD(p + 4 * nz)));
+    VF s5 = VADD(VADD(VLOAD(p - 5), VLOAD(p + 5)), VADD(VLOAD(p - 5 * nz), VLOAD(p + 5 * nz)));
+    VF acc = VMUL(c0, VLOAD(p));
+    acc = VFMADD(c1, s1, acc);
+    acc = VFMADD(c2, s2, acc);
+    acc = VFMADD(c3, s3, acc);
+    acc = VFMADD(c4, s4, acc);
+    acc = VFMADD(c5, s5, acc);
+    VSTORE(u2col + iz - zb, acc);
+  }
+
+  for (; iz < ze; iz++) {
+    u2col[iz - zb] = FN(laplacian_point)(col + iz, 1, nz);
+  }
+}
+
+/**
+ * update rows [z0, ze) of column ix, the u2 columns start at row z0 - 1.
+ * without damping planes (k1 == NULL) the coefficients are 2 and 1
+ */
+static void FN(update_rows)(const float *prev_wave, const float *curr_wave, float *next_wave,
+    const float *k1, const float *k2, const float *rv, const float *rv12,
+    const float *u2l, const float *u2c, const float *u2r, int ix, int nz, int z0, int ze) {
+  const VF four = VSET1(4.0f);
+  VF vk1 = VSET1(2.0f);
+  VF vk2 = VSET1(1.0f);
+  int off = ix * nz;
+  int iz = z0;
+
+  for (; iz + VW <= ze; iz += VW) {
+    int k = iz - z0 + 1;
+    if (k1) {
+      vk1 = VLOAD(k1 + off + iz);
+      vk2 = VLOAD(k2 + off + iz);
+    }
+    VF c = VLOAD(u2c + k);
+    VF lap4 = VSUB(VADD(VADD(VLOAD(u2c + k - 1), VLOAD(u2c + k + 1)), VADD(VLOAD(u2l + k), VLOAD(u2r + k))),
+                   VMUL(four, c));
+    VF acc = VMUL(vk1, VLOAD(curr_wave + off + iz));
+    acc = VFNMADD(vk2, VLOAD(prev_wave + off + iz), acc);
+    acc = VFMADD(VLOAD(rv + off + iz), c, acc);
+    acc = VFMADD(VLOAD(rv12 + off + iz), lap4, acc);
+    VSTORE(next_wave + off + iz, acc);
+  }
+
+  for (; iz < ze; iz++) {
+    int k = iz - z0 + 1;
+    int curPos = off + iz;
+    float lap4 = ((u2c[k - 1] + u2c[k + 1]) + (u2l[k] + u2r[k])) - 4.0f * u2c[k];
+    next_wave[curPos] = FN(update_point)(curr_wave[curPos], prev_wave[curPos],
+        k1 ? k1[curPos] : 2.0f, k1 ? k2[curPos] : 1.0f, rv[curPos], rv12[curPos], u2c[k], lap4);
+  }
+}
+
+/**
+ * update columns [x0, x1) and rows [z0, z1), both within d of the edges at most
+ */
+static void FN(simd_step)(const float *prev_wave, const float *curr_wave, float *next_wave,
+    const float *k1, const float *k2, const float *rv, const float *rv12, int nz,
+    int x0, int x1, int z0, int z1) {
+#ifdef USE_OPENMP
+  #pragma omp parallel
+#endif
+  {
+    float ring[3][SIMD_TILE_NZ + 2];
+    int nthreads = 1;
+    int tid = 0;
+#ifdef USE_OPENMP
+    nthreads = omp_get_num_threads();
+    tid = omp_get_thread_num();
+#endif
+
+    int ncol = x1 - x0;
+    int xb = x0 + (int)((long)ncol * tid / nthreads);
+    int xe = x0 + (int)((long)ncol * (tid + 1) / nthreads);
+    int zb, ix;
+
+    for (zb = z0; zb < z1 && xb < xe; zb += SIMD_TILE_NZ) {
+      int ze = zb + SIMD_TILE_NZ < z1 ? zb + SIMD_TILE_NZ : z1;
+      float *u2l = ring[0];
+      float *u2c = ring[1];
+      float *u2r = ring[2];
+
+      FN(laplacian_column)(u2l, curr_wave, xb - 1, nz, zb - 1, ze + 1);
+      FN(laplacian_column)(u2c, curr_wave, xb, nz, zb - 1, ze + 1);
+
+      for (ix = xb; ix < xe; ix++) {
+        FN(laplacian_column)(u2r, curr_wave, ix + 1, nz, zb - 1, ze + 1);
+        FN(update_rows)(prev_wave, curr_wave, next_wave, k1, k2, rv, rv12, u2l, u2c, u2r, ix, nz, zb, ze);
+
+        float *t = u2l;
+        u2l = u2c;
+        u2c = u2r;
+        u2r = t;
+      }
+    }
+  }
+}
+
+/**
+ * image[i] -= s[i] * g[i] * scale for n points from off
+ */
+static void FN(correlate_rows)(float *image, const float *s, const float *g, float scale, int off, int n) {
+  const VF vscale = VSET1(scale);
+  int i = 0;
+
+  for (; i + VW <= n; i += VW) {
+    VF sg = VMUL(VLOAD(s + off + i), VLOAD(g + off + i));
+    VSTORE(image + off + i, VSUB(VLOAD(image + off + i), VMUL(sg, vscale)));
+  }
+
+  for (; i < n; i++) {
+    image[off + i] -= s[off + i] * g[off + i] * scale;
+  }
+}
+
+/**
+ * undamped step of the source wavefield, damped step of the receiver
+ * wavefield and the correlation of the new source column with the receiver
+ * column before the step, in one sweep. the receiver wavefield is only
+ * stepped and correlated in columns [gx0, gx1) and rows [gz0, gz1)
+ */
+static void FN(adjoint_step)(float *sp_prev, const float *sp_curr, float *gp_prev, const float *gp_curr,
+    const float *k1, const float *k2, const float *rv, const float *rv12,
+    float *image, float scale, int nx, int nz, int gx0, int gx1, int gz0, int gz1) {
+  const int d = 6;
+
+#ifdef USE_OPENMP
+  #pragma omp parallel
+#endif
+  {
+    float sring[3][SIMD_TILE_NZ + 2];
+    float gring[3][SIMD_TILE_NZ + 2];
+    int nthreads = 1;
+    int tid = 0;
+#ifdef USE_OPENMP
+    nthreads = omp_get_num_threads();
+    tid = omp_get_thread_num();
+#endif
+
+    int ncol = nx - 2 * d;
+    int xb = d + (int)((long)ncol * tid / nthreads);
+    int xe = d + (int)((long)ncol * (tid + 1) / nthreads);
+    int gxb = xb > gx0 ? xb : gx0;
+    int gxe = xe < gx1 ? xe : gx1;
+    int z0, ix;
+
+    for (z0 = d; z0 < nz - d && xb < xe; z0 += SIMD_TILE_NZ) {
+      int ze = z0 + SIMD_TILE_NZ < nz - d ? z0 + SIMD_TILE_NZ : nz - d;
+      int gzb = z0 > gz0 ? z0 : gz0;
+      int gze = ze < gz1 ? ze : gz1;
+      int gtile = gxb < gxe && gzb < gze;
+      float *su2l = sring[0];
+      float *su2c = sring[1];
+      float *su2r = sring[2];
+      float *gu2l = gring[0];
+      float *gu2c = gring[1];
+      float *gu2r = gring[2];
+
+      FN(laplacian_column)(su2l, sp_curr, xb - 1, nz, z0 - 1, ze + 1);
+      FN(laplacian_column)(su2c, sp_curr, xb, nz, z0 - 1, ze + 1);
+      if (gtile) {
+        FN(laplacian_column)(gu2l, gp_curr, gxb - 1, nz, gzb - 1, gze + 1);
+        FN(laplacian_column)(gu2c, gp_curr, gxb, nz, gzb - 1, gze + 1);
+      }
+
+      for (ix = xb; ix < xe; ix++) {
+        FN(laplacian_column)(su2r, sp_curr, ix + 1, nz, z0 - 1, ze + 1);
+        FN(update_rows)(sp_prev, sp_curr, sp_prev, NULL, NULL, rv, rv12, su2l, su2c, su2r, ix, nz, z0, ze);
+
+        float *t = su2l;
+        su2l = su2c;
+        su2c = su2r;
+        su2r = t;
+
+        if (!gtile || ix < gxb || ix >= gxe) {
+          continue;
+        }
+        FN(laplacian_column)(gu2r, gp_curr, ix + 1, nz, gzb - 1, gze + 1);
+        FN(update_rows)(gp_prev, gp_curr, gp_prev, k1, k2, rv, rv12, gu2l, gu2c, gu2r, ix, nz, gzb, gze);
+        FN(correlate_rows)(image, sp_prev, gp_curr, scale, ix * nz + gzb, gze - gzb);
+
+        t = gu2l;
+        gu2l = gu2c;
+        gu2c = gu2r;
+        gu2r = t;
+      }
+    }
+  }
+}
+
+/**
+ * the batch kernels work on nbat wavefields interleaved as [ix][iz][b], the
+ * vector lanes run over b. u2 of column ix for rows [zb, ze), stored in
+ * u2col[(iz - zb) * nbat + b]
+ */
+static void FN(batch_laplacian_column)(float *u2col, const float *curr_wave, int ix, int nz, int nbat, int zb, int ze) {
+  const int xs = nz * nbat;
+  const float *col = curr_wave + (size_t)ix * xs;
+  const VF c0 = VSET1(-4.0f * a[0]);
+  const VF c1 = VSET1(a[1]);
+  const VF c2 = VSET1(a[2]);
+  const VF c3 = VSET1(a[3]);
+  const VF c4 = VSET1(a[4]);
+  const VF c5 = VSET1(a[5]);
+  int iz, b;
+
+  for (iz = zb; iz < ze; iz++) {
+    const float *row = col + iz * nbat;
+    float *out = u2col + (iz - zb) * nbat;
+
+    for (b = 0; b + VW <= nbat; b += VW) {
+      const float *p = row + b;
+      VF s1 = VADD(VADD(VLOAD(p - nbat), VLOAD(p + nbat)), VADD(VLOAD(p - xs), VLOAD(p + xs)));
+      VF s2 = VADD(VADD(VLOAD(p - 2 * nbat), VLOAD(p + 2 * nbat)), VADD(VLOAD(p - 2 * xs), VLOAD(p + 2 * xs)));
+      VF s3 = VADD(VADD(VLOAD(p - 3 * nbat), VLOAD(p + 3 * nbat)), VADD(VLOAD(p - 3 * xs), VLOAD(p + 3 * xs)));
+      VF s4 = VADD(VADD(VLOAD(p - 4 * nbat), VLOAD(p + 4 * nbat)), VADD(VLOAD(p - 4 * xs), VLOAD(p + 4 * xs)));
+      VF s5 = VADD(VADD(VLOAD(p - 5 * nbat), VLOAD(p + 5 * nbat)), VADD(VLOAD(p - 5 * xs), VLOAD(p + 5 * xs)));
+      VF acc = VMUL(c0, VLOAD(p));
+      acc = VFMADD(c1, s1, acc);
+      acc = VFMADD(c2, s2, acc);
+      acc = VFMADD(c3, s3, acc);
+      acc = VFMADD(c4, s4, acc);
+      acc = VFMADD(c5, s5, acc);
+      VSTORE(out + b, acc);
+    }
+
+    for (; b < nbat; b++) {
+      out[b] = FN(laplacian_point)(row + b, nbat, xs);
+    }
+  }
+}
+
+/**
+ * update_rows in the batch layout, the coefficients of a point are loaded
+ * once and broadcast to the nbat wavefields
+ */
+static void FN(batch_update_rows)(const float *prev_wave, const float *curr_wave, float *next_wave,
+    const float *k1, const float *k2, const float *rv, const float *rv12,
+    const float *u2l, const float *u2c, const float *u2r, int ix, int nz, int nbat, int z0, int ze) {
+  const VF four = VSET1(4.0f);
+  int iz, b;
+
+  for (iz = z0; iz < ze; iz++) {
+    int pt = ix * nz + iz;
+    size_t off = (size_t)pt * nbat;
+    int k = (iz - z0 + 1) * nbat;
+    float sk1 = k1 ? k1[pt] : 2.0f;
+    float sk2 = k1 ? k2[pt] : 1.0f;
+    const VF vk1 = VSET1(sk1);
+    const VF vk2 = VSET1(sk2);
+    const VF vrv = VSET1(rv[pt]);
+    const VF vrv12 = VSET1(rv12[pt]);
+
+    for (b = 0; b + VW <= nbat; b += VW) {
+      VF c = VLOAD(u2c + k + b);
+      VF lap4 = VSUB(VADD(VADD(VLOAD(u2c + k - nbat + b), VLOAD(u2c + k + nbat + b)), VADD(VLOAD(u2l + k + b), VLOAD(u2r + k + b))),
+                     VMUL(four, c));
+      VF acc = VMUL(vk1, VLOAD(curr_wave + off + b));
+      acc = VFNMADD(vk2, VLOAD(prev_wave + off + b), acc);
+      acc = VFMADD(vrv, c, acc);
+      acc = VFMADD(vrv12, lap4, acc);
+      VSTORE(next_wave + off + b, acc);
+    }
+
+    for (; b < nbat; b++) {
+      float lap4 = ((u2c[k - nbat + b] + u2c[k + nbat + b]) + (u2l[k + b] + u2r[k + b])) - 4.0f * u2c[k + b];
+      next_wave[off + b] = FN(update_point)(curr_wave[off + b], prev_wave[off + b], sk1, sk2, rv[pt], rv12[pt], u2c[k + b], lap4);
+    }
+  }
+}
+
+/**
+ * simd_step in the batch layout. the tiles are shorter for larger batches so
+ * the three u2 columns of a thread stay about as large as in simd_step
+ */
+static void FN(batch_step)(const float *prev_wave, const float *curr_wave, float *next_wave,
+    const float *k1, const float *k2, const float *rv, const float *rv12, int nz, int nbat,
+    int x0, int x1, int z0, int z1) {
+  int tile = nbat <= 8 ? SIMD_TILE_NZ : SIMD_TILE_NZ * 8 / nbat;
+  tile = tile < 32 ? 32 : tile;
+
+#ifdef USE_OPENMP
+  #pragma omp parallel
+#endif
+  {
+    size_t ringSize = (size_t)(tile + 2) * nbat;
+    float *ring = (float *)malloc(3 * ringSize * sizeof(float));
+    int nthreads = 1;
+    int tid = 0;
+#ifdef USE_OPENMP
+    nthreads = omp_get_num_threads();
+    tid = omp_get_thread_num();
+#endif
+
+    int ncol = x1 - x0;
+    int xb = x0 + (int)((long)ncol * tid / nthreads);
+    int xe = x0 + (int)((long)ncol * (tid + 1) / nthreads);
+    int zb, ix;
+
+    for (zb = z0; zb < z1 && xb < xe; zb += tile) {
+      int ze = zb + tile < z1 ? zb + tile : z1;
+      float *u2l = ring;
+      float *u2c = ring + ringSize;
+      float *u2r = ring + 2 * ringSize;
+
+      FN(batch_laplacian_column)(u2l, curr_wave, xb - 1, nz, nbat, zb - 1, ze + 1);
+      FN(batch_laplacian_column)(u2c, curr_wave, xb, nz, nbat, zb - 1, ze + 1);
+
+      for (ix = xb; ix < xe; ix++) {
+        FN(batch_laplacian_column)(u2r, curr_wave, ix + 1, nz, nbat, zb - 1, ze + 1);
+        FN(batch_update_rows)(prev_wave, curr_wave, next_wave, k1, k2, rv, rv12, u2l, u2c, u2r, ix, nz, nbat, zb, ze);
+
+        float *t = u2l;
+        u2l = u2c;
+        u2c = u2r;
+        u2r = t;
+      }
+    }
+
+    free(ring);
+  }
+}
+
+/**
+ * update_rows of nmod wavefields in place, each in its own velocity model.
+ * the velocity of model m is clip(vel + alpha[m] * dvel, vmin, vmax) and its
+ * coefficients are computed where they are used, with the operations of
+ * FwiUpdateVelOp::update and fd4t10s_vel_coef. k1, k2, vel and dvel are loaded
+ * once for all the models. u2[3 * m] to u2[3 * m + 2] are the u2 columns of
+ * model m
+ */
+static void FN(models_update_rows)(float *const *prev_wave, const float *const *curr_wave,
+    const float *k1, const float *k2, const float *vel, const float *dvel, const float *alpha, int nmod,
+    float vmin, float vmax, float *const *u2, int ix, int nz, int z0, int ze) {
+  const VF four = VSET1(4.0f);
+  const VF one = VSET1(1.0f);
+  const VF c12 = VSET1(1.0f / 12);
+  const VF lo = VSET1(vmin);
+  const VF hi = VSET1(vmax);
+  int off = ix * nz;
+  int iz = z0;
+  int m;
+
+  for (; iz + VW <= ze; iz += VW) {
+    int k = iz - z0 + 1;
+    VF vk1 = VLOAD(k1 + off + iz);
+    VF vk2 = VLOAD(k2 + off + iz);
+    VF v = VLOAD(vel + off + iz);
+    VF dv = VLOAD(dvel + off + iz);
+
+    for (m = 0; m < nmod; m++) {
+      const float *u2l = u2[3 * m];
+      const float *u2c = u2[3 * m + 1];
+      const float *u2r = u2[3 * m + 2];
+      float *prev = prev_wave[m];
+
+      VF nv = VADD(v, VMUL(VSET1(alpha[m]), dv));
+      nv = VMAX(VMIN(nv, hi), lo);
+      VF r = VDIV(one, nv);
+      VF r12 = VMUL(c12, VMUL(r, r));
+
+      VF c = VLOAD(u2c + k);
+      VF lap4 = VSUB(VADD(VADD(VLOAD(u2c + k - 1), VLOAD(u2c + k + 1)), VADD(VLOAD(u2l + k), VLOAD(u2r + k))),
+                     VMUL(four, c));
+      VF acc = VMUL(vk1, VLOAD(curr_wave[m] + off + iz));
+      acc = VFNMADD(vk2, VLOAD(prev + off + iz), acc);
+      acc = VFMADD(r, c, acc);
+      acc = VFMADD(r12, lap4, acc);
+      VSTORE(prev + off + iz, acc);
+    }
+  }
+
+  for (; iz < ze; iz++) {
+    int k = iz - z0 + 1;
+    int curPos = off + iz;
+
+    for (m = 0; m < nmod; m++) {
+      const float *u2l = u2[3 * m];
+      const float *u2c = u2[3 * m + 1];
+      const float *u2r = u2[3 * m + 2];
+
+      float nv = vel[curPos] + alpha[m] * dvel[curPos];
+      nv = nv < vmax ? nv : vmax;
+      nv = nv > vmin ? nv : vmin;
+      float r = 1.0f / nv;
+      float r12 = (1.0f / 12) * (r * r);
+
+      float lap4 = ((u2c[k - 1] + u2c[k + 1]) + (u2l[k] + u2r[k])) - 4.0f * u2c[k];
+      prev_wave[m][curPos] = FN(update_point)(curr_wave[m][curPos], prev_wave[m][curPos],
+          k1[curPos], k2[curPos], r, r12, u2c[k], lap4);
+    }
+  }
+}
+
+/**
+ * simd_step of nmod models in place, the models advance column by column
+ * together so the shared planes are read once per sweep
+ */
+static void FN(models_step)(float *const *prev_wave, const float *const *curr_wave,
+    const float *k1, const float *k2, const float *vel, const float *dvel, const float *alpha, int nmod,
+    float vmin, float vmax, int nz, int x0, int x1, int z0, int z1) {
+  int tile = nmod <= 2 ? SIMD_TILE_NZ : SIMD_TILE_NZ * 2 / nmod;
+  tile = tile < 32 ? 32 : tile;
+
+#ifdef USE_OPENMP
+  #pragma omp parallel
+#endif
+  {
+    float *ring = (float *)malloc((size_t)3 * nmod * (tile + 2) * sizeof(float));
+    float **u2 = (float **)malloc((size_t)3 * nmod * sizeof(float *));
+    int nthreads = 1;
+    int tid = 0;
+#ifdef USE_OPENMP
+    nthreads = omp_get_num_threads();
+    tid = omp_get_thread_num();
+#endif
+
+    int ncol = x1 - x0;
+    int xb = x0 + (int)((long)ncol * tid / nthreads);
+    int xe = x0 + (int)((long)ncol * (tid + 1) / nthreads);
+    int zb, ix, m;
+
+    for (zb = z0; zb < z1 && xb < xe; zb += tile) {
+      int ze = zb + tile < z1 ? zb + tile : z1;
+
+      for (m = 0; m < nmod; m++) {
+        u2[3 * m] = ring + (size_t)(3 * m) * (tile + 2);
+        u2[3 * m + 1] = ring + (size_t)(3 * m + 1) * (tile + 2);
+        u2[3 * m + 2] = ring + (size_t)(3 * m + 2) * (tile + 2);
+        FN(laplacian_column)(u2[3 * m], curr_wave[m], xb - 1, nz, zb - 1, ze + 1);
+        FN(laplacian_column)(u2[3 * m + 1], curr_wave[m], xb, nz, zb - 1, ze + 1);
+      }
+
+      for (ix = xb; ix < xe; ix++) {
+        for (m = 0; m < nmod; m++) {
+          FN(laplacian_column)(u2[3 * m + 2], curr_wave[m], ix + 1, nz, zb - 1, ze + 1);
+        }
+        FN(models_update_rows)(prev_wave, curr_wave, k1, k2, vel, dvel, alpha, nmod, vmin, vmax, u2, ix, nz, zb, ze);
+
+        for (m = 0; m < nmod; m++) {
+          float *t = u2[3 * m];
+          u2[3 * m] = u2[3 * m + 1];
+          u2[3 * m + 1] = u2[3 * m + 2];
+          u2[3 * m + 2] = t;
+        }
+      }
+    }
+
+    free(u2);
+    free(ring);
+  }
+}
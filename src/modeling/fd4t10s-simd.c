@@ -0,0 +1,362 @@
+/*
+ * fd4t10s-simd.c
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "fd4t10s-simd.h"
+#include "fd4t10s-coef.h"
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FD4T10S_X86_SIMD
+#endif
+
+#ifdef FD4T10S_X86_SIMD
+/// the kernels use explicit fma only, keep the compiler from contracting the rest
+#pragma GCC optimize ("fp-contract=off")
+#include <immintrin.h>
+#endif
+
+#define SIMD_TILE_NZ 256
+
+static const float a[6] = {
+  /// Zhang, Jinhai's method
+  +1.53400796,
+  +1.78858721,
+  -0.31660756,
+  +0.07612173,
+  -0.01626042,
+  +0.00216736
+};
+
+/*********************************** scalar ***********************************/
+/// plain multiply and add, fmaf is a library call on cpus without fma
+#define VF float
+#define VW 1
+#define VLOAD(p) (*(p))
+#define VSTORE(p, v) (*(p) = (v))
+#define VSET1(x) (x)
+#define VADD(x, y) ((x) + (y))
+#define VSUB(x, y) ((x) - (y))
+#define VMUL(x, y) ((x) * (y))
+#define VDIV(x, y) ((x) / (y))
+#define VMIN(x, y) ((x) < (y) ? (x) : (y))
+#define VMAX(x, y) ((x) > (y) ? (x) : (y))
+#define VFMADD(x, y, z) ((x) * (y) + (z))
+#define VFNMADD(x, y, z) ((z) - (x) * (y))
+#define FN(name) name##_scalar
+
+#include "fd4t10s-simd-kernel.h"
+
+#undef VF
+#undef VW
+#undef VLOAD
+#undef VSTORE
+#undef VSET1
+#undef VADD
+#undef VSUB
+#undef VMUL
+#undef VDIV
+#undef VMIN
+#undef VMAX
+#undef VFMADD
+#undef VFNMADD
+#undef FN
+
+#ifdef FD4T10S_X86_SIMD
+
+/************************************ avx2 ************************************/
+#pragma GCC push_options
+#pragma GCC target ("avx2,fma")
+
+#define VF __m256
+#define VW 8
+#define VLOAD(p) _mm256_loadu_ps(p)
+#define VSTORE(p, v) _mm256_storeu_ps(p, v)
+#define VSET1(x) _mm256_set1_ps(x)
+#define VADD(x, y) _mm256_add_ps(x, y)
+#define VSUB(x, y) _mm256_sub_ps(x, y)
+#define VMUL(x, y) _mm256_mul_ps(x, y)
+#define VDIV(x, y) _mm256_div_ps(x, y)
+#define VMIN(x, y) _mm256_min_ps(x, y)
+#define VMAX(x, y) _mm256_max_ps(x, y)
+#define VFMADD(x, y, z) _mm256_fmadd_ps(x, y, z)
+#define VFNMADD(x, y, z) _mm256_fnmadd_ps(x, y, z)
+#define FN(name) name##_avx2
+
+#include "fd4t10s-simd-kernel.h"
+
+#undef VF
+#undef VW
+#undef VLOAD
+#undef VSTORE
+#undef VSET1
+#undef VADD
+#undef VSUB
+#undef VMUL
+#undef VDIV
+#undef VMIN
+#undef VMAX
+#undef VFMADD
+#undef VFNMADD
+#undef FN
+
+#pragma GCC pop_options
+
+/*********************************** avx512 ***********************************/
+#pragma GCC push_options
+#pragma GCC target ("avx512f,fma")
+
+#define VF __m512
+#define VW 16
+#define VLOAD(p) _mm512_loadu_ps(p)
+#define VSTORE(p, v) _mm512_storeu_ps(p, v)
+#define VSET1(x) _mm512_set1_ps(x)
+#define VADD(x, y) _mm512_add_ps(x, y)
+#define VSUB(x, y) _mm512_sub_ps(x, y)
+#define VMUL(x, y) _mm512_mul_ps(x, y)
+#define VDIV(x, y) _mm512_div_ps(x, y)
+#define VMIN(x, y) _mm512_min_ps(x, y)
+#define VMAX(x, y) _mm512_max_ps(x, y)
+#define VFMADD(x, y, z) _mm512_fmadd_ps(x, y, z)
+#define VFNMADD(x, y, z) _mm512_fnmadd_ps(x, y, z)
+#define FN(name) name##_avx512
+
+#include "fd4t10s-simd-kernel.h"
+
+#undef VF
+#undef VW
+#undef VLOAD
+#undef VSTORE
+#undef VSET1
+#undef VADD
+#undef VSUB
+#undef VMUL
+#undef VDIV
+#undef VMIN
+#undef VMAX
+#undef VFMADD
+#undef VFNMADD
+#undef FN
+
+#pragma GCC pop_options
+
+static int detect_isa(void) {
+  int isa = FD4T10S_ISA_SCALAR;
+  const char *env = getenv("FD4T10S_ISA");
+
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    isa = FD4T10S_ISA_AVX2;
+  }
+  if (isa == FD4T10S_ISA_AVX2 && __builtin_cpu_supports("avx512f")) {
+    isa = FD4T10S_ISA_AVX512;
+  }
+
+  /// the environment can only lower the level
+  if (env != NULL) {
+    int req = isa;
+    if (strcmp(env, "scalar") == 0) {
+      req = FD4T10S_ISA_SCALAR;
+    } else if (strcmp(env, "avx2") == 0) {
+      req = FD4T10S_ISA_AVX2;
+    }
+    isa = req < isa ? req : isa;
+  }
+
+  return isa;
+}
+
+#endif /* FD4T10S_X86_SIMD */
+
+static pthread_once_t isa_once = PTHREAD_ONCE_INIT;
+static int detected_isa = FD4T10S_ISA_SCALAR;
+static int isa = FD4T10S_ISA_SCALAR;
+
+/// the shot groups may ask for the level at the same time, it is detected by one of them
+static void init_isa(void) {
+#ifdef FD4T10S_X86_SIMD
+  detected_isa = detect_isa();
+#endif
+  isa = detected_isa;
+}
+
+int fd4t10s_simd_isa(void) {
+  pthread_once(&isa_once, init_isa);
+  return isa;
+}
+
+int fd4t10s_simd_set_isa(int level) {
+  pthread_once(&isa_once, init_isa);
+  isa = level < detected_isa ? level : detected_isa;
+  isa = isa > FD4T10S_ISA_SCALAR ? isa : FD4T10S_ISA_SCALAR;
+  return isa;
+}
+
+const char *fd4t10s_simd_isa_name(void) {
+  switch (fd4t10s_simd_isa()) {
+  case FD4T10S_ISA_AVX512:
+    return "avx512";
+  case FD4T10S_ISA_AVX2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+static void simd_step_box(const float *prev_wave, const float *curr_wave, float *next_wave,
+    const float *k1, const float *k2, const float *rv, const float *rv12, int nx, int nz,
+    int x0, int x1, int z0, int z1) {
+  const int d = 6;
+
+  /// the stencil needs d cells around every updated one
+  x0 = x0 > d ? x0 : d;
+  x1 = x1 < nx - d ? x1 : nx - d;
+  z0 = z0 > d ? z0 : d;
+  z1 = z1 < nz - d ? z1 : nz - d;
+  if (x0 >= x1 || z0 >= z1) {
+    return;
+  }
+
+  switch (fd4t10s_simd_isa()) {
+#ifdef FD4T10S_X86_SIMD
+  case FD4T10S_ISA_AVX512:
+    simd_step_avx512(prev_wave, curr_wave, next_wave, k1, k2, rv, rv12, nz, x0, x1, z0, z1);
+    break;
+  case FD4T10S_ISA_AVX2:
+    simd_step_avx2(prev_wave, curr_wave, next_wave, k1, k2, rv, rv12, nz, x0, x1, z0, z1);
+    break;
+#endif
+  default:
+    simd_step_scalar(prev_wave, curr_wave, next_wave, k1, k2, rv, rv12, nz, x0, x1, z0, z1);
+    break;
+  }
+}
+
+static void simd_step(const float *prev_wave, const float *curr_wave, float *next_wave,
+    const float *k1, const float *k2, const float *rv, const float *rv12, int nx, int nz) {
+  simd_step_box(prev_wave, curr_wave, next_wave, k1, k2, rv, rv12, nx, nz, 0, nx, 0, nz);
+}
+
+void fd4t10s_simd_damp_2d_vtrans(float *prev_wave, const float *curr_wave,
+    const float *k1, const float *k2, const float *rv, const float *rv12, int nx, int nz) {
+  simd_step(prev_wave, curr_wave, prev_wave, k1, k2, rv, rv12, nx, nz);
+}
+
+void fd4t10s_simd_damp_2d_vtrans_box(float *prev_wave, const float *curr_wave,
+    const float *k1, const float *k2, const float *rv, const float *rv12, int nx, int nz,
+    int x0, int x1, int z0, int z1) {
+  simd_step_box(prev_wave, curr_wave, prev_wave, k1, k2, rv, rv12, nx, nz, x0, x1, z0, z1);
+}
+
+void fd4t10s_simd_damp_2d_vtrans_batch_box(float *prev_wave, const float *curr_wave,
+    const float *k1, const float *k2, const float *rv, const float *rv12, int nx, int nz, int nbat,
+    int x0, int x1, int z0, int z1) {
+  const int d = 6;
+
+  x0 = x0 > d ? x0 : d;
+  x1 = x1 < nx - d ? x1 : nx - d;
+  z0 = z0 > d ? z0 : d;
+  z1 = z1 < nz - d ? z1 : nz - d;
+  if (x0 >= x1 || z0 >= z1) {
+    return;
+  }
+
+  /// the batch is the vector dimension, a partial 16 wide vector is better done as 8 wide ones
+  switch (fd4t10s_simd_isa()) {
+#ifdef FD4T10S_X86_SIMD
+  case FD4T10S_ISA_AVX512:
+    if (nbat % 16 != 0) {
+      batch_step_avx2(prev_wave, curr_wave, prev_wave, k1, k2, rv, rv12, nz, nbat, x0, x1, z0, z1);
+      break;
+    }
+    batch_step_avx512(prev_wave, curr_wave, prev_wave, k1, k2, rv, rv12, nz, nbat, x0, x1, z0, z1);
+    break;
+  case FD4T10S_ISA_AVX2:
+    batch_step_avx2(prev_wave, curr_wave, prev_wave, k1, k2, rv, rv12, nz, nbat, x0, x1, z0, z1);
+    break;
+#endif
+  default:
+    batch_step_scalar(prev_wave, curr_wave, prev_wave, k1, k2, rv, rv12, nz, nbat, x0, x1, z0, z1);
+    break;
+  }
+}
+
+void fd4t10s_simd_damp_2d_vtrans_models_box(float *const *prev_wave, const float *const *curr_wave,
+    const float *k1, const float *k2, const float *vel, const float *dvel, const float *alpha, int nmod,
+    float vmin, float vmax, int nx, int nz, int x0, int x1, int z0, int z1) {
+  const int d = 6;
+
+  x0 = x0 > d ? x0 : d;
+  x1 = x1 < nx - d ? x1 : nx - d;
+  z0 = z0 > d ? z0 : d;
+  z1 = z1 < nz - d ? z1 : nz - d;
+  if (x0 >= x1 || z0 >= z1 || nmod <= 0) {
+    return;
+  }
+
+  switch (fd4t10s_simd_isa()) {
+#ifdef FD4T10S_X86_SIMD
+  case FD4T10S_ISA_AVX512:
+    models_step_avx512(prev_wave, curr_wave, k1, k2, vel, dvel, alpha, nmod, vmin, vmax, nz, x0, x1, z0, z1);
+    break;
+  case FD4T10S_ISA_AVX2:
+    models_step_avx2(prev_wave, curr_wave, k1, k2, vel, dvel, alpha, nmod, vmin, vmax, nz, x0, x1, z0, z1);
+    break;
+#endif
+  default:
+    models_step_scalar(prev_wave, curr_wave, k1, k2, vel, dvel, alpha, nmod, vmin, vmax, nz, x0, x1, z0, z1);
+    break;
+  }
+}
+
+void fd4t10s_simd_2d_vtrans(float *prev_wave, const float *curr_wave, const float *rv, const float *rv12, int nx, int nz) {
+  simd_step(prev_wave, curr_wave, prev_wave, NULL, NULL, rv, rv12, nx, nz);
+}
+
+void fd4t10s_simd_2d_vtrans_3vars(const float *prev_wave, const float *curr_wave, float *next_wave,
+    const float *rv, const float *rv12, int nx, int nz) {
+  simd_step(prev_wave, curr_wave, next_wave, NULL, NULL, rv, rv12, nx, nz);
+}
+
+void fd4t10s_simd_adjoint_2d_vtrans(float *sp_prev, const float *sp_curr, float *gp_prev, const float *gp_curr,
+    const float *k1, const float *k2, const float *rv, const float *rv12,
+    float *image, float scale, int nx, int nz) {
+  fd4t10s_simd_adjoint_2d_vtrans_box(sp_prev, sp_curr, gp_prev, gp_curr, k1, k2, rv, rv12, image, scale, nx, nz,
+      0, nx, 0, nz);
+}
+
+void fd4t10s_simd_adjoint_2d_vtrans_box(float *sp_prev, const float *sp_curr, float *gp_prev, const float *gp_curr,
+    const float *k1, const float *k2, const float *rv, const float *rv12,
+    float *image, float scale, int nx, int nz, int gx0, int gx1, int gz0, int gz1) {
+  const int d = 6;
+
+  gx0 = gx0 > d ? gx0 : d;
+  gx1 = gx1 < nx - d ? gx1 : nx - d;
+  gz0 = gz0 > d ? gz0 : d;
+  gz1 = gz1 < nz - d ? gz1 : nz - d;
+
+  switch (fd4t10s_simd_isa()) {
+#ifdef FD4T10S_X86_SIMD
+  case FD4T10S_ISA_AVX512:
+    adjoint_step_avx512(sp_prev, sp_curr, gp_prev, gp_curr, k1, k2, rv, rv12, image, scale, nx, nz, gx0, gx1, gz0, gz1);
+    break;
+  case FD4T10S_ISA_AVX2:
+    adjoint_step_avx2(sp_prev, sp_curr, gp_prev, gp_curr, k1, k2, rv, rv12, image, scale, nx, nz, gx0, gx1, gz0, gz1);
+    break;
+#endif
+  default:
+    adjoint_step_scalar(sp_prev, sp_curr, gp_prev, gp_curr, k1, k2, rv, rv12, image, scale, nx, nz, gx0, gx1, gz0, gz1);
+    break;
+  }
+  fd4t10s_correlate_frame(image, sp_prev, gp_curr, scale, nx, nz, d);
+}
@@ -0,0 +1,96 @@
+/*
+ * fd4t10s-simd.h
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+#ifndef SRC_MODELING_FD4T10S_SIMD_H_
+#define SRC_MODELING_FD4T10S_SIMD_H_
+
+enum {
+  FD4T10S_ISA_SCALAR = 0,
+  FD4T10S_ISA_AVX2 = 1,
+  FD4T10S_ISA_AVX512 = 2
+};
+
+/**
+ * instruction set used by the fd4t10s_simd_* kernels, it is detected once at
+ * run time. set FD4T10S_ISA=scalar|avx2|avx512 in the environment to force a
+ * lower level.
+ */
+int fd4t10s_simd_isa(void);
+const char *fd4t10s_simd_isa_name(void);
+/**
+ * use the instruction set level, or the detected one if it is lower, and
+ * return the level now in use. the kernels read the level on every call, so
+ * it must not change while a propagation runs. it is meant for tests that
+ * compare the levels
+ */
+int fd4t10s_simd_set_isa(int level);
+
+/**
+ * hand vectorized versions of the kernels in fd4t10s-fused.h. instead of the
+ * velocity they read the coefficient planes of fd4t10s-coef.h, so the inner
+ * loop is loads and fma only.
+ * all the arithmetic is done in single precision, so the wavefields differ
+ * from the fused kernels by rounding only. the avx2 and avx512 versions agree
+ * with each other bit by bit, the portable scalar version does not use fma.
+ */
+void fd4t10s_simd_damp_2d_vtrans(float *prev_wave, const float *curr_wave,
+    const float *k1, const float *k2, const float *rv, const float *rv12, int nx, int nz);
+/**
+ * fd4t10s_simd_damp_2d_vtrans restricted to columns [x0, x1) and rows [z0, z1),
+ * the points outside keep prev_wave. the box is clipped to the stencil reach
+ */
+void fd4t10s_simd_damp_2d_vtrans_box(float *prev_wave, const float *curr_wave,
+    const float *k1, const float *k2, const float *rv, const float *rv12, int nx, int nz,
+    int x0, int x1, int z0, int z1);
+/**
+ * fd4t10s_simd_damp_2d_vtrans_box for nbat wavefields sharing the velocity,
+ * interleaved as [ix][iz][b] (point (ix, iz) of wavefield b is at
+ * (ix * nz + iz) * nbat + b). the coefficients of a point are loaded once for
+ * the nbat wavefields, which are the vector lanes. every wavefield gets the
+ * arithmetic fd4t10s_simd_damp_2d_vtrans_box does on it alone, so a lane is
+ * bit for bit the wavefield propagated alone. nbat should be a multiple of 8,
+ * the rest of the lanes is scalar
+ */
+void fd4t10s_simd_damp_2d_vtrans_batch_box(float *prev_wave, const float *curr_wave,
+    const float *k1, const float *k2, const float *rv, const float *rv12, int nx, int nz, int nbat,
+    int x0, int x1, int z0, int z1);
+/**
+ * fd4t10s_simd_damp_2d_vtrans_box for nmod wavefields of the same shape, each
+ * in its own velocity model: wavefield m sees the transformed velocity
+ * clip(vel + alpha[m] * dvel, vmin, vmax). the velocity update and the
+ * coefficients of fd4t10s-coef.h are computed in the sweep from vel and dvel,
+ * the result is bit for bit the one of fd4t10s_simd_damp_2d_vtrans_box on the
+ * coefficient planes of the updated model. the models share the loads of k1,
+ * k2, vel and dvel
+ */
+void fd4t10s_simd_damp_2d_vtrans_models_box(float *const *prev_wave, const float *const *curr_wave,
+    const float *k1, const float *k2, const float *vel, const float *dvel, const float *alpha, int nmod,
+    float vmin, float vmax, int nx, int nz, int x0, int x1, int z0, int z1);
+void fd4t10s_simd_2d_vtrans(float *prev_wave, const float *curr_wave, const float *rv, const float *rv12, int nx, int nz);
+void fd4t10s_simd_2d_vtrans_3vars(const float *prev_wave, const float *curr_wave, float *next_wave,
+    const float *rv, const float *rv12, int nx, int nz);
+
+/**
+ * one time step of the gradient backward loop in a single sweep:
+ * sp_prev gets the undamped step of the source wavefield (fd4t10s_simd_2d_vtrans),
+ * gp_prev the damped step of the receiver wavefield (fd4t10s_simd_damp_2d_vtrans),
+ * and image -= sp_prev * gp_curr * scale over the whole grid, that is the new
+ * source wavefield against the receiver wavefield before the step
+ */
+void fd4t10s_simd_adjoint_2d_vtrans(float *sp_prev, const float *sp_curr, float *gp_prev, const float *gp_curr,
+    const float *k1, const float *k2, const float *rv, const float *rv12,
+    float *image, float scale, int nx, int nz);
+/**
+ * fd4t10s_simd_adjoint_2d_vtrans with the receiver wavefield restricted to
+ * columns [gx0, gx1) and rows [gz0, gz1): the points outside keep gp_prev and
+ * are not correlated, the source wavefield is stepped on the whole grid
+ */
+void fd4t10s_simd_adjoint_2d_vtrans_box(float *sp_prev, const float *sp_curr, float *gp_prev, const float *gp_curr,
+    const float *k1, const float *k2, const float *rv, const float *rv12,
+    float *image, float scale, int nx, int nz, int gx0, int gx1, int gz0, int gz1);
+
+#endif /* SRC_MODELING_FD4T10S_SIMD_H_ */
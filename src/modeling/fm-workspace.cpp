@@ -0,0 +1,42 @@
+/*
+ * fm-workspace.cpp
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+#include <cstdlib>
+#include "fm-workspace.h"
+#include "logger.h"
+
+FmWorkspace::FmWorkspace() : cpmls(MAXCPML) {
+}
+
+FmWorkspace::FmWorkspace(const FmWorkspace &) : cpmls(MAXCPML) {
+}
+
+FmWorkspace &FmWorkspace::operator=(const FmWorkspace &) {
+  return *this;
+}
+
+float *FmWorkspace::u2(int size) {
+  if (static_cast<int>(u2buf.size()) != size) {
+    u2buf.assign(size, 0);
+  }
+  return &u2buf[0];
+}
+
+std::vector<float> &FmWorkspace::p2(int size) {
+  if (static_cast<int>(p2buf.size()) != size) {
+    p2buf.assign(size, 0);
+  }
+  return p2buf;
+}
+
+CPML &FmWorkspace::cpml(int cpmlId) {
+  if (cpmlId < 0 || cpmlId >= MAXCPML) {
+    ERROR() << __PRETTY_FUNCTION__ << ": invalid cpml id " << cpmlId;
+    exit(1);
+  }
+  return cpmls[cpmlId];
+}
@@ -0,0 +1,42 @@
+/*
+ * fm-workspace.h
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+#ifndef SRC_MODELING_FM_WORKSPACE_H_
+#define SRC_MODELING_FM_WORKSPACE_H_
+
+#include <vector>
+#include "cpml.h"
+
+/**
+ * scratch state of one propagation: the u2 plane of the two pass kernels,
+ * the next wavefield of the CPML step and the CPML memory variables.
+ *
+ * a ForwardModeling can be shared by several threads as long as every
+ * propagation uses its own workspace. the buffers are sized on demand, and a
+ * copy starts empty because the scratch of a running propagation is
+ * meaningless to another one.
+ */
+class FmWorkspace {
+public:
+  FmWorkspace();
+  FmWorkspace(const FmWorkspace &other);
+  FmWorkspace &operator=(const FmWorkspace &other);
+
+  float *u2(int size);
+  std::vector<float> &p2(int size);
+  CPML &cpml(int cpmlId);
+
+public:
+  const static int MAXCPML = 2;
+
+private:
+  std::vector<float> u2buf;
+  std::vector<float> p2buf;
+  std::vector<CPML> cpmls;
+};
+
+#endif /* SRC_MODELING_FM_WORKSPACE_H_ */
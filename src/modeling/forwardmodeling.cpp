@@ -6,12 +6,14 @@
  */
 
 #include <cmath>
+#include <algorithm>
 #include <functional>
 #include "forwardmodeling.h"
 #include "logger.h"
 #include "sum.h"
 #include "sfutil.h"
 #include "common.h"
+#include "profiler.h"
 
 extern "C" {
 #include <rsf.h>
@@ -19,10 +21,13 @@ extern "C" {
 #include "fd4t10s-damp-zjh.h"
 #include "fd4t10s-zjh.h"
 #include "fd4t10s-nobndry.h"
+#include "fd4t10s-fused.h"
+#include "fd4t10s-simd.h"
+#include "fd4t10s-coef.h"
 }
 
 CPML* ForwardModeling::getCPML(int cpmlId) const{
-	return cpml[cpmlId];
+	return &workspace.cpml(cpmlId);
 }
 
 void ForwardModeling::initFdUtil(sf_file &vinit, Velocity *v, int nb, float dx, float dt) {
@@ -240,10 +245,24 @@ void ForwardModeling::addBornwv(float *fullwv_t0, float *fullwv_t1, float *fullw
 }
 
 void ForwardModeling::stepForward(std::vector<float> &p0, std::vector<float> &p1) const {
-  static std::vector<float> u2(vel->nx * vel->nz, 0);
+  stepForward(workspace, p0, p1);
+}
+
+void ForwardModeling::stepForward(FmWorkspace &ws, std::vector<float> &p0, std::vector<float> &p1) const {
+  PROFILE("stencil");
+  if (fdEngine == FD_SIMD) {
+    fd4t10s_simd_damp_2d_vtrans(&p0[0], &p1[0], &dampK1[0], &dampK2[0], &velRv[0], &velRv12[0], vel->nx, vel->nz);
+    return;
+  }
+  if (fdEngine == FD_FUSED) {
+    fd4t10s_fused_damp_2d_vtrans(&p0[0], &p1[0], &vel->dat[0], vel->nx, vel->nz, bx0, freeSurface);
+    return;
+  }
+
+  float *u2 = ws.u2(vel->nx * vel->nz);
 
 	//damp
-  fd4t10s_damp_zjh_2d_vtrans(&p0[0], &p1[0], &vel->dat[0], &u2[0], vel->nx, vel->nz, bx0, freeSurface);
+  fd4t10s_damp_zjh_2d_vtrans(&p0[0], &p1[0], &vel->dat[0], u2, vel->nx, vel->nz, bx0, freeSurface);
 	
 	//sponge
   //fd4t10s_nobndry_2d_vtrans(&p0[0], &p1[0], &vel->dat[0], &u2[0], vel->nx, vel->nz, bx0, freeSurface);
@@ -260,17 +279,159 @@ void ForwardModeling::stepForward(std::vector<float> &p0, std::vector<float> &p1
 
 }
 
+void ForwardModeling::stepForward(FmWorkspace &ws, std::vector<float> &p0, std::vector<float> &p1, Box &box) const {
+  /// the two pass kernels always sweep the whole grid
+  if (fdEngine != FD_SIMD && fdEngine != FD_FUSED) {
+    stepForward(ws, p0, p1);
+    return;
+  }
+
+  PROFILE("stencil");
+  if (fdEngine == FD_SIMD) {
+    fd4t10s_simd_damp_2d_vtrans_box(&p0[0], &p1[0], &dampK1[0], &dampK2[0], &velRv[0], &velRv12[0], vel->nx, vel->nz,
+        box.x0, box.x1, box.z0, box.z1);
+  } else {
+    fd4t10s_fused_damp_2d_vtrans_box(&p0[0], &p1[0], &vel->dat[0], vel->nx, vel->nz, bx0, freeSurface,
+        box.x0, box.x1, box.z0, box.z1);
+  }
+  growBox(box, &p0[0], 1);
+}
+
 void ForwardModeling::stepForward(std::vector<float> &p0, std::vector<float> &p1, int cpmlId) const {
-  static std::vector<float> u2(vel->nx * vel->nz, 0);
-  static std::vector<float> p2(vel->nx * vel->nz, 0);
+  stepForward(workspace, p0, p1, cpmlId);
+}
 
-  fd4t10s_nobndry_2d_vtrans_3vars(&p0[0], &p1[0], &p2[0], &vel->dat[0], &u2[0], vel->nx, vel->nz, bx0, freeSurface);
-	cpml[cpmlId]->applyCPML(&p0[0], &p1[0], &p2[0], &vel->dat[0], vel->nx, vel->nz, *this);
+void ForwardModeling::stepForward(FmWorkspace &ws, std::vector<float> &p0, std::vector<float> &p1, int cpmlId) const {
+  PROFILE("stencil");
+  std::vector<float> &p2 = ws.p2(vel->nx * vel->nz);
+
+  if (fdEngine == FD_SIMD) {
+    fd4t10s_simd_2d_vtrans_3vars(&p0[0], &p1[0], &p2[0], &velRv[0], &velRv12[0], vel->nx, vel->nz);
+  } else if (fdEngine == FD_FUSED) {
+    fd4t10s_fused_2d_vtrans_3vars(&p0[0], &p1[0], &p2[0], &vel->dat[0], vel->nx, vel->nz);
+  } else {
+    float *u2 = ws.u2(vel->nx * vel->nz);
+    fd4t10s_nobndry_2d_vtrans_3vars(&p0[0], &p1[0], &p2[0], &vel->dat[0], u2, vel->nx, vel->nz, bx0, freeSurface);
+  }
+	{
+		PROFILE("cpml");
+		ws.cpml(cpmlId).applyCPML(&p0[0], &p1[0], &p2[0], &vel->dat[0], vel->nx, vel->nz, *this);
+	}
 	std::swap(p0, p2);
 }
 
 void ForwardModeling::bindVelocity(const Velocity& _vel) {
   this->vel = &_vel;
+
+  int size = vel->nx * vel->nz;
+  if (static_cast<int>(dampK1.size()) != size) {
+    dampK1.resize(size);
+    dampK2.resize(size);
+    fd4t10s_damp_coef(&dampK1[0], &dampK2[0], vel->nx, vel->nz, bx0, freeSurface);
+  }
+
+  refreshVelocity();
+}
+
+void ForwardModeling::bindShotPosition(const ShotPosition &_allSrcPos, const ShotPosition &_allGeoPos) {
+  this->allSrcPos = &_allSrcPos;
+  this->allGeoPos = &_allGeoPos;
+}
+
+/**
+ * rebuild the velocity planes, call it after the bound velocity is modified in place
+ */
+void ForwardModeling::refreshVelocity() {
+  int size = vel->nx * vel->nz;
+  velRv.resize(size);
+  velRv12.resize(size);
+  fd4t10s_vel_coef(&velRv[0], &velRv12[0], &vel->dat[0], size);
+}
+
+void ForwardModeling::setFdEngine(FdEngine engine) {
+  this->fdEngine = engine;
+}
+
+void ForwardModeling::setActiveRegion(bool on) {
+  this->activeRegion = on;
+}
+
+/// grow box to cover b too
+static void unite(ForwardModeling::Box &box, const ForwardModeling::Box &b) {
+  box.x0 = std::min(box.x0, b.x0);
+  box.x1 = std::max(box.x1, b.x1);
+  box.z0 = std::min(box.z0, b.z0);
+  box.z1 = std::max(box.z1, b.z1);
+}
+
+/**
+ * a step of fd4t10s reads STENCIL_REACH cells around a cell. the box keeps the
+ * non zero cells at least that far inside its edges, except the edges of the
+ * grid, so the cells outside it only see zeros and stay zero in the whole grid
+ * propagation too: the result does not depend on the box. growBox moves an
+ * edge out as soon as the wavefield comes within STENCIL_REACH cells of it
+ */
+ForwardModeling::Box ForwardModeling::activeBox(const ShotPosition &pos) const {
+  int nx = vel->nx;
+  int nz = vel->nz;
+  Box box = { 0, nx, 0, nz };
+  if (!activeRegion || fdEngine == FD_TWO_PASS || pos.ns == 0) {
+    return box;
+  }
+
+  int xmin = nx, xmax = 0, zmin = nz, zmax = 0;
+  for (int is = 0; is < pos.ns; is++) {
+    int sx = pos.getx(is) + bx0;
+    int sz = pos.getz(is) + bz0;
+    xmin = std::min(xmin, sx);
+    xmax = std::max(xmax, sx);
+    zmin = std::min(zmin, sz);
+    zmax = std::max(zmax, sz);
+  }
+
+  box.x0 = std::max(0, xmin - STENCIL_REACH);
+  box.x1 = std::min(nx, xmax + STENCIL_REACH + 1);
+  box.z0 = std::max(0, zmin - STENCIL_REACH);
+  box.z1 = std::min(nz, zmax + STENCIL_REACH + 1);
+  return box;
+}
+
+/// any non zero value in columns [x0, x1) and rows [z0, z1) of nlanes interleaved wavefields
+static bool anyNonZero(const float *p, int nz, int nlanes, int x0, int x1, int z0, int z1) {
+  for (int ix = x0; ix < x1; ix++) {
+    const float *col = p + ((size_t)ix * nz + z0) * nlanes;
+    int n = (z1 - z0) * nlanes;
+    for (int i = 0; i < n; i++) {
+      if (col[i] != 0) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * only the bands of STENCIL_REACH cells along the edges are read, an edge
+ * with a non zero value in its band moves out by STENCIL_REACH cells
+ */
+void ForwardModeling::growBox(Box &box, const float *p, int nlanes) const {
+  const int r = STENCIL_REACH;
+  int nx = vel->nx;
+  int nz = vel->nz;
+  Box b = box;
+
+  if (b.x0 > 0 && anyNonZero(p, nz, nlanes, b.x0, std::min(b.x0 + r, b.x1), b.z0, b.z1)) {
+    box.x0 = std::max(0, b.x0 - r);
+  }
+  if (b.x1 < nx && anyNonZero(p, nz, nlanes, std::max(b.x1 - r, b.x0), b.x1, b.z0, b.z1)) {
+    box.x1 = std::min(nx, b.x1 + r);
+  }
+  if (b.z0 > 0 && anyNonZero(p, nz, nlanes, b.x0, b.x1, b.z0, std::min(b.z0 + r, b.z1))) {
+    box.z0 = std::max(0, b.z0 - r);
+  }
+  if (b.z1 < nz && anyNonZero(p, nz, nlanes, b.x0, b.x1, std::max(b.z1 - r, b.z0), b.z1)) {
+    box.z1 = std::min(nz, b.z1 + r);
+  }
 }
 
 void ForwardModeling::bindRealVelocity(const Velocity& _vel) {
@@ -303,8 +464,52 @@ const Velocity& ForwardModeling::getVelocity() const {
 }
 
 void ForwardModeling::stepBackward(float* p0, float* p1) const {
-  static std::vector<float> u2(vel->nx * vel->nz, 0);
-  fd4t10s_zjh_2d_vtrans(p0, p1, &vel->dat[0], &u2[0], vel->nx, vel->nz);
+  stepBackward(workspace, p0, p1);
+}
+
+void ForwardModeling::stepBackward(FmWorkspace &ws, float* p0, float* p1) const {
+  PROFILE("stencil");
+  if (fdEngine == FD_SIMD) {
+    fd4t10s_simd_2d_vtrans(p0, p1, &velRv[0], &velRv12[0], vel->nx, vel->nz);
+    return;
+  }
+  if (fdEngine == FD_FUSED) {
+    fd4t10s_fused_2d_vtrans(p0, p1, &vel->dat[0], vel->nx, vel->nz);
+    return;
+  }
+
+  fd4t10s_zjh_2d_vtrans(p0, p1, &vel->dat[0], ws.u2(vel->nx * vel->nz), vel->nx, vel->nz);
+}
+
+void ForwardModeling::stepAdjoint(FmWorkspace &ws, float *sp0, float *sp1, float *gp0, float *gp1,
+    float *image, float scale, Box &gbox) const {
+  PROFILE("adjoint stencil");
+  int nx = vel->nx;
+  int nz = vel->nz;
+
+  if (fdEngine == FD_SIMD) {
+    fd4t10s_simd_adjoint_2d_vtrans_box(sp0, sp1, gp0, gp1, &dampK1[0], &dampK2[0], &velRv[0], &velRv12[0],
+        image, scale, nx, nz, gbox.x0, gbox.x1, gbox.z0, gbox.z1);
+    growBox(gbox, gp0, 1);
+    return;
+  }
+  if (fdEngine == FD_FUSED) {
+    fd4t10s_fused_adjoint_2d_vtrans_box(sp0, sp1, gp0, gp1, &vel->dat[0], image, scale, nx, nz, bx0, freeSurface,
+        gbox.x0, gbox.x1, gbox.z0, gbox.z1);
+    growBox(gbox, gp0, 1);
+    return;
+  }
+
+  float *u2 = ws.u2(nx * nz);
+  fd4t10s_zjh_2d_vtrans(sp0, sp1, &vel->dat[0], u2, nx, nz);
+  fd4t10s_damp_zjh_2d_vtrans(gp0, gp1, &vel->dat[0], u2, nx, nz, bx0, freeSurface);
+
+#ifdef USE_OPENMP
+  #pragma omp parallel for
+#endif
+  for (int i = 0; i < nx * nz; i++) {
+    image[i] -= sp0[i] * gp1[i] * scale;
+  }
 }
 
 void ForwardModeling::addSource(float* p, const float* source,
@@ -386,6 +591,19 @@ void ForwardModeling::refillBoundary(float* gradient) const {
   }
 }
 
+Velocity ForwardModeling::recoverDomain() const {
+  int nzpad = vel->nz;
+  int nx = vel->nx - bx0 - bxn;
+  int nz = nzpad - bz0 - bzn;
+
+  Velocity ret(nx, nz);
+  for (int ix = 0; ix < nx; ix++) {
+    std::copy(&vel->dat[(bx0 + ix) * nzpad + bz0], &vel->dat[(bx0 + ix) * nzpad + bz0 + nz], &ret.dat[ix * nz]);
+  }
+  recoverVel(ret.dat, dx, dt);
+  return ret;
+}
+
 void ForwardModeling::sfWriteVel(const std::vector<float> &exvel, sf_file file) const {
   //assert(exvel.size() == vel->dat.size());
   int nzpad = vel->nz;
@@ -402,6 +620,7 @@ void ForwardModeling::sfWriteVel(const std::vector<float> &exvel, sf_file file)
 void ForwardModeling::refillVelStencilBndry() {
   Velocity &exvel = getVelocity();
   fillForStencil(exvel, EXFDBNDRYLEN);
+  refreshVelocity();
 }
 
 void ForwardModeling::FwiForwardModeling(const std::vector<float>& encSrc,
@@ -413,6 +632,7 @@ void ForwardModeling::FwiForwardModeling(const std::vector<float>& encSrc,
 
   std::vector<float> p0(nz * nx, 0);
   std::vector<float> p1(nz * nx, 0);
+  FmWorkspace ws;
   ShotPosition curSrcPos = allSrcPos->clipRange(shot_id, shot_id);
 
   /*
@@ -436,6 +656,7 @@ void ForwardModeling::FwiForwardModeling(const std::vector<float>& encSrc,
 	sf_floatread(const_cast<float*>(&p1[0]), nz * nx, sf_p1);
   */
 
+  Box box = activeBox(curSrcPos);
   for(int it=0; it<nt; it++) {
     addSource(&p1[0], &encSrc[it], curSrcPos);
 
@@ -452,7 +673,7 @@ void ForwardModeling::FwiForwardModeling(const std::vector<float>& encSrc,
     exit(1);
     */
 
-    stepForward(p0,p1);
+    stepForward(ws, p0, p1, box);
 
     /*
     sf_file sf_p0 = sf_output("pp0.rsf");
@@ -520,6 +741,7 @@ void ForwardModeling::BornForwardModeling(const std::vector<float> &exvel_m, con
   std::vector<float> p1(nz * nx, 0);
   std::vector<float> rp0(nz * nx, 0);
   std::vector<float> rp1(nz * nx, 0);
+  FmWorkspace ws;
 	float *fullwv_t0, *fullwv_t1, *fullwv_t2, *fullwv_t;	
 	fullwv_t0 = &fullwv[0];
 	fullwv_t1 = &fullwv[nz * nx];
@@ -529,7 +751,7 @@ void ForwardModeling::BornForwardModeling(const std::vector<float> &exvel_m, con
 	int it = 0;
 	for(int it0 = 0 ; it0 < nt + 1 ; it0 ++) {
 		addSource(&p1[0], &encSrc[it0], curSrcPos);
-		stepForward(p0,p1);
+		stepForward(ws, p0, p1);
 		std::swap(p1, p0);
 		swap3(fullwv_t0, fullwv_t1, fullwv_t2);
 		std::copy(p0.begin(), p0.end(), fullwv_t2);
@@ -539,12 +761,142 @@ void ForwardModeling::BornForwardModeling(const std::vector<float> &exvel_m, con
 			continue;
 		addBornwv(fullwv_t0, fullwv_t1, fullwv_t2, &exvel_m[0], dt, it, &rp1[0]);
 		//fmMethod.addSource(&p1[0], &wlt[it], curSrcPos);
-		stepForward(rp0,rp1);
+		stepForward(ws, rp0, rp1);
 		std::swap(rp1, rp0);
 		recordSeis(&dcal[it*ng], &rp0[0]);
 	}
 }
 
+/**
+ * the shots advance together in the interleaved layout of
+ * fd4t10s_simd_damp_2d_vtrans_batch_box over one active box, which grows
+ * with the wavefields of all the shots.
+ * the batch is the vector dimension of the kernel, so only whole groups of
+ * BATCH_LANES shots are batched, the other shots and the engines without a
+ * batch kernel run one by one
+ */
+void ForwardModeling::FwiForwardModeling(const std::vector<float> &encSrc,
+    std::vector<std::vector<float> > &dcal, const std::vector<int> &shot_ids) const {
+  int nbat = fdEngine == FD_SIMD ? shot_ids.size() / BATCH_LANES * BATCH_LANES : 0;
+  for (int ib = nbat; ib < static_cast<int>(shot_ids.size()); ib++) {
+    FwiForwardModeling(encSrc, dcal[ib], shot_ids[ib]);
+  }
+  if (nbat == 0) {
+    return;
+  }
+
+  int nx = getnx();
+  int nz = getnz();
+  int ng = getng();
+
+  std::vector<float> p0((size_t)nz * nx * nbat, 0);
+  std::vector<float> p1((size_t)nz * nx * nbat, 0);
+  std::vector<ShotPosition> srcPos;
+  std::vector<int> srcIdx(nbat);
+  for (int ib = 0; ib < nbat; ib++) {
+    srcPos.push_back(allSrcPos->clip(shot_ids[ib]));
+    srcIdx[ib] = (srcPos[ib].getx(0) + bx0) * nz + srcPos[ib].getz(0) + bz0;
+  }
+  std::vector<int> geoIdx(ng);
+  for (int ig = 0; ig < ng; ig++) {
+    geoIdx[ig] = (allGeoPos->getx(ig) + bx0) * nz + allGeoPos->getz(ig) + bz0;
+  }
+
+  Box box = activeBox(srcPos[0]);
+  for (int ib = 1; ib < nbat; ib++) {
+    unite(box, activeBox(srcPos[ib]));
+  }
+
+  for (int it = 0; it < nt; it++) {
+    for (int ib = 0; ib < nbat; ib++) {
+      p1[(size_t)srcIdx[ib] * nbat + ib] += encSrc[it];
+    }
+
+    {
+      PROFILE("batch stencil");
+      fd4t10s_simd_damp_2d_vtrans_batch_box(&p0[0], &p1[0], &dampK1[0], &dampK2[0], &velRv[0], &velRv12[0],
+          nx, nz, nbat, box.x0, box.x1, box.z0, box.z1);
+    }
+    growBox(box, &p0[0], nbat);
+    std::swap(p1, p0);
+
+    for (int ib = 0; ib < nbat; ib++) {
+      float *seis = &dcal[ib][it * ng];
+      for (int ig = 0; ig < ng; ig++) {
+        seis[ig] = p0[(size_t)geoIdx[ig] * nbat + ib];
+      }
+    }
+  }
+}
+
+static inline float updatedVelocity(float vel, float dvel, float alpha, float vmin, float vmax) {
+  float v = vel + alpha * dvel;
+  v = v > vmax ? vmax : v;
+  return v < vmin ? vmin : v;
+}
+
+/**
+ * the models advance together in fd4t10s_simd_damp_2d_vtrans_models_box over
+ * one active box, which grows with the wavefields of all the models. the
+ * engines without a models kernel model them one by one on an updated copy of
+ * the velocity
+ */
+void ForwardModeling::FwiForwardModeling(const std::vector<float> &encSrc, const std::vector<float> &dvel,
+    const std::vector<float> &alpha, float vmin, float vmax, std::vector<std::vector<float> > &dcal, int shot_id) const {
+  int nx = getnx();
+  int nz = getnz();
+  int ng = getng();
+  int nmod = alpha.size();
+  const std::vector<float> &v = vel->dat;
+
+  if (fdEngine != FD_SIMD) {
+    for (int im = 0; im < nmod; im++) {
+      Velocity newVel(nx, nz);
+      for (int i = 0; i < nx * nz; i++) {
+        newVel.dat[i] = updatedVelocity(v[i], dvel[i], alpha[im], vmin, vmax);
+      }
+      ForwardModeling updateMethod = *this;
+      updateMethod.bindVelocity(newVel);
+      updateMethod.FwiForwardModeling(encSrc, dcal[im], shot_id);
+    }
+    return;
+  }
+
+  std::vector<std::vector<float> > p((size_t)2 * nmod, std::vector<float>(nz * nx, 0));
+  std::vector<float *> p0(nmod);
+  std::vector<float *> p1(nmod);
+  for (int im = 0; im < nmod; im++) {
+    p0[im] = &p[2 * im][0];
+    p1[im] = &p[2 * im + 1][0];
+  }
+  ShotPosition curSrcPos = allSrcPos->clipRange(shot_id, shot_id);
+  Box box = activeBox(curSrcPos);
+
+  for (int it = 0; it < nt; it++) {
+    for (int im = 0; im < nmod; im++) {
+      addSource(p1[im], &encSrc[it], curSrcPos);
+    }
+
+    {
+      PROFILE("models stencil");
+      fd4t10s_simd_damp_2d_vtrans_models_box(&p0[0], &p1[0], &dampK1[0], &dampK2[0], &v[0], &dvel[0],
+          &alpha[0], nmod, vmin, vmax, nx, nz, box.x0, box.x1, box.z0, box.z1);
+    }
+    Box next = box;
+    for (int im = 0; im < nmod; im++) {
+      Box b = box;
+      growBox(b, p0[im], 1);
+      unite(next, b);
+    }
+    box = next;
+    std::swap(p1, p0);
+
+    for (int im = 0; im < nmod; im++) {
+      recordSeis(&dcal[im][it * ng], p0[im]);
+    }
+  }
+}
+
 void ForwardModeling::EssForwardModeling(const std::vector<float>& encSrc,
     std::vector<float>& dcal) const {
   int nx = getnx();
@@ -554,10 +906,12 @@ void ForwardModeling::EssForwardModeling(const std::vector<float>& encSrc,
 
   std::vector<float> p0(nz * nx, 0);
   std::vector<float> p1(nz * nx, 0);
+  FmWorkspace ws;
 
+  Box box = activeBox(*allSrcPos);
   for(int it=0; it<nt; it++) {
     addEncodedSource(&p1[0], &encSrc[it * ns]);
-    stepForward(p0,p1);
+    stepForward(ws, p0, p1, box);
     std::swap(p1, p0);
     recordSeis(&dcal[it*ng], &p0[0]);
   }
@@ -631,7 +985,7 @@ void ForwardModeling::removeDirectArrival(const ShotPosition &allSrcPos, const S
     int end = ((t + 2 * half_len) > nt) ? nt : (t + 2 * half_len);
 
     for (int j = start; j < end; j ++) {
-      data[itr * nt + j] = 0.f;
+      data[j * ng + itr] = 0.f;
     }
   }
 
@@ -640,7 +994,8 @@ void ForwardModeling::removeDirectArrival(const ShotPosition &allSrcPos, const S
 ForwardModeling::ForwardModeling(const ShotPosition& _allSrcPos, const ShotPosition& _allGeoPos,
     float _dt, float _dx, float _fm, int _nb, int _nt, int _freeSurface) :
       vel(NULL), allSrcPos(&_allSrcPos), allGeoPos(&_allGeoPos),
-      dt(_dt), dx(_dx), fm(_fm),  nt(_nt), freeSurface(_freeSurface)
+      dt(_dt), dx(_dx), fm(_fm),  nt(_nt), freeSurface(_freeSurface), fdEngine(FD_SIMD),
+      activeRegion(false)
 {
 	if(freeSurface)
 		bz0 = EXFDBNDRYLEN;
@@ -651,10 +1006,7 @@ ForwardModeling::ForwardModeling(const ShotPosition& _allSrcPos, const ShotPosit
 	spng = new Sponge();
   spng->initbndr(bndr.size());
 
-	const int MAXCPML = 2;
-	cpml = new CPML*[MAXCPML];
-	for(int i = 0 ; i < MAXCPML ; i ++)
-		cpml[i] = new CPML();
+  DEBUG() << "fd4t10s kernels use " << fd4t10s_simd_isa_name();
 }
 
 void ForwardModeling::addEncodedSource(float* p, const float* encsrc) const {
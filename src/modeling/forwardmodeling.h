@@ -17,20 +17,56 @@ extern "C" {
 #include "shot-position.h"
 #include "sponge.h"
 #include "cpml.h"
+#include "fm-workspace.h"
 
 class ForwardModeling {
+public:
+  /// two pass kernels with a full u2 plane, the single pass kernels in fd4t10s-fused.c,
+  /// or their hand vectorized versions in fd4t10s-simd.c
+  enum FdEngine { FD_TWO_PASS, FD_FUSED, FD_SIMD };
+
+  /// columns [x0, x1) and rows [z0, z1) of the padded grid
+  struct Box {
+    int x0, x1;
+    int z0, z1;
+  };
+
 public:
   ForwardModeling(const ShotPosition &allSrcPos, const ShotPosition &allGeoPos, float dt, float dx, float fm, int nb, int nt, int freeSurface);
 
   Velocity expandDomain(const Velocity &vel);
   Velocity expandDomain_notrans(const Velocity &vel);
+  /// the model velocity in m/s without the boundaries, the inverse of expandDomain
+  Velocity recoverDomain() const;
 
 
 	void addBornwv(float *fullwv_t0, float *fullwv_t1, float *fullwv_t2, const float *exvel_m, float dt, int it, float *rp1) const;
   void stepForward(std::vector<float> &p0, std::vector<float> &p1) const;
   void stepForward(std::vector<float> &p0, std::vector<float> &p1, int cpmlId) const;
   void stepBackward(float *p0, float *p1) const;
+  /// reentrant versions, the ones above use the workspace of this object
+  void stepForward(FmWorkspace &ws, std::vector<float> &p0, std::vector<float> &p1) const;
+  void stepForward(FmWorkspace &ws, std::vector<float> &p0, std::vector<float> &p1, int cpmlId) const;
+  void stepBackward(FmWorkspace &ws, float *p0, float *p1) const;
+  /// stepForward(ws, p0, p1) that only updates box, the rest of p0 is left as it is.
+  /// box then grows to the part of the grid the new p0 reaches, see activeBox
+  void stepForward(FmWorkspace &ws, std::vector<float> &p0, std::vector<float> &p1, Box &box) const;
+  /// one step of the gradient backward loop: stepBackward(ws, sp0, sp1), stepForward of the
+  /// receiver wavefield into gp0, and image -= sp0 * gp1 * scale, in a single sweep of the grid.
+  /// gp1 is still the receiver wavefield before the step, the one the loop correlates after its swap.
+  /// the receiver wavefield is only stepped in gbox, which grows like the box of stepForward
+  void stepAdjoint(FmWorkspace &ws, float *sp0, float *sp1, float *gp0, float *gp1, float *image, float scale,
+      Box &gbox) const;
   void bindVelocity(const Velocity &_vel);
+  /// positions of the sources and receivers, the ones given to the constructor until then
+  void bindShotPosition(const ShotPosition &_allSrcPos, const ShotPosition &_allGeoPos);
+  void refreshVelocity();
+  void setFdEngine(FdEngine engine);
+  /// limit the forward propagations to the part of the grid the wavefield has reached
+  void setActiveRegion(bool on);
+  /// box a wavefield excited at pos starts from, the whole grid when the active region is off
+  /// or the engine has no box kernels. the steps taking a box grow it with the wavefield
+  Box activeBox(const ShotPosition &pos) const;
   void bindRealVelocity(const Velocity &_vel);
   void addSource(float *p, const float *source, const ShotPosition &pos) const;
   void addSource(float *p, const float *source, int is) const;
@@ -54,6 +90,17 @@ public:
   void readBndry(const float* _bndr, float* p, int it) const;
 
   void FwiForwardModeling(const std::vector<float> &encsrc, std::vector<float> &dcal, int shot_id) const;
+  /// dcal[ib] of shot shot_ids[ib], the shots share the sweeps of the grid. it is bit for bit the
+  /// data of the shots modeled one by one: a lane gets the arithmetic of the single shot kernel, and
+  /// the points of the union of the active boxes a shot has not reached stay zero
+  void FwiForwardModeling(const std::vector<float> &encsrc, std::vector<std::vector<float> > &dcal,
+      const std::vector<int> &shot_ids) const;
+  /// dcal[im] of shot shot_id in the model clip(vel + alpha[im] * dvel, vmin, vmax), vel the bound
+  /// velocity and vmin, vmax transformed like it. the models share the sweeps of the grid and their
+  /// coefficients are computed from vel and dvel as the sweep loads them, the result is the one of
+  /// binding each updated velocity and modeling the shot
+  void FwiForwardModeling(const std::vector<float> &encsrc, const std::vector<float> &dvel, const std::vector<float> &alpha,
+      float vmin, float vmax, std::vector<std::vector<float> > &dcal, int shot_id) const;
   void EssForwardModeling(const std::vector<float> &encsrc, std::vector<float> &dcal) const;
 	void BornForwardModeling(const std::vector<float>& exvel, const std::vector<float>& encSrc, std::vector<float>& dcal, int shot_id) const;
 
@@ -80,6 +127,8 @@ private:
   void manipSource(float *p, const float *source, const ShotPosition &pos, boost::function2<float, float, float> op) const;
   void recordSeis(float *seis_it, const float *p, const ShotPosition &geoPos) const;
   void removeDirectArrival(const ShotPosition &allSrcPos, const ShotPosition &allGeoPos, float* data, int nt, float t_width) const;
+  /// grow box after a step of p, nlanes wavefields interleaved as [ix][iz][lane]
+  void growBox(Box &box, const float *p, int nlanes) const;
 
 public:
 	CPML* getCPML(int cpmlId) const;
@@ -87,6 +136,10 @@ public:
 
 private:
   const static int EXFDBNDRYLEN = 6;
+  /// cells a step of fd4t10s reads around a cell: the radius 5 laplacian and the radius 1 correction
+  const static int STENCIL_REACH = 6;
+  /// shots of a batch propagation, the vector width of the batch kernel
+  const static int BATCH_LANES = 8;
 
 private:
   const Velocity *vel;
@@ -100,14 +153,23 @@ private:
   int bz0, bzn;
   int nt;
 	int freeSurface;	//free surface
+  FdEngine fdEngine;
+  bool activeRegion;
   mutable int bndrSize;
   mutable int bndrWidth;
 
 
+private:
+  /// coefficient planes of the bound velocity, see fd4t10s-coef.h
+  std::vector<float> dampK1;
+  std::vector<float> dampK2;
+  std::vector<float> velRv;
+  std::vector<float> velRv12;
+
 private:
   std::vector<float> bndr;
 	mutable Sponge *spng;
-	mutable CPML **cpml;
+  mutable FmWorkspace workspace;
 
 	struct fdm2 *fd;
 	struct spon *sp;
@@ -0,0 +1,108 @@
+/*
+ * shot-aperture.cpp
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: rice
+ */
+
+#include <cstdlib>
+#include <algorithm>
+#include "shot-aperture.h"
+#include "logger.h"
+
+ShotAperture::ShotAperture(const ForwardModeling &global, int shot_id, int aperture) :
+  nt(global.getnt()), ng(global.getng()), xa(0), ig0(0), ig1(0),
+  srcPos(global.getAllSrcPos().clip(shot_id)), geoPos(global.getAllGeoPos()),
+  fm(global)
+{
+  const Velocity &gvel = global.getVelocity();
+  int nz = gvel.nz;
+  int bx0 = global.getbx0();
+  int bxn = global.getbxn();
+  int nxModel = gvel.nx - bx0 - bxn;
+  int sx = srcPos.getx(0);
+
+  /// the receivers are evenly spaced, the ones in the aperture are contiguous
+  int lo = sx;
+  int hi = sx;
+  ig0 = ng;
+  for (int ig = 0; ig < ng; ig++) {
+    int gx = geoPos.getx(ig);
+    if (std::abs(gx - sx) <= aperture) {
+      ig0 = std::min(ig0, ig);
+      ig1 = ig + 1;
+      lo = std::min(lo, gx);
+      hi = std::max(hi, gx);
+    }
+  }
+  if (ig0 >= ig1) {
+    ERROR() << format("no receiver of shot %d is within the aperture of %d cells") % shot_id % aperture;
+    exit(1);
+  }
+
+  xa = std::max(lo - PAD, 0);
+  int xb = std::min(hi + PAD + 1, nxModel);
+
+  /**
+   * model column x is column x + bx0 of both grids, so local column j is
+   * global column j + xa, the absorbing boundary included
+   */
+  int nxLocal = xb - xa + bx0 + bxn;
+  vel.resize(nxLocal, nz);
+  std::copy(&gvel.dat[(size_t)xa * nz], &gvel.dat[(size_t)(xa + nxLocal) * nz], &vel.dat[0]);
+
+  srcPos = srcPos.shiftx(-xa);
+  geoPos = geoPos.clipRange(ig0, ig1 - 1).shiftx(-xa);
+  fm.bindShotPosition(srcPos, geoPos);
+  fm.bindVelocity(vel);
+
+  DEBUG() << format("shot %d runs on model columns [%d, %d) with receivers [%d, %d)") % shot_id % xa % xb % ig0 % ig1;
+}
+
+const ForwardModeling &ShotAperture::getFm() const {
+  return fm;
+}
+
+int ShotAperture::getng() const {
+  return ig1 - ig0;
+}
+
+void ShotAperture::FwiForwardModeling(const std::vector<float> &encsrc, std::vector<float> &dcal) const {
+  int ngl = getng();
+  std::vector<float> local(nt * ngl, 0);
+  fm.FwiForwardModeling(encsrc, local, 0);
+
+  std::fill(dcal.begin(), dcal.begin() + nt * ng, 0.0f);
+  for (int it = 0; it < nt; it++) {
+    std::copy(&local[it * ngl], &local[it * ngl] + ngl, &dcal[it * ng + ig0]);
+  }
+}
+
+void ShotAperture::mute(std::vector<float> &data) const {
+  for (int it = 0; it < nt; it++) {
+    std::fill(&data[it * ng], &data[it * ng] + ig0, 0.0f);
+    std::fill(&data[it * ng] + ig1, &data[it * ng] + ng, 0.0f);
+  }
+}
+
+void ShotAperture::toLocal(const std::vector<float> &data, std::vector<float> &local) const {
+  int ngl = getng();
+  local.resize(nt * ngl);
+  for (int it = 0; it < nt; it++) {
+    std::copy(&data[it * ng + ig0], &data[it * ng + ig1], &local[it * ngl]);
+  }
+}
+
+void ShotAperture::addGradient(const std::vector<float> &local, std::vector<float> &grad) const {
+  int nz = vel.nz;
+  int bx0 = fm.getbx0();
+  int bxn = fm.getbxn();
+
+  for (int ix = bx0; ix < vel.nx - bxn; ix++) {
+    const float *src = &local[(size_t)ix * nz];
+    float *dst = &grad[(size_t)(ix + xa) * nz];
+    for (int iz = 0; iz < nz; iz++) {
+      dst[iz] += src[iz];
+    }
+  }
+}
@@ -0,0 +1,64 @@
+/*
+ * shot-aperture.h
+ *
+ *  Created on: Oct 16, 2026
+ *      Author: rice
+ */
+
+#ifndef SRC_MODELING_SHOT_APERTURE_H_
+#define SRC_MODELING_SHOT_APERTURE_H_
+
+#include <vector>
+#include "forwardmodeling.h"
+#include "shot-position.h"
+#include "velocity.h"
+
+/**
+ * one shot of a ForwardModeling propagated on the columns around it only.
+ *
+ * the receivers within aperture cells of the source are kept, the window
+ * spans them and the source plus PAD cells on both sides, clipped to the
+ * model. the window gets the absorbing boundary of the global model around
+ * it and the velocity of the global grid under it, so a window that covers
+ * the whole model is the global grid itself.
+ *
+ * the data of the shot keeps the layout [it][ig] of all the receivers, the
+ * receivers outside the aperture are muted
+ */
+class ShotAperture {
+public:
+  ShotAperture(const ForwardModeling &global, int shot_id, int aperture);
+
+  /// the modeling of the window, the shot is its shot 0
+  const ForwardModeling &getFm() const;
+  int getng() const;  /// receivers in the aperture
+
+  /// dcal of all the receivers, zero outside the aperture
+  void FwiForwardModeling(const std::vector<float> &encsrc, std::vector<float> &dcal) const;
+  /// zero the traces outside the aperture of the data of all the receivers
+  void mute(std::vector<float> &data) const;
+  /// the traces of data in the aperture, nt * getng() values
+  void toLocal(const std::vector<float> &data, std::vector<float> &local) const;
+  /// add the gradient of the window to the gradient of the global grid
+  void addGradient(const std::vector<float> &local, std::vector<float> &grad) const;
+
+private:
+  ShotAperture(const ShotAperture &);
+  void operator=(const ShotAperture &);
+
+private:
+  /// model cells kept beyond the outermost receiver or the source
+  const static int PAD = 20;
+
+private:
+  int nt;
+  int ng;           /// receivers of the global modeling
+  int xa;           /// first global column of the local grid
+  int ig0, ig1;     /// receivers [ig0, ig1) are in the aperture
+  ShotPosition srcPos;
+  ShotPosition geoPos;
+  Velocity vel;
+  ForwardModeling fm;
+};
+
+#endif /* SRC_MODELING_SHOT_APERTURE_H_ */
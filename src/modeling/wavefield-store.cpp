@@ -0,0 +1,343 @@
+/*
+ * wavefield-store.cpp
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "wavefield-store.h"
+#include "logger.h"
+
+/**
+ * storage of the kept snapshots, frame k is snapshot min(k * jt, nt - 1)
+ */
+class WavefieldFrames {
+public:
+  virtual ~WavefieldFrames() {}
+  virtual void write(int k, const float *p) = 0;
+  /// frame k, either the storage itself or decoded into buf
+  virtual const float *read(int k, float *buf) = 0;
+  virtual size_t footprint() const = 0;
+};
+
+namespace {
+
+class RamFrames : public WavefieldFrames {
+public:
+  RamFrames(int nframe, int size) : size(size), data((size_t)nframe * size, 0) {}
+
+  void write(int k, const float *p) {
+    std::copy(p, p + size, &data[(size_t)k * size]);
+  }
+
+  const float *read(int k, float *) {
+    return &data[(size_t)k * size];
+  }
+
+  size_t footprint() const {
+    return data.size() * sizeof(float);
+  }
+
+private:
+  int size;
+  std::vector<float> data;
+};
+
+/**
+ * blocks of 64 values share the scale max|v|, every value is rounded to a
+ * signed integer of bits bits relative to it. a block takes 1 + 2 * bits words,
+ * the relative error is 2^(1 - bits) of the largest value of the block
+ */
+class CompressedFrames : public WavefieldFrames {
+public:
+  CompressedFrames(int nframe, int size, int bits) :
+    size(size), bits(bits), nblock((size + BLOCK - 1) / BLOCK), blockWords(1 + 2 * bits),
+    data((size_t)nframe * nblock * blockWords, 0)
+  {
+  }
+
+  void write(int k, const float *p) {
+    uint32_t *frame = &data[(size_t)k * nblock * blockWords];
+    const float qmax = (float)((1 << (bits - 1)) - 1);
+
+#pragma omp parallel for
+    for (int ib = 0; ib < nblock; ib++) {
+      uint32_t *blk = frame + (size_t)ib * blockWords;
+      int b = ib * BLOCK;
+      int e = std::min(b + BLOCK, size);
+
+      float scale = 0;
+      for (int i = b; i < e; i++) {
+        scale = std::max(scale, std::fabs(p[i]));
+      }
+      std::memcpy(blk, &scale, sizeof(float));
+
+      float f = scale > 0 ? qmax / scale : 0;
+      uint64_t acc = 0;
+      int nacc = 0;
+      uint32_t *out = blk + 1;
+      for (int i = b; i < b + BLOCK; i++) {
+        float v = i < e ? p[i] : 0;
+        uint64_t u = (uint64_t)(lrintf(v * f) + (long)qmax);
+        acc |= u << nacc;
+        nacc += bits;
+        if (nacc >= 32) {
+          *out++ = (uint32_t)acc;
+          acc >>= 32;
+          nacc -= 32;
+        }
+      }
+    }
+  }
+
+  const float *read(int k, float *buf) {
+    const uint32_t *frame = &data[(size_t)k * nblock * blockWords];
+    const long qmax = (1L << (bits - 1)) - 1;
+    const uint64_t mask = (1ULL << bits) - 1;
+
+#pragma omp parallel for
+    for (int ib = 0; ib < nblock; ib++) {
+      const uint32_t *blk = frame + (size_t)ib * blockWords;
+      int b = ib * BLOCK;
+      int e = std::min(b + BLOCK, size);
+
+      float scale;
+      std::memcpy(&scale, blk, sizeof(float));
+      float f = scale / qmax;
+
+      uint64_t acc = 0;
+      int nacc = 0;
+      const uint32_t *in = blk + 1;
+      for (int i = b; i < e; i++) {
+        if (nacc < bits) {
+          acc |= (uint64_t)(*in++) << nacc;
+          nacc += 32;
+        }
+        buf[i] = ((long)(acc & mask) - qmax) * f;
+        acc >>= bits;
+        nacc -= bits;
+      }
+    }
+
+    return buf;
+  }
+
+  size_t footprint() const {
+    return data.size() * sizeof(uint32_t);
+  }
+
+private:
+  static const int BLOCK = 64;
+  int size;
+  int bits;
+  int nblock;
+  int blockWords;
+  std::vector<uint32_t> data;
+};
+
+/**
+ * the frames live in an unlinked file mapped into memory, so the kernel pages
+ * them out instead of the process running out of memory. frames are padded to
+ * whole pages; reading frame k asks the kernel to read ahead the next frames
+ * in the same direction and drops the frames left behind from the mapping
+ */
+class DiskFrames : public WavefieldFrames {
+public:
+  DiskFrames(int nframe, int size, const std::string &tmpdir) :
+    nframe(nframe), size(size), lastRead(-1), dir(0)
+  {
+    long page = sysconf(_SC_PAGESIZE);
+    frameBytes = ((size_t)size * sizeof(float) + page - 1) / page * page;
+
+    std::string path = tmpdir + "/wavefield-XXXXXX";
+    std::vector<char> name(path.begin(), path.end());
+    name.push_back('\0');
+    int fd = mkstemp(&name[0]);
+    if (fd < 0) {
+      ERROR() << format("cannot create the wavefield spill file in %s") % tmpdir;
+      exit(1);
+    }
+    unlink(&name[0]);
+
+    if (ftruncate(fd, (off_t)(frameBytes * nframe)) != 0) {
+      ERROR() << format("cannot size the wavefield spill file to %lu bytes") % (frameBytes * nframe);
+      exit(1);
+    }
+    void *p = mmap(NULL, frameBytes * nframe, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+      ERROR() << "cannot map the wavefield spill file";
+      exit(1);
+    }
+    base = static_cast<char *>(p);
+  }
+
+  ~DiskFrames() {
+    munmap(base, frameBytes * nframe);
+  }
+
+  void write(int k, const float *p) {
+    std::memcpy(base + frameBytes * k, p, (size_t)size * sizeof(float));
+  }
+
+  const float *read(int k, float *) {
+    int d = lastRead < 0 ? 0 : (k > lastRead ? 1 : (k < lastRead ? -1 : dir));
+
+    if (d != 0 && k != lastRead) {
+      if (d != dir || std::abs(k - lastRead) > 1) {
+        /// new direction or a jump, ask for the whole window
+        for (int i = 1; i <= PREFETCH; i++) {
+          advise(k + d * i, MADV_WILLNEED);
+        }
+      } else {
+        advise(k + d * PREFETCH, MADV_WILLNEED);
+        /// interpolation reads two neighbouring frames, keep one behind
+        advise(k - d * 2, MADV_DONTNEED);
+      }
+    }
+
+    dir = d;
+    lastRead = k;
+    return reinterpret_cast<const float *>(base + frameBytes * k);
+  }
+
+  size_t footprint() const {
+    return frameBytes * nframe;
+  }
+
+private:
+  void advise(int k, int advice) {
+    if (k >= 0 && k < nframe) {
+      madvise(base + frameBytes * k, frameBytes, advice);
+    }
+  }
+
+private:
+  static const int PREFETCH = 4;
+  int nframe;
+  int size;
+  size_t frameBytes;
+  char *base;
+  int lastRead;
+  int dir;
+};
+
+} /* namespace */
+
+WavefieldStore::Config::Config() :
+  backend(WF_RAM), jt(1), bits(16), dir(".")
+{
+}
+
+WavefieldStore::Backend WavefieldStore::backendFromName(const std::string &name) {
+  if (name == "ram") {
+    return WF_RAM;
+  }
+  if (name == "zip") {
+    return WF_COMPRESSED;
+  }
+  if (name == "disk") {
+    return WF_DISK;
+  }
+  ERROR() << format("unknown wavefield store %s, use ram, zip or disk") % name;
+  exit(1);
+}
+
+WavefieldStore::WavefieldStore(const Config &config, int nt, int size) :
+  nt(nt), size(size), jt(std::max(config.jt, 1)), frames(0), lastSlot(0)
+{
+  int nframe = (nt - 1) / jt + 1 + ((nt - 1) % jt != 0 ? 1 : 0);
+
+  switch (config.backend) {
+  case WF_COMPRESSED:
+    if (config.bits < 4 || config.bits > 16) {
+      ERROR() << format("wavefield compression takes 4 to 16 bits, not %d") % config.bits;
+      exit(1);
+    }
+    frames = new CompressedFrames(nframe, size, config.bits);
+    cache[0].resize(size);
+    cache[1].resize(size);
+    break;
+  case WF_DISK:
+    frames = new DiskFrames(nframe, size, config.dir);
+    break;
+  default:
+    frames = new RamFrames(nframe, size);
+    break;
+  }
+
+  cacheFrame[0] = cacheFrame[1] = -1;
+  cachePtr[0] = cachePtr[1] = 0;
+}
+
+WavefieldStore::~WavefieldStore() {
+  delete frames;
+}
+
+void WavefieldStore::put(int it, const float *p) {
+  int k;
+  if (it % jt == 0) {
+    k = it / jt;
+  } else if (it == nt - 1) {
+    k = it / jt + 1;
+  } else {
+    return;
+  }
+
+  frames->write(k, p);
+  for (int i = 0; i < 2; i++) {
+    if (cacheFrame[i] == k) {
+      cacheFrame[i] = -1;
+    }
+  }
+}
+
+/**
+ * cache slot holding frame k, the slot keep is not evicted
+ */
+int WavefieldStore::load(int k, int keep) {
+  for (int i = 0; i < 2; i++) {
+    if (cacheFrame[i] == k) {
+      lastSlot = i;
+      return i;
+    }
+  }
+
+  int i = keep >= 0 ? 1 - keep : 1 - lastSlot;
+  cachePtr[i] = frames->read(k, cache[i].empty() ? 0 : &cache[i][0]);
+  cacheFrame[i] = k;
+  lastSlot = i;
+  return i;
+}
+
+void WavefieldStore::get(int it, float *p) {
+  int k0 = it / jt;
+  int t0 = k0 * jt;
+  int s0 = load(k0, -1);
+  if (t0 == it) {
+    std::copy(cachePtr[s0], cachePtr[s0] + size, p);
+    return;
+  }
+
+  int t1 = std::min(t0 + jt, nt - 1);
+  int s1 = load(k0 + 1, s0);
+  const float *f0 = cachePtr[s0];
+  const float *f1 = cachePtr[s1];
+  float w = (float)(it - t0) / (t1 - t0);
+
+#pragma omp parallel for
+  for (int i = 0; i < size; i++) {
+    p[i] = f0[i] + w * (f1[i] - f0[i]);
+  }
+}
+
+size_t WavefieldStore::footprint() const {
+  return frames->footprint();
+}
@@ -0,0 +1,70 @@
+/*
+ * wavefield-store.h
+ *
+ *  Created on: Oct 15, 2026
+ *      Author: rice
+ */
+
+#ifndef SRC_MODELING_WAVEFIELD_STORE_H_
+#define SRC_MODELING_WAVEFIELD_STORE_H_
+
+#include <string>
+#include <vector>
+
+class WavefieldFrames;
+
+/**
+ * time history of a wavefield, nt snapshots of size floats each, written and
+ * read one snapshot at a time in any order.
+ *
+ * only every jt-th snapshot (and the last one) is kept, the others are
+ * linearly interpolated in time when they are read. the kept snapshots go to
+ * one of the backends
+ *   WF_RAM         plain floats in memory
+ *   WF_COMPRESSED  fixed rate block floating point in memory, bits per value
+ *   WF_DISK        a memory mapped spill file in dir, read ahead in the
+ *                  direction the snapshots are read
+ */
+class WavefieldStore {
+public:
+  enum Backend { WF_RAM, WF_COMPRESSED, WF_DISK };
+
+  struct Config {
+    Config();
+    Backend backend;
+    int jt;           /// keep every jt-th snapshot
+    int bits;         /// bits per value of WF_COMPRESSED, 4..16
+    std::string dir;  /// directory of the WF_DISK spill files
+  };
+
+  /// "ram", "zip" or "disk", exits on anything else
+  static Backend backendFromName(const std::string &name);
+
+public:
+  WavefieldStore(const Config &config, int nt, int size);
+  ~WavefieldStore();
+
+  void put(int it, const float *p);
+  void get(int it, float *p);
+
+  /// bytes held by the kept snapshots
+  size_t footprint() const;
+
+private:
+  WavefieldStore(const WavefieldStore &);
+  void operator=(const WavefieldStore &);
+
+  int load(int k, int keep);
+
+private:
+  int nt;
+  int size;
+  int jt;
+  WavefieldFrames *frames;
+  int cacheFrame[2];                /// the last two snapshots read
+  const float *cachePtr[2];
+  std::vector<float> cache[2];      /// decode buffers of the backends that need one
+  int lastSlot;
+};
+
+#endif /* SRC_MODELING_WAVEFIELD_STORE_H_ */
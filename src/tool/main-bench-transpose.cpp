@@ -0,0 +1,142 @@
+extern "C" {
+#include <rsf.h>
+}
+
+#include <boost/format.hpp>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include "common.h"
+#include "logger.h"
+#include "timer.h"
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+using boost::format;
+
+namespace {
+/// the loop matrix_transpose used to be, kept as the baseline
+void naiveTranspose(const float *matrix, float *trans, int n1, int n2) {
+#pragma omp parallel for
+  for (int i2 = 0; i2 < n2; i2++) {
+    for (int i1 = 0; i1 < n1; i1++) {
+      trans[i2 + n2 * i1] = matrix[i1 + n1 * i2];
+    }
+  }
+}
+
+/// best of reps runs, in seconds
+template <typename F>
+double bestOf(int reps, F f) {
+  double best = 0;
+  for (int r = 0; r < reps; r++) {
+    Timer timer;
+    f();
+    double t = timer.elapsed();
+    best = (r == 0 || t < best) ? t : best;
+  }
+  return best;
+}
+
+struct Naive {
+  const float *a; float *b; int n1, n2;
+  void operator()() const { naiveTranspose(a, b, n1, n2); }
+};
+
+struct Tiled {
+  const float *a; float *b; int n1, n2;
+  void operator()() const { matrix_transpose(a, b, n1, n2); }
+};
+
+/// every run transposes the result of the previous one
+struct Inplace {
+  float *a; mutable int n1, n2;
+  void operator()() const { matrix_transpose_inplace(a, n1, n2); std::swap(n1, n2); }
+};
+
+/// GB/s counting one read and one write of every element
+double bandwidth(int n1, int n2, double t) {
+  return 2.0 * sizeof(float) * n1 * n2 / t / 1e9;
+}
+
+} /// end of name space
+
+int main(int argc, char* argv[]) {
+  /* initialize Madagascar */
+  sf_init(argc,argv);
+
+  int reps;
+  if (!sf_getint("reps", &reps)) reps = 10; /* timed runs per shape, the best one is reported */
+
+  /// shot gathers as they come: nt = 2000..8000 samples of ng = 461..2000 traces
+  const int nts[] = { 2000, 4000, 8000 };
+  const int ngs[] = { 461, 1000, 2000 };
+
+  int nthreads = 1;
+#ifdef USE_OPENMP
+  nthreads = omp_get_max_threads();
+#endif
+  INFO() << format("transpose kernel: %s, threads: %d, reps: %d") % matrix_transpose_isa_name() % nthreads % reps;
+  INFO() << format("%6s %6s %12s %12s %12s %9s %9s") % "nt" % "ng" % "naive GB/s" % "tiled GB/s" % "inplace GB/s" % "tile x" % "back x";
+
+  for (size_t i = 0; i < sizeof(nts) / sizeof(nts[0]); i++) {
+    for (size_t j = 0; j < sizeof(ngs) / sizeof(ngs[0]); j++) {
+      int nt = nts[i];
+      int ng = ngs[j];
+      std::vector<float> a((size_t)nt * ng);
+      std::vector<float> b(a.size());
+      std::vector<float> c(a.size());
+      for (size_t k = 0; k < a.size(); k++) {
+        a[k] = (float)std::rand() / RAND_MAX;
+      }
+
+      /// time major [it][ig] to trace major [ig][it], as when a gather is saved
+      Naive naive = { &a[0], &b[0], ng, nt };
+      Tiled tiled = { &a[0], &c[0], ng, nt };
+      double tn = bestOf(reps, naive);
+      double tt = bestOf(reps, tiled);
+      if (b != c) {
+        ERROR() << format("tiled transpose differs from the naive one, nt %d ng %d") % nt % ng;
+        exit(1);
+      }
+
+      /// and back, as when a gather is loaded
+      Tiled back = { &c[0], &b[0], nt, ng };
+      Naive backNaive = { &c[0], &b[0], nt, ng };
+      double tb = bestOf(reps, back);
+      double tbn = bestOf(reps, backNaive);
+
+      /// an even number of in place runs gives back the original matrix
+      Inplace inplace = { &a[0], ng, nt };
+      std::vector<float> orig(a);
+      double ti = bestOf(reps, inplace);
+      if (reps % 2 == 0 ? a != orig : a != c) {
+        ERROR() << format("in place transpose is wrong, nt %d ng %d") % nt % ng;
+        exit(1);
+      }
+
+      INFO() << format("%6d %6d %12.2f %12.2f %12.2f %9.2f %9.2f")
+          % nt % ng % bandwidth(nt, ng, tn) % bandwidth(nt, ng, tt) % bandwidth(nt, ng, ti) % (tn / tt) % (tbn / tb);
+    }
+  }
+
+  /// the square case of the in place transpose swaps blocks without a copy
+  int n = 2048;
+  std::vector<float> sq((size_t)n * n);
+  for (size_t k = 0; k < sq.size(); k++) {
+    sq[k] = (float)k;
+  }
+  std::vector<float> sqt(sq.size());
+  matrix_transpose(&sq[0], &sqt[0], n, n);
+  Inplace square = { &sq[0], n, n };
+  double ts = bestOf(1, square);
+  if (sq != sqt) {
+    ERROR() << format("square in place transpose is wrong, n %d") % n;
+    exit(1);
+  }
+  INFO() << format("square %d x %d in place: %.2f GB/s") % n % n % bandwidth(n, n, ts);
+
+  return 0;
+}
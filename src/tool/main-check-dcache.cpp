@@ -0,0 +1,201 @@
+extern "C" {
+#include <rsf.h>
+}
+
+#include <boost/format.hpp>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "logger.h"
+#include "velocity.h"
+#include "shot-position.h"
+#include "ricker-wavelet.h"
+#include "forwardmodeling.h"
+#include "fwiupdatevelop.h"
+#include "shotdata-cache.h"
+
+using boost::format;
+
+namespace {
+const int nx = 200;
+const int nz = 100;
+const int nb = 20;
+const float dx = 10;
+const float dt = 0.001;
+const float fm = 10;
+const int ntrial = 2;
+const float alpha[ntrial] = { 1.0f, 2.0f };
+
+/// the data of every shot in the trial model im, modeled the way the line search or the gradient may do it
+typedef void (*Modeling)(const ForwardModeling &fmMethod, const FwiUpdateVelOp &updateVelOp,
+    const std::vector<float> &wlt, const std::vector<float> &grad, int nbatch, int im,
+    std::vector<std::vector<float> > &dcal);
+
+/// the velocity of trial model im, as FwiUpdateVelOp builds it
+Velocity trialVelocity(const ForwardModeling &fmMethod, const FwiUpdateVelOp &updateVelOp,
+    const std::vector<float> &grad, int im) {
+  Velocity newVel(fmMethod.getnx(), fmMethod.getnz());
+  updateVelOp.update(newVel, fmMethod.getVelocity(), grad, alpha[im]);
+  return newVel;
+}
+
+/// every shot in its own propagation
+void alone(const ForwardModeling &fmMethod, const FwiUpdateVelOp &updateVelOp,
+    const std::vector<float> &wlt, const std::vector<float> &grad, int, int im,
+    std::vector<std::vector<float> > &dcal) {
+  Velocity newVel = trialVelocity(fmMethod, updateVelOp, grad, im);
+  ForwardModeling updateMethod = fmMethod;
+  updateMethod.bindVelocity(newVel);
+  for (size_t is = 0; is < dcal.size(); is++) {
+    updateMethod.FwiForwardModeling(wlt, dcal[is], is);
+  }
+}
+
+/// nbatch shots in one propagation
+void batch(const ForwardModeling &fmMethod, const FwiUpdateVelOp &updateVelOp,
+    const std::vector<float> &wlt, const std::vector<float> &grad, int nbatch, int im,
+    std::vector<std::vector<float> > &dcal) {
+  Velocity newVel = trialVelocity(fmMethod, updateVelOp, grad, im);
+  ForwardModeling updateMethod = fmMethod;
+  updateMethod.bindVelocity(newVel);
+  for (size_t is = 0; is < dcal.size(); is += nbatch) {
+    std::vector<int> ids;
+    for (size_t ib = is; ib < is + nbatch && ib < dcal.size(); ib++) {
+      ids.push_back(ib);
+    }
+    std::vector<std::vector<float> > d(ids.size());
+    for (size_t ib = 0; ib < ids.size(); ib++) {
+      d[ib].swap(dcal[ids[ib]]);
+    }
+    updateMethod.FwiForwardModeling(wlt, d, ids);
+    for (size_t ib = 0; ib < ids.size(); ib++) {
+      d[ib].swap(dcal[ids[ib]]);
+    }
+  }
+}
+
+/// every shot in all the trial models in one propagation, model im is kept
+void models(const ForwardModeling &fmMethod, const FwiUpdateVelOp &updateVelOp,
+    const std::vector<float> &wlt, const std::vector<float> &grad, int, int im,
+    std::vector<std::vector<float> > &dcal) {
+  std::vector<float> steplen(alpha, alpha + ntrial);
+  std::vector<std::vector<float> > d(ntrial, std::vector<float>(dcal[0].size()));
+  for (size_t is = 0; is < dcal.size(); is++) {
+    fmMethod.FwiForwardModeling(wlt, grad, steplen, updateVelOp.getvmin(), updateVelOp.getvmax(), d, is);
+    dcal[is] = d[im];
+  }
+}
+
+/// number of samples that are not bit for bit the reference
+int mismatches(const std::vector<float> &ref, const std::vector<float> &x) {
+  int n = 0;
+  for (size_t i = 0; i < ref.size(); i++) {
+    n += std::memcmp(&ref[i], &x[i], sizeof(float)) != 0;
+  }
+  return n;
+}
+
+} /// end of name space
+
+/**
+ * the data the line search puts in ShotDataCache has to be the data the
+ * gradient would model in the accepted model, whichever way each of them
+ * propagates the shots
+ */
+int main(int argc, char* argv[]) {
+  /* initialize Madagascar */
+  sf_init(argc,argv);
+
+  int ns;
+  if (!sf_getint("ns", &ns)) ns = 16; /* shots, in whole groups of nbatch to reach the batch kernel */
+  int nt;
+  if (!sf_getint("nt", &nt)) nt = 600; /* time steps of every shot */
+  int nbatch;
+  if (!sf_getint("nbatch", &nbatch)) nbatch = 8; /* shots modeled in one propagation */
+  int active;
+  if (!sf_getint("active", &active)) active = 1; /* 1: skip the grid the wavefield has not reached yet */
+
+  int ng = nx;
+  ShotPosition allSrcPos(2, 10, 0, (nx - 20) / ns, ns, nz);
+  ShotPosition allGeoPos(2, 0, 0, 1, ng, nz);
+  ForwardModeling fmMethod(allSrcPos, allGeoPos, dt, dx, fm, nb, nt, 0);
+  fmMethod.setActiveRegion(active != 0);
+
+  /// a smooth medium from 1500 m/s to 3500 m/s, and a random direction of about 100 m/s
+  Velocity v0(nx, nz);
+  for (int ix = 0; ix < nx; ix++) {
+    for (int iz = 0; iz < nz; iz++) {
+      v0.dat[ix * nz + iz] = 2500 + 1000 * std::sin(0.04f * ix) * std::cos(0.06f * iz);
+    }
+  }
+  Velocity exvel = fmMethod.expandDomain(v0);
+  fmMethod.bindVelocity(exvel);
+  std::vector<float> grad(exvel.dat.size());
+  for (size_t i = 0; i < grad.size(); i++) {
+    grad[i] = 2.0f * std::rand() / RAND_MAX - 1.0f;
+  }
+  FwiUpdateVelOp updateVelOp(1500, 4000, dx, dt);
+
+  std::vector<float> wlt(nt);
+  rickerWavelet(&wlt[0], nt, fm, dt, 1000);
+
+  const struct { const char *name; Modeling run; } lineSearch[] = {
+    { "alone", alone },
+    { "batch", batch },
+    { "models", models },
+  };
+  const struct { const char *name; Modeling run; } gradient[] = {
+    { "alone", alone },
+    { "batch", batch },
+  };
+  const int nls = sizeof(lineSearch) / sizeof(lineSearch[0]);
+  const int ngrad = sizeof(gradient) / sizeof(gradient[0]);
+  const int accepted = ntrial - 1;
+
+  INFO() << format("shot data cache: %d shots, %d steps, nbatch %d, active %d") % ns % nt % nbatch % active;
+
+  /// the gradient data of the accepted model, modeled again
+  std::vector<std::vector<std::vector<float> > > fresh(ngrad,
+      std::vector<std::vector<float> >(ns, std::vector<float>(nt * ng)));
+  for (int g = 0; g < ngrad; g++) {
+    gradient[g].run(fmMethod, updateVelOp, wlt, grad, nbatch, accepted, fresh[g]);
+  }
+  ShotDataCache::Key acceptedKey = ShotDataCache::modelKey(trialVelocity(fmMethod, updateVelOp, grad, accepted).dat);
+
+  bool failed = false;
+  for (int l = 0; l < nls; l++) {
+    ShotDataCache cache(ns, nt * ng);
+    std::vector<std::vector<float> > dcal(ns, std::vector<float>(nt * ng));
+    for (int im = 0; im < ntrial; im++) {
+      lineSearch[l].run(fmMethod, updateVelOp, wlt, grad, nbatch, im, dcal);
+      ShotDataCache::Key key = ShotDataCache::modelKey(trialVelocity(fmMethod, updateVelOp, grad, im).dat);
+      for (int is = 0; is < ns; is++) {
+        cache.putTrial(is, key, dcal[is]);
+      }
+    }
+    cache.accept(acceptedKey);
+
+    for (int g = 0; g < ngrad; g++) {
+      int n = 0, nmiss = 0;
+      std::vector<float> cached(nt * ng);
+      for (int is = 0; is < ns; is++) {
+        if (!cache.get(is, acceptedKey, cached)) {
+          nmiss++;
+          continue;
+        }
+        n += mismatches(fresh[g][is], cached);
+      }
+      bool ok = n == 0 && nmiss == 0;
+      INFO() << format("line search %-7s gradient %-6s %d samples differ, %d shots not cached %s")
+          % lineSearch[l].name % gradient[g].name % n % nmiss % (ok ? "ok" : "FAILED");
+      failed = failed || !ok;
+    }
+  }
+
+  if (failed) {
+    ERROR() << "the cached data differs from the data modeled again";
+    exit(1);
+  }
+  return 0;
+}
@@ -0,0 +1,308 @@
+extern "C" {
+#include <rsf.h>
+#include "fd4t10s-simd.h"
+#include "fd4t10s-coef.h"
+}
+
+#include <boost/format.hpp>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include "logger.h"
+#include "velocity.h"
+#include "fwiupdatevelop.h"
+
+using boost::format;
+
+namespace {
+const int nx = 240;
+const int nz = 160;
+const int nb = 20;
+const int nbat = 16;
+const int nmod = 3;
+const float alpha[nmod] = { 0.0f, 2.0f, -2.0f };
+
+const char *isaName(int isa) {
+  return isa == FD4T10S_ISA_AVX512 ? "avx512" : isa == FD4T10S_ISA_AVX2 ? "avx2" : "scalar";
+}
+
+/// a smooth random medium as the modeling sees it, dx * dx / (dt * dt * v * v)
+/// for v from 1500 m/s to 3550 m/s, dx = 10 m and dt = 1 ms. the updated
+/// models are clipped to 1490 m/s and 4080 m/s
+struct Model {
+  std::vector<float> vel, dvel, k1, k2, rv, rv12;
+  FwiUpdateVelOp updateVelOp;
+
+  Model() : vel(nx * nz), dvel(nx * nz), k1(nx * nz), k2(nx * nz), rv(nx * nz), rv12(nx * nz),
+      updateVelOp(1490, 4080, 10, 0.001) {
+    for (int ix = 0; ix < nx; ix++) {
+      for (int iz = 0; iz < nz; iz++) {
+        float v = 2500 + 1000 * std::sin(0.05f * ix) * std::cos(0.07f * iz) + 50.0f * std::rand() / RAND_MAX;
+        vel[ix * nz + iz] = 1e8f / (v * v);
+        dvel[ix * nz + iz] = 2.0f * std::rand() / RAND_MAX - 1.0f;
+      }
+    }
+    fd4t10s_damp_coef(&k1[0], &k2[0], nx, nz, nb, 0);
+    fd4t10s_vel_coef(&rv[0], &rv12[0], &vel[0], nx * nz);
+  }
+};
+
+/// a gaussian pulse around (cx, cz) in both time levels
+void pulse(std::vector<float> &p, int cx, int cz, int stride = 1, int lane = 0) {
+  for (int ix = 0; ix < nx; ix++) {
+    for (int iz = 0; iz < nz; iz++) {
+      float r2 = (ix - cx) * (ix - cx) + (iz - cz) * (iz - cz);
+      p[(ix * nz + iz) * stride + lane] = std::exp(-r2 / 9.0f);
+    }
+  }
+}
+
+/// the wavefields after nstep steps of one kernel, all of them concatenated
+typedef void (*Kernel)(const Model &m, int nstep, std::vector<float> &out);
+
+void damp(const Model &m, int nstep, std::vector<float> &out) {
+  std::vector<float> p0(nx * nz), p1(nx * nz);
+  pulse(p0, nx / 2, nz / 3);
+  pulse(p1, nx / 2, nz / 3);
+  for (int it = 0; it < nstep; it++) {
+    fd4t10s_simd_damp_2d_vtrans(&p0[0], &p1[0], &m.k1[0], &m.k2[0], &m.rv[0], &m.rv12[0], nx, nz);
+    p0.swap(p1);
+  }
+  out = p1;
+}
+
+void dampBox(const Model &m, int nstep, std::vector<float> &out) {
+  std::vector<float> p0(nx * nz), p1(nx * nz);
+  pulse(p0, nx / 3, nz / 2);
+  pulse(p1, nx / 3, nz / 2);
+  for (int it = 0; it < nstep; it++) {
+    fd4t10s_simd_damp_2d_vtrans_box(&p0[0], &p1[0], &m.k1[0], &m.k2[0], &m.rv[0], &m.rv12[0], nx, nz,
+        nx / 3 - 40 - it / 2, nx / 3 + 41 + it / 2, 13, nz - 7);
+    p0.swap(p1);
+  }
+  out = p1;
+}
+
+void undamped(const Model &m, int nstep, std::vector<float> &out) {
+  std::vector<float> p0(nx * nz), p1(nx * nz), p2(nx * nz);
+  pulse(p0, nx / 2, nz / 2);
+  pulse(p1, nx / 2, nz / 2);
+  for (int it = 0; it < nstep; it++) {
+    fd4t10s_simd_2d_vtrans_3vars(&p0[0], &p1[0], &p2[0], &m.rv[0], &m.rv12[0], nx, nz);
+    p0.swap(p1);
+    p1.swap(p2);
+  }
+  out = p1;
+}
+
+void batch(const Model &m, int nstep, std::vector<float> &out) {
+  std::vector<float> p0(nx * nz * nbat), p1(nx * nz * nbat);
+  for (int b = 0; b < nbat; b++) {
+    pulse(p0, 30 + 11 * b, nz / 4, nbat, b);
+    pulse(p1, 30 + 11 * b, nz / 4, nbat, b);
+  }
+  for (int it = 0; it < nstep; it++) {
+    fd4t10s_simd_damp_2d_vtrans_batch_box(&p0[0], &p1[0], &m.k1[0], &m.k2[0], &m.rv[0], &m.rv12[0], nx, nz, nbat,
+        0, nx, 0, nz);
+    p0.swap(p1);
+  }
+  out = p1;
+}
+
+void models(const Model &m, int nstep, std::vector<float> &out) {
+  std::vector<std::vector<float> > p0(nmod, std::vector<float>(nx * nz)), p1(p0);
+  std::vector<float *> prev(nmod), curr(nmod);
+  for (int im = 0; im < nmod; im++) {
+    pulse(p0[im], nx / 2, nz / 2);
+    pulse(p1[im], nx / 2, nz / 2);
+  }
+  for (int it = 0; it < nstep; it++) {
+    for (int im = 0; im < nmod; im++) {
+      prev[im] = &p0[im][0];
+      curr[im] = &p1[im][0];
+    }
+    fd4t10s_simd_damp_2d_vtrans_models_box(&prev[0], &curr[0], &m.k1[0], &m.k2[0], &m.vel[0], &m.dvel[0], alpha, nmod,
+        m.updateVelOp.getvmin(), m.updateVelOp.getvmax(), nx, nz, 0, nx, 0, nz);
+    p0.swap(p1);
+  }
+  out.clear();
+  for (int im = 0; im < nmod; im++) {
+    out.insert(out.end(), p1[im].begin(), p1[im].end());
+  }
+}
+
+void adjoint(const Model &m, int nstep, std::vector<float> &out) {
+  std::vector<float> sp0(nx * nz), sp1(nx * nz), gp0(nx * nz), gp1(nx * nz), image(nx * nz, 0);
+  pulse(sp0, nx / 2, nz / 2);
+  pulse(sp1, nx / 2, nz / 2);
+  pulse(gp0, nx / 2 + 10, nz / 2 - 10);
+  pulse(gp1, nx / 2 + 10, nz / 2 - 10);
+  for (int it = 0; it < nstep; it++) {
+    fd4t10s_simd_adjoint_2d_vtrans(&sp0[0], &sp1[0], &gp0[0], &gp1[0], &m.k1[0], &m.k2[0], &m.rv[0], &m.rv12[0],
+        &image[0], 0.5f, nx, nz);
+    sp0.swap(sp1);
+    gp0.swap(gp1);
+  }
+  out = sp1;
+  out.insert(out.end(), gp1.begin(), gp1.end());
+  out.insert(out.end(), image.begin(), image.end());
+}
+
+void adjointBox(const Model &m, int nstep, std::vector<float> &out) {
+  std::vector<float> sp0(nx * nz), sp1(nx * nz), gp0(nx * nz), gp1(nx * nz), image(nx * nz, 0);
+  pulse(sp0, nx / 2, nz / 2);
+  pulse(sp1, nx / 2, nz / 2);
+  pulse(gp0, nx / 3, nz / 3);
+  pulse(gp1, nx / 3, nz / 3);
+  for (int it = 0; it < nstep; it++) {
+    fd4t10s_simd_adjoint_2d_vtrans_box(&sp0[0], &sp1[0], &gp0[0], &gp1[0], &m.k1[0], &m.k2[0], &m.rv[0], &m.rv12[0],
+        &image[0], 0.5f, nx, nz, nx / 3 - 30 - it / 2, nx / 3 + 31 + it / 2, 9, nz / 3 + 27 + it / 3);
+    sp0.swap(sp1);
+    gp0.swap(gp1);
+  }
+  out = sp1;
+  out.insert(out.end(), gp1.begin(), gp1.end());
+  out.insert(out.end(), image.begin(), image.end());
+}
+
+/// the shots of batch, each one propagated alone
+void batchAlone(const Model &m, int nstep, std::vector<float> &out) {
+  out.assign(nx * nz * nbat, 0);
+  for (int b = 0; b < nbat; b++) {
+    std::vector<float> p0(nx * nz), p1(nx * nz);
+    pulse(p0, 30 + 11 * b, nz / 4);
+    pulse(p1, 30 + 11 * b, nz / 4);
+    for (int it = 0; it < nstep; it++) {
+      fd4t10s_simd_damp_2d_vtrans(&p0[0], &p1[0], &m.k1[0], &m.k2[0], &m.rv[0], &m.rv12[0], nx, nz);
+      p0.swap(p1);
+    }
+    for (int i = 0; i < nx * nz; i++) {
+      out[i * nbat + b] = p1[i];
+    }
+  }
+}
+
+/// the models of models, each one updated by FwiUpdateVelOp and propagated on its own coefficient planes
+void modelsAlone(const Model &m, int nstep, std::vector<float> &out) {
+  Velocity vel(m.vel, nx, nz);
+  Velocity newVel(nx, nz);
+  std::vector<float> rv(nx * nz), rv12(nx * nz);
+  out.clear();
+  for (int im = 0; im < nmod; im++) {
+    m.updateVelOp.update(newVel, vel, m.dvel, alpha[im]);
+    fd4t10s_vel_coef(&rv[0], &rv12[0], &newVel.dat[0], nx * nz);
+
+    std::vector<float> p0(nx * nz), p1(nx * nz);
+    pulse(p0, nx / 2, nz / 2);
+    pulse(p1, nx / 2, nz / 2);
+    for (int it = 0; it < nstep; it++) {
+      fd4t10s_simd_damp_2d_vtrans(&p0[0], &p1[0], &m.k1[0], &m.k2[0], &rv[0], &rv12[0], nx, nz);
+      p0.swap(p1);
+    }
+    out.insert(out.end(), p1.begin(), p1.end());
+  }
+}
+
+/// number of samples that are not bit for bit the reference
+int mismatches(const std::vector<float> &ref, const std::vector<float> &x) {
+  int n = 0;
+  for (size_t i = 0; i < ref.size(); i++) {
+    n += std::memcmp(&ref[i], &x[i], sizeof(float)) != 0;
+  }
+  return n;
+}
+
+/// largest difference relative to the largest value of the reference
+double relDiff(const std::vector<float> &ref, const std::vector<float> &x) {
+  double maxref = 0, maxdiff = 0;
+  for (size_t i = 0; i < ref.size(); i++) {
+    maxref = std::max(maxref, (double)std::fabs(ref[i]));
+    maxdiff = std::max(maxdiff, (double)std::fabs(ref[i] - x[i]));
+  }
+  return maxref > 0 ? maxdiff / maxref : maxdiff;
+}
+
+} /// end of name space
+
+int main(int argc, char* argv[]) {
+  /* initialize Madagascar */
+  sf_init(argc,argv);
+
+  int nstep;
+  if (!sf_getint("nstep", &nstep)) nstep = 300; /* time steps of every kernel */
+  float tol;
+  if (!sf_getfloat("tol", &tol)) tol = 1e-5; /* largest difference to the scalar kernel, relative to its peak */
+
+  const struct { const char *name; Kernel run; } kernels[] = {
+    { "damp", damp },
+    { "damp box", dampBox },
+    { "undamped", undamped },
+    { "batch", batch },
+    { "models", models },
+    { "adjoint", adjoint },
+    { "adjoint box", adjointBox },
+  };
+  const int nkernel = sizeof(kernels) / sizeof(kernels[0]);
+
+  Model m;
+  int detected = fd4t10s_simd_isa();
+  INFO() << format("fd4t10s kernels: %s detected, %d steps, tolerance %.1e") % isaName(detected) % nstep % tol;
+
+  /// the same fields through every level, compared to the portable scalar kernels
+  bool failed = false;
+  for (int k = 0; k < nkernel; k++) {
+    std::vector<float> ref, out;
+    fd4t10s_simd_set_isa(FD4T10S_ISA_SCALAR);
+    kernels[k].run(m, nstep, ref);
+
+    for (int isa = FD4T10S_ISA_AVX2; isa <= FD4T10S_ISA_AVX512; isa++) {
+      if (fd4t10s_simd_set_isa(isa) != isa) {
+        INFO() << format("%-12s %-7s not supported") % kernels[k].name % isaName(isa);
+        continue;
+      }
+      kernels[k].run(m, nstep, out);
+      double diff = relDiff(ref, out);
+      bool ok = diff <= tol;
+      INFO() << format("%-12s %-7s relative difference %.3e %s") % kernels[k].name % isaName(isa) % diff % (ok ? "ok" : "FAILED");
+      failed = failed || !ok;
+    }
+  }
+
+  /// the kernels sharing a sweep against the single wavefield kernel at every level. they do the
+  /// same operations in the same order on every wavefield, so they must agree bit for bit
+  const struct { const char *name; Kernel run, alone; } shared[] = {
+    { "batch", batch, batchAlone },
+    { "models", models, modelsAlone },
+  };
+  const int nshared = sizeof(shared) / sizeof(shared[0]);
+
+  bool differs = false;
+  for (int k = 0; k < nshared; k++) {
+    for (int isa = FD4T10S_ISA_SCALAR; isa <= FD4T10S_ISA_AVX512; isa++) {
+      if (fd4t10s_simd_set_isa(isa) != isa) {
+        continue;
+      }
+      std::vector<float> ref, out;
+      shared[k].alone(m, nstep, ref);
+      shared[k].run(m, nstep, out);
+      int n = mismatches(ref, out);
+      INFO() << format("%-12s %-7s %d of %d samples differ from the single wavefield kernel %s")
+          % shared[k].name % isaName(isa) % n % ref.size() % (n == 0 ? "ok" : "FAILED");
+      differs = differs || n != 0;
+    }
+  }
+  fd4t10s_simd_set_isa(detected);
+
+  if (failed) {
+    ERROR() << format("a vector kernel differs from the scalar one by more than %.1e") % tol;
+  }
+  if (differs) {
+    ERROR() << "a shared sweep kernel differs from the single wavefield kernel";
+  }
+  if (failed || differs) {
+    exit(1);
+  }
+  return 0;
+}
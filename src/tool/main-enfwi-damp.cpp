@@ -34,6 +34,7 @@ extern "C" {
 #include "environment.h"
 #include "random-code.h"
 #include "encoder.h"
+#include "profiler.h"
 
 namespace {
 class Params {
@@ -60,6 +61,9 @@ public:
   int niterenkf;
   float sigfac;
   char *perin;
+  std::string prof;     /* profile summary, .json or .csv, empty: no profiling */
+  std::string proftrace; /* prefix of the per rank chrome traces, empty: no trace */
+  int logasync;         /* write the log on a background thread */
 
 public: // parameters from input files
   int nz;
@@ -105,6 +109,11 @@ Params::Params() {
   if (!(perin = sf_getstring("perin"))) { sf_error("no perin"); } /* perturbation file */
   if (!sf_getint("seed", &seed))   { seed = 10; }                 /* seed for random numbers */
   if (!sf_getfloat("sigfac", &sigfac))   { sf_error("no sigfac"); } /* sigma factor */
+  char *profname = sf_getstring("prof");                           /* profile summary of the regions over the ranks, .json or .csv */
+  prof = profname ? profname : "";
+  char *tracename = sf_getstring("proftrace");                     /* prefix of the per rank chrome trace files of the regions */
+  proftrace = tracename ? tracename : "";
+  if (!sf_getint("logasync", &logasync)) { logasync = 1; }       /* 1: buffer the log, a background thread writes it out */
 
   /* get parameters from velocity model and recorded shots */
   if (!sf_histint(vinit, "n1", &nz)) { sf_error("no n1"); }       /* nz */
@@ -414,8 +423,13 @@ int main(int argc, char *argv[]) {
   /// configure logger
   std::string logfile = std::string("enfwi-damp-") + boost::lexical_cast<std::string>(params.rank) + ".log";
   FILELog::setLogFile(logfile);
+  FILELog::setAsync(params.logasync != 0);
 	printGitInfo();
 
+  if (!params.prof.empty() || !params.proftrace.empty()) {
+    Profiler::enable(!params.proftrace.empty());
+  }
+
   int nz = params.nz;
   int nx = params.nx;
   int nb = params.nb;
@@ -543,6 +557,9 @@ int main(int argc, char *argv[]) {
   std::fill(ratioSet.getData(), ratioSet.getData() + ratioSet.size(), initLambdaRatio);
   enkfAnly.initLambdaSet(velset, lambdaSet, ratioSet);
   enkfAnly.pAnalyze(velset, lambdaSet, ratioSet);
+  for (size_t i = 0; i < fms.size(); i++) {
+    fms[i]->refreshVelocity(); /// the analysis updates veldb in place
+  }
 
 
 //  enkfAnly.pAnalyze(velset);
@@ -600,6 +617,9 @@ int main(int argc, char *argv[]) {
 
       //enkfAnly.analyze(totalVelSet, velset);
 			enkfAnly.pAnalyze(velset, lambdaSet, ratioSet);
+			for (size_t i = 0; i < fms.size(); i++) {
+				fms[i]->refreshVelocity();
+			}
 
     }
 
@@ -645,6 +665,7 @@ int main(int argc, char *argv[]) {
     delete essfwis[i];
   }
 
+  Profiler::report(params.prof, params.proftrace);
 
   MPI_Finalize();
   return 0;
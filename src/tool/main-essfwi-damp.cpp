@@ -20,6 +20,7 @@ extern "C" {
 #include "shotdata-reader.h"
 #include "updatevelop.h"
 #include "environment.h"
+#include "profiler.h"
 
 namespace {
 class Params {
@@ -41,6 +42,14 @@ public:
   float maxdv;
   int nita;
   int seed;
+  int nsnap;            /* # of source wavefield snapshots in the gradient */
+  int active;           /* limit the forward propagations to the region the wavefield reached */
+  FwiBase::Optimizer optimizer; /* cg or lbfgs */
+  int nlbfgs;           /* # of l-bfgs correction pairs */
+  BoundaryStore::Config bndr; /* how the boundaries of the source wavefield are kept */
+  std::string prof;     /* profile summary, .json or .csv, empty: no profiling */
+  std::string proftrace; /* prefix of the per rank chrome traces, empty: no trace */
+  int logasync;         /* write the log on a background thread */
 
 public: // parameters from input files
   int nz;
@@ -75,6 +84,21 @@ Params::Params() {
   if (!sf_getfloat("maxdv", &maxdv)) sf_error("no maxdv");        /* max delta v update two iteration*/
   if (!sf_getint("nita", &nita))   { sf_error("no nita"); }       /* max iter refining alpha */
   if (!sf_getint("seed", &seed))   { seed = 10; }                 /* seed for random numbers */
+  if (!sf_getint("nsnap", &nsnap)) { nsnap = 0; }               /* snapshots of the source wavefield, 0: save the boundaries */
+  if (!sf_getint("active", &active)) { active = 1; }             /* 1: skip the grid the wavefield has not reached yet */
+  char *optname = sf_getstring("optimizer");                      /* cg or lbfgs, lbfgs tries at most nita steps per iteration */
+  optimizer = FwiBase::optimizerFromName(optname ? optname : "cg");
+  if (!sf_getint("nlbfgs", &nlbfgs)) { nlbfgs = 5; }             /* l-bfgs correction pairs */
+  char *bndrname = sf_getstring("bndr");                           /* float or half, half floats take half the memory of the boundaries */
+  bndr.format = BoundaryStore::formatFromName(bndrname ? bndrname : "float");
+  int bndrasync;
+  if (!sf_getint("bndrasync", &bndrasync)) { bndrasync = 1; }     /* 1: convert the half float boundaries on a background thread */
+  bndr.async = bndrasync != 0;
+  char *profname = sf_getstring("prof");                           /* profile summary of the regions over the ranks, .json or .csv */
+  prof = profname ? profname : "";
+  char *tracename = sf_getstring("proftrace");                     /* prefix of the per rank chrome trace files of the regions */
+  proftrace = tracename ? tracename : "";
+  if (!sf_getint("logasync", &logasync)) { logasync = 1; }       /* 1: buffer the log, a background thread writes it out */
 
   /* get parameters from velocity model and recorded shots */
   if (!sf_histint(vinit, "n1", &nz)) { sf_error("no n1"); }       /* nz */
@@ -153,8 +177,13 @@ int main(int argc, char *argv[]) {
   /// configure logger
   const char *logfile = "essfwi-damp.log";
   FILELog::setLogFile(logfile);
+  FILELog::setAsync(params.logasync != 0);
 	printGitInfo();
 
+  if (!params.prof.empty() || !params.proftrace.empty()) {
+    Profiler::enable(!params.proftrace.empty());
+  }
+
   int nz = params.nz;
   int nx = params.nx;
   int nb = params.nb;
@@ -179,6 +208,7 @@ int main(int argc, char *argv[]) {
   Velocity v0 = SfVelocityReader::read(params.vinit, nx, nz);
   Velocity exvel = fmMethod.expandDomain(v0);
   fmMethod.bindVelocity(exvel);
+  fmMethod.setActiveRegion(params.active != 0);
 
   std::vector<float> wlt(nt);
   rickerWavelet(&wlt[0], nt, fm, dt, params.amp);
@@ -190,6 +220,9 @@ int main(int argc, char *argv[]) {
   UpdateSteplenOp updateSteplenOp(fmMethod, updatevelop, nita, maxdv);
 
   EssFwiFramework essfwi(fmMethod, updateSteplenOp, updatevelop, wlt, dobs);
+  essfwi.setCheckpoints(params.nsnap);
+  essfwi.setBoundaryStore(params.bndr);
+  essfwi.setOptimizer(params.optimizer, params.nlbfgs, nita, maxdv);
 
   std::vector<float> absobj;
   std::vector<float> norobj;
@@ -209,6 +242,8 @@ int main(int argc, char *argv[]) {
   sf_floatwrite(&absobj[0], absobj.size(), params.absobjs);
   sf_floatwrite(&norobj[0], norobj.size(), params.norobjs);
 
+  Profiler::report(params.prof, params.proftrace);
+
   sf_close();
 
   return 0;
@@ -7,6 +7,8 @@ extern "C" {
 #ifdef _OPENMP
 #include <omp.h>
 #endif
+#include <algorithm>
+#include <vector>
 
 #include "mpi.h"
 #include "logger.h"
@@ -55,6 +57,7 @@ public:
   int jgx;
   int jgz;
 	int freeSurface;
+  int nbatch;
 
 public:
   int rank;
@@ -107,6 +110,8 @@ Params::Params() {
   /* z-begining index of receivers, starting from 0 */
 	if (!sf_getint("free", &freeSurface)) sf_error("no freeSurface");
 	/* whether it is freeSurface */
+  if (!sf_getint("nbatch", &nbatch)) nbatch = 1;
+  /* shots modeled in one propagation, in groups of 8 */
 
   sf_putint(shots,"n1",nt);
   sf_putint(shots,"n2",ng);
@@ -209,55 +214,39 @@ int main(int argc, char* argv[]) {
   rickerWavelet(&wlt[0], nt, fm, dt, params.amp);
 
   std::vector<float> dobs(params.ntask * params.nt * params.ng, 0);
-  for(int is=rank*k; is<rank*k+ntask; is++) {
-    int local_is = is - rank * k;
+  for(int is0=rank*k; is0<rank*k+ntask; is0+=params.nbatch) {
     Timer timer;
-    std::vector<float> p0(exvel.nz * exvel.nx, 0);
-    std::vector<float> p1(exvel.nz * exvel.nx, 0);
-    std::vector<float> dobs_trans(params.nt * params.ng, 0);
-    ShotPosition curSrcPos = allSrcPos.clipRange(is, is);
-		/*
-		int dn = 10;
-		sf_file fullwv = sf_output("fullwv.rsf");
-		sf_putint(fullwv, "n1" , exvel.nz);
-		sf_putint(fullwv, "n2" , exvel.nx);
-		sf_putint(fullwv, "n3" , nt / dn);
-		*/
-
-		//fmMethod.initFdUtil(params.vinit, &exvel, nb, params.dx, dt);
-    for(int it=0; it<nt; it++) {
-      fmMethod.addSource(&p1[0], &wlt[it], curSrcPos);
-      fmMethod.stepForward(p0, p1);
-      //fmMethod.stepForward(p0, p1, 0);
-      std::swap(p1, p0);
-      fmMethod.recordSeis(&dobs_trans[it*ng], &p0[0]);
-			/*
-			if(it % dn == 0)
-				sf_floatwrite(&p0[0], exvel.nx * exvel.nz, fullwv);
-				*/
+    std::vector<int> batch;
+    for(int is=is0; is<std::min(is0+params.nbatch, rank*k+ntask); is++) {
+      batch.push_back(is);
     }
-		//exit(1);
-    matrix_transpose(&dobs_trans[0], &dobs[local_is * ng * nt], ng, nt);
-
-		//fmMethod.fwiRemoveDirectArrival(&dobs[local_is * ng * nt], local_is);
-		if(np == 1) {
-			sf_floatwrite(&dobs[local_is * ng * nt], ng*nt, params.shots);
-		}
-		else {
-			if(rank == 0) {
-				sf_floatwrite(&dobs[local_is * ng * nt], ng*nt, params.shots);
-				if(is == rank * k + ntask - 1) {
-					for(int other_is = rank * k + ntask ; other_is < ns ; other_is ++) {
-						MPI_Recv(&dobs[0], ng*nt, MPI_FLOAT, other_is / k, other_is, MPI_COMM_WORLD, &status);
-						sf_floatwrite(&dobs[0], ng*nt, params.shots);
-					}
-				}
-			}
-			else {
-				MPI_Isend(&dobs[local_is * ng * nt], ng*nt, MPI_FLOAT, 0, is, MPI_COMM_WORLD, &request);
-			}
-		}
-    INFO() << format("shot %d, elapsed time %fs") % is % timer.elapsed();
+    std::vector<std::vector<float> > dobs_trans(batch.size(), std::vector<float>(params.nt * params.ng, 0));
+    fmMethod.FwiForwardModeling(wlt, dobs_trans, batch);
+
+    for(size_t ib=0; ib<batch.size(); ib++) {
+      int is = batch[ib];
+      int local_is = is - rank * k;
+      matrix_transpose(&dobs_trans[ib][0], &dobs[local_is * ng * nt], ng, nt);
+
+      if(np == 1) {
+        sf_floatwrite(&dobs[local_is * ng * nt], ng*nt, params.shots);
+      }
+      else {
+        if(rank == 0) {
+          sf_floatwrite(&dobs[local_is * ng * nt], ng*nt, params.shots);
+          if(is == rank * k + ntask - 1) {
+            for(int other_is = rank * k + ntask ; other_is < ns ; other_is ++) {
+              MPI_Recv(&dobs[0], ng*nt, MPI_FLOAT, other_is / k, other_is, MPI_COMM_WORLD, &status);
+              sf_floatwrite(&dobs[0], ng*nt, params.shots);
+            }
+          }
+        }
+        else {
+          MPI_Isend(&dobs[local_is * ng * nt], ng*nt, MPI_FLOAT, 0, is, MPI_COMM_WORLD, &request);
+        }
+      }
+    }
+    INFO() << format("shots %d to %d, elapsed time %fs") % batch.front() % batch.back() % timer.elapsed();
   }
 
   INFO() << format("total elapsed time %fs") % totalTimer.elapsed();
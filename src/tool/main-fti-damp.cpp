@@ -23,6 +23,7 @@ extern "C" {
 #include "ricker-wavelet.h"
 #include "ftiframework.h"
 #include "shotdata-reader.h"
+#include "shotdata-store.h"
 #include "updatevelop.h"
 #include "environment.h"
 
@@ -47,6 +48,7 @@ public:
   float maxdv;
   int nita;
   int seed;
+  WavefieldStore::Config wfstore; /* where the source and receiver wavefields are kept */
 
 public: // parameters from input files
   int nz;
@@ -89,6 +91,13 @@ Params::Params() {
   if (!sf_getint("nita", &nita))   { sf_error("no nita"); }       /* max iter refining alpha */
   if (!sf_getint("seed", &seed))   { seed = 10; }                 /* seed for random numbers */
 
+  char *wfname = sf_getstring("wfstore");                         /* ram, zip or disk */
+  wfstore.backend = WavefieldStore::backendFromName(wfname ? wfname : "ram");
+  if (!sf_getint("wfjt", &wfstore.jt)) { wfstore.jt = 1; }        /* keep every wfjt-th snapshot, interpolate the others */
+  if (!sf_getint("wfbits", &wfstore.bits)) { wfstore.bits = 16; } /* bits per value of the zip store */
+  char *wfdir = sf_getstring("wfdir");                            /* directory of the disk store spill files */
+  if (wfdir) { wfstore.dir = wfdir; }
+
   /* get parameters from velocity model and recorded shots */
   if (!sf_histint(vinit, "n1", &nz)) { sf_error("no n1"); }       /* nz */
   if (!sf_histint(vinit, "n2", &nx)) { sf_error("no n2"); }       /* nx */
@@ -207,13 +216,13 @@ int main(int argc, char *argv[]) {
   rickerWavelet(&wlt[0], nt, fm, dt, params.amp);
 	INFO() << "sum encsrc: " << std::accumulate(wlt.begin(), wlt.begin() + nt, 0.0f);
 
-  std::vector<float> dobs(ns * nt * ng);     /* all observed data */
-  ShotDataReader::serialRead(params.shots, &dobs[0], ns, nt, ng);
+  ShotDataStore dobs(params.shots, ns, nt, ng);  /* observed data of the shots owned by this rank */
 
   FwiUpdateVelOp updatevelop(vmin, vmax, dx, dt);
   FwiUpdateSteplenOp updateSteplenOp(fmMethod, updatevelop, nita, maxdv, ns, ng, nt, &wlt);
 
   FtiFramework fti(fmMethod, updateSteplenOp, updatevelop, wlt, dobs, params.jsx, params.jsz);
+  fti.setWavefieldStore(params.wfstore);
 
   std::vector<float> absobj;
   std::vector<float> norobj;
@@ -236,6 +245,7 @@ int main(int argc, char *argv[]) {
 
   sf_close();
 
+  dobs.release();
   MPI_Finalize();
   return 0;
 }
@@ -14,6 +14,7 @@ extern "C" {
 #include <numeric>
 #include <cstdlib>
 #include <functional>
+#include <boost/bind.hpp>
 
 #include "logger.h"
 #include "common.h"
@@ -22,9 +23,12 @@ extern "C" {
 #include "sf-velocity-reader.h"
 #include "ricker-wavelet.h"
 #include "fwiframework.h"
+#include "multiscale-fwi.h"
 #include "shotdata-reader.h"
+#include "shotdata-store.h"
 #include "updatevelop.h"
 #include "environment.h"
+#include "profiler.h"
 
 namespace {
 class Params {
@@ -46,6 +50,24 @@ public:
   float maxdv;
   int nita;
   int seed;
+  int nsnap;            /* # of source wavefield snapshots in the gradient */
+  int active;           /* limit the forward propagations to the region the wavefield reached */
+  FwiBase::Optimizer optimizer; /* cg or lbfgs */
+  int nlbfgs;           /* # of l-bfgs correction pairs */
+  int aperture;         /* max source receiver offset of the shots in cells, 0: the whole model */
+  int nbatch;           /* # of shots modeled in one propagation */
+  int trialbatch;       /* model the trial step lengths of a shot in one propagation */
+  int dcache;           /* reuse the data of the line search in the next gradient */
+  int nshotpar;         /* # of shots running at the same time in one process */
+  int nthreadshot;      /* # of threads of every shot */
+  int nband;            /* # of low frequency bands run before the full band */
+  std::vector<float> fband; /* upper frequency of every band */
+  std::vector<int> bniter;  /* # of iterations of every band */
+  int maxk;             /* coarsest grid of the bands, full grid cells per band cell */
+  BoundaryStore::Config bndr; /* how the boundaries of the source wavefield are kept */
+  std::string prof;     /* profile summary, .json or .csv, empty: no profiling */
+  std::string proftrace; /* prefix of the per rank chrome traces, empty: no trace */
+  int logasync;         /* write the log on a background thread */
 
 public: // parameters from input files
   int nz;
@@ -86,6 +108,33 @@ Params::Params() {
   if (!sf_getfloat("maxdv", &maxdv)) sf_error("no maxdv");        /* max delta v update two iteration*/
   if (!sf_getint("nita", &nita))   { sf_error("no nita"); }       /* max iter refining alpha */
   if (!sf_getint("seed", &seed))   { seed = 10; }                 /* seed for random numbers */
+  if (!sf_getint("nsnap", &nsnap)) { nsnap = 0; }               /* snapshots of the source wavefield, 0: save the boundaries */
+  if (!sf_getint("active", &active)) { active = 1; }             /* 1: skip the grid the wavefield has not reached yet */
+  char *optname = sf_getstring("optimizer");                      /* cg or lbfgs, lbfgs tries at most nita steps per iteration */
+  optimizer = FwiBase::optimizerFromName(optname ? optname : "cg");
+  if (!sf_getint("nlbfgs", &nlbfgs)) { nlbfgs = 5; }             /* l-bfgs correction pairs */
+  if (!sf_getint("aperture", &aperture)) { aperture = 0; }       /* >0: propagate every shot around its receivers within this offset only */
+  if (!sf_getint("nbatch", &nbatch)) { nbatch = 1; }             /* shots modeled in one propagation, in groups of 8 */
+  if (!sf_getint("trialbatch", &trialbatch)) { trialbatch = 1; } /* 1: the line search models its trial velocities together */
+  if (!sf_getint("dcache", &dcache)) { dcache = 1; }             /* 1: keep the data of the trial velocities, 2 * nt * ng floats per local shot */
+  if (!sf_getint("nshotpar", &nshotpar)) { nshotpar = 1; }         /* shots running at the same time in one process */
+  if (!sf_getint("nthreadshot", &nthreadshot)) { nthreadshot = 0; } /* threads of every shot, 0: share the threads evenly */
+  if (!sf_getint("nband", &nband)) { nband = 0; }                 /* low frequency bands before the full band, on coarser grids */
+  fband.resize(nband);
+  bniter.resize(nband);
+  if (nband > 0 && !sf_getfloats("fband", &fband[0], nband)) { sf_error("no fband"); } /* upper frequency of every band, increasing */
+  if (nband > 0 && !sf_getints("bniter", &bniter[0], nband)) { sf_error("no bniter"); } /* iterations of every band */
+  if (!sf_getint("maxk", &maxk)) { maxk = 4; }                    /* a band grid is at most maxk times coarser than the full grid */
+  char *bndrname = sf_getstring("bndr");                           /* float or half, half floats take half the memory of the boundaries */
+  bndr.format = BoundaryStore::formatFromName(bndrname ? bndrname : "float");
+  int bndrasync;
+  if (!sf_getint("bndrasync", &bndrasync)) { bndrasync = 1; }     /* 1: convert the half float boundaries on a background thread */
+  bndr.async = bndrasync != 0;
+  char *profname = sf_getstring("prof");                           /* profile summary of the regions over the ranks, .json or .csv */
+  prof = profname ? profname : "";
+  char *tracename = sf_getstring("proftrace");                     /* prefix of the per rank chrome trace files of the regions */
+  proftrace = tracename ? tracename : "";
+  if (!sf_getint("logasync", &logasync)) { logasync = 1; }       /* 1: buffer the log, a background thread writes it out */
 
   /* get parameters from velocity model and recorded shots */
   if (!sf_histint(vinit, "n1", &nz)) { sf_error("no n1"); }       /* nz */
@@ -158,11 +207,29 @@ void Params::check() {
   }
 }
 
+/**
+ * the same settings for the full band and for every band of a multiscale run,
+ * whose grid is k times coarser
+ */
+void setupFwi(const Params *params, FwiFramework &fwi, ForwardModeling &fmMethod, int k) {
+  fmMethod.setActiveRegion(params->active != 0);
+  fwi.setShotParallelism(params->nshotpar, params->nthreadshot);
+  fwi.setCheckpoints(params->nsnap);
+  fwi.setBoundaryStore(params->bndr);
+  fwi.setAperture(params->aperture > 0 ? std::max(params->aperture / k, 1) : 0);
+  fwi.setShotBatch(params->nbatch);
+  fwi.setTrialBatch(params->trialbatch != 0);
+  fwi.setDataCache(params->dcache != 0);
+  fwi.setOptimizer(params->optimizer, params->nlbfgs, params->nita, params->maxdv);
+}
+
 } /// end of name space
 
 
 int main(int argc, char *argv[]) {
-	MPI_Init(&argc, &argv);
+	/// the shot threads ask the shot scheduler for work one at a time
+	int provided;
+	MPI_Init_thread(&argc, &argv, MPI_THREAD_SERIALIZED, &provided);
   sf_init(argc, argv);                /* initialize Madagascar */
   Environment::setDatapath();
   Params params;
@@ -171,8 +238,13 @@ int main(int argc, char *argv[]) {
 	char logfile[64];
 	sprintf(logfile, "fwi-damp-%02d.log", params.rank);
   FILELog::setLogFile(logfile);
+  FILELog::setAsync(params.logasync != 0);
 	printGitInfo();
 
+  if (!params.prof.empty() || !params.proftrace.empty()) {
+    Profiler::enable(!params.proftrace.empty());
+  }
+
   int nz = params.nz;
   int nx = params.nx;
   int nb = params.nb;
@@ -195,20 +267,36 @@ int main(int argc, char *argv[]) {
 
   SfVelocityReader velReader(params.vinit);
   Velocity v0 = SfVelocityReader::read(params.vinit, nx, nz);
-  Velocity exvel = fmMethod.expandDomain(v0);
-  fmMethod.bindVelocity(exvel);
 
   std::vector<float> wlt(nt);
   rickerWavelet(&wlt[0], nt, fm, dt, params.amp);
 	INFO() << "sum encsrc: " << std::accumulate(wlt.begin(), wlt.begin() + nt, 0.0f);
 
-  std::vector<float> dobs(ns * nt * ng);     /* all observed data */
-  ShotDataReader::serialRead(params.shots, &dobs[0], ns, nt, ng);
+  ShotDataStore dobs(params.shots, ns, nt, ng);  /* observed data of the shots owned by this rank */
+
+  if (params.nshotpar > 1 && provided < MPI_THREAD_SERIALIZED) {
+    INFO() << "MPI does not support calls from several threads, run one shot at a time";
+    params.nshotpar = 1;
+  }
+
+  if (params.nband > 0) {
+    MultiscaleFwi multiscale(allSrcPos, allGeoPos, dt, dx, fm, nb, nt, params.freeSurface,
+        vmin, vmax, maxdv, nita, wlt, dobs);
+    multiscale.setMaxCoarsening(params.maxk);
+    multiscale.setSetup(boost::bind(setupFwi, &params, _1, _2, _3));
+    for (int ib = 0; ib < params.nband; ib++) {
+      multiscale.run(params.fband[ib], params.bniter[ib], v0);
+    }
+  }
+
+  Velocity exvel = fmMethod.expandDomain(v0);
+  fmMethod.bindVelocity(exvel);
 
   FwiUpdateVelOp updatevelop(vmin, vmax, dx, dt);
   FwiUpdateSteplenOp updateSteplenOp(fmMethod, updatevelop, nita, maxdv, ns, ng, nt, &wlt);
 
   FwiFramework fwi(fmMethod, updateSteplenOp, updatevelop, wlt, dobs);
+  setupFwi(&params, fwi, fmMethod, 1);
 
   std::vector<float> absobj;
   std::vector<float> norobj;
@@ -229,8 +317,11 @@ int main(int argc, char *argv[]) {
   sf_floatwrite(&absobj[0], absobj.size(), params.absobjs);
   sf_floatwrite(&norobj[0], norobj.size(), params.norobjs);
 
+  Profiler::report(params.prof, params.proftrace);
+
   sf_close();
 
+  dobs.release();
   MPI_Finalize();
   return 0;
 }